@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include "cmdt_sync.h"
+
+static inline bool _cmdt_unchanged(const cmdt_sync_t *sync, const vdp1_cmdt_t *cmdts, uint32_t i) __always_inline;
+static inline bool _cmdt_equal(const vdp1_cmdt_t *a, const vdp1_cmdt_t *b) __always_inline;
+
+void
+cmdt_sync_init(cmdt_sync_t *sync, uint16_t count, uint16_t index)
+{
+        sync->shadow = malloc(sizeof(vdp1_cmdt_t) * count);
+        assert(sync->shadow != NULL);
+
+        sync->count = count;
+        sync->index = index;
+        sync->valid_count = 0;
+}
+
+void
+cmdt_sync_deinit(cmdt_sync_t *sync)
+{
+        free(sync->shadow);
+
+        sync->shadow = NULL;
+        sync->count = 0;
+        sync->valid_count = 0;
+}
+
+void
+cmdt_sync_invalidate(cmdt_sync_t *sync)
+{
+        sync->valid_count = 0;
+}
+
+uint32_t
+cmdt_sync_put(cmdt_sync_t *sync, const vdp1_cmdt_list_t *cmdt_list)
+{
+        assert(cmdt_list->count <= sync->count);
+
+        const vdp1_cmdt_t * const cmdts = cmdt_list->cmdts;
+        vdp1_cmdt_t * const shadow = sync->shadow;
+
+        uint32_t put_count;
+        put_count = 0;
+
+        uint32_t i;
+        i = 0;
+
+        while (i < cmdt_list->count) {
+                if (_cmdt_unchanged(sync, cmdts, i)) {
+                        i++;
+
+                        continue;
+                }
+
+                const uint32_t start = i;
+
+                for (; (i < cmdt_list->count) && !_cmdt_unchanged(sync, cmdts, i); i++) {
+                        shadow[i] = cmdts[i];
+                }
+
+                /* The copy is read by DMA once the list is synced, so it has
+                 * to be in memory by then. CPU writes get there right away */
+                vdp1_sync_cmdt_put(&shadow[start], i - start, sync->index + start);
+
+                put_count += i - start;
+        }
+
+        sync->valid_count = max(sync->valid_count, cmdt_list->count);
+
+        return put_count;
+}
+
+static inline bool __always_inline
+_cmdt_unchanged(const cmdt_sync_t *sync, const vdp1_cmdt_t *cmdts, uint32_t i)
+{
+        /* Past the longest list put so far, the shadow was never written */
+        if (i >= sync->valid_count) {
+                return false;
+        }
+
+        return _cmdt_equal(&sync->shadow[i], &cmdts[i]);
+}
+
+static inline bool __always_inline
+_cmdt_equal(const vdp1_cmdt_t *a, const vdp1_cmdt_t *b)
+{
+        const uint32_t * const a_words = (const uint32_t *)a;
+        const uint32_t * const b_words = (const uint32_t *)b;
+
+        for (uint32_t i = 0; i < (sizeof(vdp1_cmdt_t) / sizeof(uint32_t)); i++) {
+                if (a_words[i] != b_words[i]) {
+                        return false;
+                }
+        }
+
+        return true;
+}
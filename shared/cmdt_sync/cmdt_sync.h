@@ -0,0 +1,36 @@
+#ifndef _SHARED_CMDT_SYNC_CMDT_SYNC_H_
+#define _SHARED_CMDT_SYNC_CMDT_SYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <yaul.h>
+
+/* Puts only the command tables that changed since the last put into VDP1 VRAM.
+ * Command tables that never change, like the system clip and local coordinates,
+ * are put once */
+typedef struct cmdt_sync {
+        /* Copy of what's in VDP1 VRAM. Transfers are made from here */
+        vdp1_cmdt_t *shadow;
+        uint16_t count;
+        /* Index of the first command table in VDP1 VRAM */
+        uint16_t index;
+        /* The shadow matches VDP1 VRAM up to here. Past it, the shadow
+         * holds nothing that was ever put. 0 until the first put, and after
+         * cmdt_sync_invalidate() */
+        uint16_t valid_count;
+} cmdt_sync_t;
+
+void cmdt_sync_init(cmdt_sync_t *sync, uint16_t count, uint16_t index);
+void cmdt_sync_deinit(cmdt_sync_t *sync);
+
+/* Makes the next put transfer the whole list, in case VDP1 VRAM was written to
+ * by other means */
+void cmdt_sync_invalidate(cmdt_sync_t *sync);
+
+/* Compares cmdt_list against what was last put, and queues each run of changed
+ * command tables with vdp1_sync_cmdt_put(). Use in place of
+ * vdp1_sync_cmdt_list_put(). Returns how many command tables were queued */
+uint32_t cmdt_sync_put(cmdt_sync_t *sync, const vdp1_cmdt_list_t *cmdt_list);
+
+#endif /* !_SHARED_CMDT_SYNC_CMDT_SYNC_H_ */
@@ -0,0 +1,217 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yaul.h>
+
+#include "sprite_batch.h"
+
+void
+sprite_batch_init(sprite_batch_t *batch, uint16_t count)
+{
+        batch->sprites = malloc(sizeof(sprite_t) * count);
+        assert(batch->sprites != NULL);
+
+        batch->free_indices = malloc(sizeof(uint16_t) * count);
+        assert(batch->free_indices != NULL);
+
+        batch->count = count;
+        batch->free_count = 0;
+        batch->high_water = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                batch->sprites[i].flags = 0;
+        }
+}
+
+void
+sprite_batch_deinit(sprite_batch_t *batch)
+{
+        free(batch->free_indices);
+        free(batch->sprites);
+
+        batch->sprites = NULL;
+        batch->free_indices = NULL;
+        batch->count = 0;
+}
+
+sprite_t *
+sprite_batch_alloc(sprite_batch_t *batch)
+{
+        uint16_t index;
+
+        /* Reuse freed sprites first, to keep the pool dense */
+        if (batch->free_count > 0) {
+                batch->free_count--;
+
+                index = batch->free_indices[batch->free_count];
+        } else if (batch->high_water < batch->count) {
+                index = batch->high_water;
+
+                batch->high_water++;
+        } else {
+                return NULL;
+        }
+
+        sprite_t * const sprite = &batch->sprites[index];
+
+        (void)memset(&sprite->cmdt, 0x00, sizeof(vdp1_cmdt_t));
+
+        vdp1_cmdt_normal_sprite_set(&sprite->cmdt);
+
+        sprite->anim = NULL;
+        sprite->position.x = 0;
+        sprite->position.y = 0;
+        sprite->frame = 0;
+        sprite->counter = 0;
+        sprite->flags = SPRITE_FLAG_ACTIVE;
+
+        return sprite;
+}
+
+void
+sprite_batch_free(sprite_batch_t *batch, sprite_t *sprite)
+{
+        const uint16_t index = sprite - batch->sprites;
+
+        assert(index < batch->high_water);
+        assert((sprite->flags & SPRITE_FLAG_ACTIVE) != 0);
+
+        sprite->flags = 0;
+
+        batch->free_indices[batch->free_count] = index;
+        batch->free_count++;
+}
+
+void
+sprite_anim_set(sprite_t *sprite, const sprite_anim_t *anim)
+{
+        assert((anim == NULL) || (anim->frame_count > 0));
+
+        sprite->anim = anim;
+        sprite->frame = 0;
+        sprite->counter = (anim != NULL) ? anim->frame_duration : 0;
+}
+
+void
+sprite_batch_update(sprite_batch_t *batch)
+{
+        for (uint32_t i = 0; i < batch->high_water; i++) {
+                sprite_t * const sprite = &batch->sprites[i];
+
+                if ((sprite->flags & (SPRITE_FLAG_ACTIVE | SPRITE_FLAG_PAUSED)) != SPRITE_FLAG_ACTIVE) {
+                        continue;
+                }
+
+                const sprite_anim_t * const anim = sprite->anim;
+
+                if (anim == NULL) {
+                        continue;
+                }
+
+                if (sprite->counter > 0) {
+                        sprite->counter--;
+
+                        continue;
+                }
+
+                sprite->counter = anim->frame_duration;
+
+                if ((sprite->frame + 1) < anim->frame_count) {
+                        sprite->frame++;
+                } else if (anim->loop) {
+                        sprite->frame = 0;
+                }
+        }
+}
+
+uint32_t
+sprite_batch_build(const sprite_batch_t *batch, vdp1_cmdt_t *cmdts,
+    uint32_t cmdt_count)
+{
+        uint32_t count;
+        count = 0;
+
+        for (uint32_t i = 0; (i < batch->high_water) && (count < cmdt_count); i++) {
+                const sprite_t * const sprite = &batch->sprites[i];
+
+                if ((sprite->flags & (SPRITE_FLAG_ACTIVE | SPRITE_FLAG_HIDDEN)) != SPRITE_FLAG_ACTIVE) {
+                        continue;
+                }
+
+                vdp1_cmdt_t * const cmdt = &cmdts[count];
+
+                *cmdt = sprite->cmdt;
+
+                if (sprite->anim != NULL) {
+                        const sprite_frame_t * const frame =
+                            &sprite->anim->frames[sprite->frame];
+
+                        cmdt->cmd_srca = frame->srca;
+                        cmdt->cmd_size = frame->size;
+                }
+
+                /* Vertex A is the top left corner of a normal sprite, and the
+                 * zoom point of a scaled sprite */
+                cmdt->cmd_xa = sprite->position.x;
+                cmdt->cmd_ya = sprite->position.y;
+
+                count++;
+        }
+
+        return count;
+}
+
+void
+sprite_frames_strip_init(sprite_frame_t *frames, uint32_t frame_count,
+    vdp1_vram_t base, uint16_t width, uint16_t height, uint32_t frame_size)
+{
+        assert((width & 7) == 0);
+        assert((base & 7) == 0);
+        assert((frame_size & 7) == 0);
+
+        for (uint32_t i = 0; i < frame_count; i++) {
+                vdp1_cmdt_t cmdt;
+
+                vdp1_cmdt_char_base_set(&cmdt, base + (i * frame_size));
+                vdp1_cmdt_char_size_set(&cmdt, width, height);
+
+                frames[i].srca = cmdt.cmd_srca;
+                frames[i].size = cmdt.cmd_size;
+        }
+}
+
+void
+sprite_atlas_frames_init(sprite_frame_t *frames, const sprite_atlas_t *atlas,
+    uint32_t index, vdp1_vram_t base)
+{
+        assert(index < atlas->entry_count);
+
+        const sprite_atlas_entry_t * const entry = &atlas->entries[index];
+
+        sprite_frames_strip_init(frames, entry->frame_count, base + entry->offset,
+            entry->width, entry->height, entry->frame_size);
+}
+
+void
+sprite_atlas_color_set(vdp1_cmdt_t *cmdt, const sprite_atlas_t *atlas,
+    uint32_t index, vdp1_vram_t base, uint16_t bank_base)
+{
+        assert(index < atlas->entry_count);
+
+        const sprite_atlas_entry_t * const entry = &atlas->entries[index];
+
+        if (entry->color_mode == 1) {
+                /* Each lookup table is 16 RGB1555 colors */
+                vdp1_cmdt_color_mode1_set(cmdt,
+                    base + atlas->clut_offset + (entry->palette * 32));
+        } else if (entry->color_mode == 4) {
+                const vdp1_cmdt_color_bank_t color_bank = {
+                        .type_0.dc = (bank_base + entry->palette) << 8
+                };
+
+                vdp1_cmdt_color_mode4_set(cmdt, color_bank);
+        } else {
+                vdp1_cmdt_color_mode5_set(cmdt);
+        }
+}
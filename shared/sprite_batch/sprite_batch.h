@@ -0,0 +1,107 @@
+#ifndef _SHARED_SPRITE_BATCH_SPRITE_BATCH_H_
+#define _SHARED_SPRITE_BATCH_SPRITE_BATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <yaul.h>
+
+#define SPRITE_FLAG_ACTIVE (1 << 0)
+#define SPRITE_FLAG_HIDDEN (1 << 1)
+#define SPRITE_FLAG_PAUSED (1 << 2)
+
+/* One animation frame in a texture atlas in VDP1 VRAM, already in the form the
+ * command table wants */
+typedef struct sprite_frame {
+        uint16_t srca;
+        uint16_t size;
+} sprite_frame_t;
+
+typedef struct sprite_anim {
+        const sprite_frame_t *frames;
+        uint16_t frame_count;
+        /* In frames */
+        uint16_t frame_duration;
+        bool loop;
+} sprite_anim_t;
+
+typedef struct sprite {
+        /* Command, draw mode, color, and for scaled sprites the display size
+         * and zoom point. Set it up once with the vdp1_cmdt_*() functions. The
+         * position and character fields are filled in on every build */
+        vdp1_cmdt_t cmdt;
+
+        const sprite_anim_t *anim;
+        int16_vec2_t position;
+
+        uint16_t frame;
+        uint16_t counter;
+        uint16_t flags;
+} sprite_t;
+
+/* One sprite in an atlas written by work/atlas_pack.py */
+typedef struct sprite_atlas_entry {
+        /* In bytes, from the start of the atlas */
+        uint32_t offset;
+        uint32_t frame_size;
+        uint16_t width;
+        uint16_t height;
+        uint16_t frame_count;
+        /* 1 (4 bpp lookup table), 4 (8 bpp color bank) or 5 (RGB) */
+        uint8_t color_mode;
+        /* Index of the lookup table or color bank */
+        uint8_t palette;
+} sprite_atlas_entry_t;
+
+typedef struct sprite_atlas {
+        const sprite_atlas_entry_t *entries;
+        uint16_t entry_count;
+        /* The 16 color lookup tables follow each other from here, in bytes
+         * from the start of the atlas */
+        uint32_t clut_offset;
+        uint32_t size;
+} sprite_atlas_t;
+
+/* A pool of sprites, built into a packed run of command tables every frame */
+typedef struct sprite_batch {
+        sprite_t *sprites;
+        uint16_t *free_indices;
+        uint16_t count;
+        uint16_t free_count;
+        /* One past the highest index ever allocated */
+        uint16_t high_water;
+} sprite_batch_t;
+
+void sprite_batch_init(sprite_batch_t *batch, uint16_t count);
+void sprite_batch_deinit(sprite_batch_t *batch);
+
+/* Returns NULL when the pool is empty. The sprite starts out as a normal
+ * sprite, with no animation */
+sprite_t *sprite_batch_alloc(sprite_batch_t *batch);
+void sprite_batch_free(sprite_batch_t *batch, sprite_t *sprite);
+
+void sprite_anim_set(sprite_t *sprite, const sprite_anim_t *anim);
+
+/* Advances every active, unpaused sprite's animation by one frame */
+void sprite_batch_update(sprite_batch_t *batch);
+
+/* Writes one command table per active, visible sprite into cmdts, in pool
+ * order, and returns how many were written. Stops at cmdt_count */
+uint32_t sprite_batch_build(const sprite_batch_t *batch, vdp1_cmdt_t *cmdts,
+    uint32_t cmdt_count);
+
+/* Fills in frame_count frames of width x height, frame_size bytes apart in VDP1
+ * VRAM, starting at base. width must be a multiple of 8 */
+void sprite_frames_strip_init(sprite_frame_t *frames, uint32_t frame_count,
+    vdp1_vram_t base, uint16_t width, uint16_t height, uint32_t frame_size);
+
+/* Fills in the entry's frames, for an atlas uploaded to base */
+void sprite_atlas_frames_init(sprite_frame_t *frames, const sprite_atlas_t *atlas,
+    uint32_t index, vdp1_vram_t base);
+
+/* Sets the color mode and color of cmdt for the entry. bank_base is the first
+ * 256 color bank the atlas' .PAL file was copied to */
+void sprite_atlas_color_set(vdp1_cmdt_t *cmdt, const sprite_atlas_t *atlas,
+    uint32_t index, vdp1_vram_t base, uint16_t bank_base);
+
+#endif /* !_SHARED_SPRITE_BATCH_SPRITE_BATCH_H_ */
@@ -0,0 +1,435 @@
+#!/usr/bin/env python3
+#
+# Packs sprites into one VDP1 texture atlas, so they can be uploaded in a
+# single transfer
+#
+# The spec file lists one sprite per line. Lines starting with '#' are
+# ignored:
+#
+#   <path> name=<name> [palette=<path>] [width=<w>] [height=<h>] [frames=<n>]
+#          [endcode=off]
+#
+# <path> is one of:
+#
+#   .png   8-bit RGB, RGBA, grey or paletted PNG, not interlaced. Texels with
+#          alpha < 128 are transparent
+#   .c     A C source file holding a uint16_t array, like the mic3d pictures.
+#          An array whose name contains "palette" is used as the palette, and
+#          the size is taken from the .width and .height initializers
+#   other  Raw big endian data. The format follows from the file size:
+#          RGB1555, or 8 or 4 bit indices into palette=
+#
+# Palettes are raw big endian RGB1555 (.PAL) or a .c file as above. Index 0,
+# and RGB 0x0000, are transparent. A sprite with frames=<n> is a vertical strip
+# of <n> frames, each height/<n> texels tall. All frames of a sprite share one
+# color mode and palette. The last index of a palette is the end code, and is
+# only used by sprites marked endcode=off, which must be drawn with end codes
+# disabled.
+#
+# Each sprite gets the smallest color mode its colors fit in:
+#
+#   1  4 bpp, through a 16 color lookup table stored in the atlas
+#   4  8 bpp, through a 256 color bank in VDP2 CRAM
+#   5  16 bpp RGB
+#
+# Sprites are padded with transparent texels to a multiple of 8 texels wide,
+# and every frame and lookup table starts on an 8 byte boundary. Palettes are
+# shared between sprites whenever their colors fit.
+#
+# The outputs are:
+#
+#   <output>.TEX  The atlas, uploaded to an 8 byte aligned VDP1 VRAM address
+#   <output>.PAL  The 256 color banks, back to back, for VDP2 CRAM. Not written
+#                 if no sprite needs one
+#   <output>.c    The manifest, a sprite_atlas_t named <symbol>
+#   <output>.h    Declares <symbol> and a <SYMBOL>_<NAME> index per sprite
+
+import os
+import re
+import struct
+import sys
+import zlib
+
+COLOR_MODE_CLUT_4BPP = 1
+COLOR_MODE_BANK_8BPP = 4
+COLOR_MODE_RGB = 5
+
+# Index 0 is transparent, and the last index is the end code
+CLUT_COLOR_COUNT = 16
+BANK_COLOR_COUNT = 256
+
+# Also the RGB end code, so opaque texels always have the MSB set
+TRANSPARENT = 0x0000
+
+ALIGNMENT = 8
+
+
+class Sprite:
+    def __init__(self, name, width, height, frame_count, texels, end_code):
+        self.name = name
+        self.end_code = end_code
+        self.width = width
+        self.height = height
+        self.frame_count = frame_count
+        # RGB1555, TRANSPARENT or with the MSB set, width * height * frames
+        self.texels = texels
+        self.color_mode = COLOR_MODE_RGB
+        self.palette = None
+        self.offset = 0
+        self.frame_size = 0
+
+
+def error(message):
+    print("%s: %s" % (os.path.basename(sys.argv[0]), message), file=sys.stderr)
+    sys.exit(1)
+
+
+def align(value):
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+
+def rgb1555(r, g, b):
+    return 0x8000 | ((b >> 3) << 10) | ((g >> 3) << 5) | (r >> 3)
+
+
+def c_arrays_read(path):
+    with open(path, "r") as fp:
+        source = fp.read()
+    arrays = {}
+    for match in re.finditer(r"uint16_t\s+(\w+)\s*\[\s*\]\s*=\s*\{([^}]*)\}", source):
+        arrays[match.group(1)] = [int(value, 0) for value in match.group(2).replace(",", " ").split()]
+    size = {}
+    for field in ("width", "height"):
+        match = re.search(r"\.%s\s*=\s*(\d+)" % (field), source)
+        if match is not None:
+            size[field] = int(match.group(1))
+    return arrays, size
+
+
+def words_to_bytes(words):
+    return struct.pack(">%iH" % (len(words)), *words)
+
+
+def palette_read(path):
+    if path.endswith(".c"):
+        arrays, _ = c_arrays_read(path)
+        for name, words in arrays.items():
+            if "palette" in name:
+                return words
+        error("%s: no palette array" % (path))
+
+    with open(path, "rb") as fp:
+        data = fp.read()
+    return list(struct.unpack(">%iH" % (len(data) // 2), data[:len(data) & ~1]))
+
+
+def png_read(path):
+    with open(path, "rb") as fp:
+        data = fp.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        error("%s: not a PNG" % (path))
+
+    offset = 8
+    idat = b""
+    plte = b""
+    trns = b""
+    while offset < len(data):
+        length, kind = struct.unpack(">I4s", data[offset:offset + 8])
+        chunk = data[offset + 8:offset + 8 + length]
+        offset += length + 12
+        if kind == b"IHDR":
+            width, height, depth, color_type, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            plte = chunk
+        elif kind == b"tRNS":
+            trns = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+        elif kind == b"IEND":
+            break
+
+    if interlace != 0:
+        error("%s: interlaced PNGs aren't supported" % (path))
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color_type]
+    if (depth != 8) and not ((color_type == 3) and (depth in (1, 2, 4))):
+        error("%s: unsupported bit depth %i" % (path, depth))
+
+    bpp = max(1, (channels * depth) // 8)
+    stride = ((width * channels * depth) + 7) // 8
+    raw = zlib.decompress(idat)
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        base = y * (stride + 1)
+        kind = raw[base]
+        row = bytearray(raw[base + 1:base + 1 + stride])
+        for i in range(stride):
+            a = row[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                row[i] = (row[i] + a) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + b) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                row[i] = (row[i] + (a if (pa <= pb and pa <= pc) else (b if pb <= pc else c))) & 0xFF
+        rows.append(row)
+        prev = row
+
+    texels = []
+    for row in rows:
+        for x in range(width):
+            if color_type == 3:
+                per_byte = 8 // depth
+                value = (row[x // per_byte] >> ((per_byte - 1 - (x % per_byte)) * depth)) & ((1 << depth) - 1)
+                alpha = trns[value] if value < len(trns) else 255
+                r, g, b = plte[value * 3:value * 3 + 3]
+            elif color_type in (0, 4):
+                r = g = b = row[x * channels]
+                alpha = row[x * channels + 1] if color_type == 4 else 255
+            else:
+                r, g, b = row[x * channels:x * channels + 3]
+                alpha = row[x * channels + 3] if color_type == 6 else 255
+            texels.append(TRANSPARENT if alpha < 128 else rgb1555(r, g, b))
+    return width, height, texels
+
+
+def indexed_to_rgb(indices, palette, path):
+    texels = []
+    for index in indices:
+        if index == 0:
+            texels.append(TRANSPARENT)
+        elif index >= len(palette):
+            error("%s: index %i is past the end of the palette" % (path, index))
+        else:
+            texels.append(0x8000 | palette[index])
+    return texels
+
+
+def sprite_read(path, options):
+    width = int(options["width"], 0) if "width" in options else 0
+    height = int(options["height"], 0) if "height" in options else 0
+    frame_count = int(options.get("frames", "1"), 0)
+    palette = palette_read(options["palette"]) if "palette" in options else None
+
+    if path.endswith(".png"):
+        width, height, texels = png_read(path)
+    else:
+        if path.endswith(".c"):
+            arrays, size = c_arrays_read(path)
+            names = [name for name in arrays if "palette" not in name]
+            if len(names) == 0:
+                error("%s: no data array" % (path))
+            data = words_to_bytes(arrays[names[0]])
+            width = width or size.get("width", 0)
+            height = height or size.get("height", 0)
+            if (palette is None) and any("palette" in name for name in arrays):
+                palette = palette_read(path)
+        else:
+            with open(path, "rb") as fp:
+                data = fp.read()
+
+        if (width == 0) or (height == 0):
+            error("%s: width and height are needed" % (path))
+
+        texel_count = width * height
+        if len(data) == (texel_count * 2):
+            texels = [TRANSPARENT if value == 0 else (0x8000 | value)
+                      for value in struct.unpack(">%iH" % (texel_count), data)]
+        elif palette is None:
+            error("%s: indexed data needs palette=" % (path))
+        elif len(data) == texel_count:
+            texels = indexed_to_rgb(data, palette, path)
+        elif (len(data) * 2) == texel_count:
+            indices = []
+            for value in data:
+                indices.extend((value >> 4, value & 0x0F))
+            texels = indexed_to_rgb(indices, palette, path)
+        else:
+            error("%s: %i bytes isn't %ix%i at 4, 8 or 16 bpp" % (path, len(data), width, height))
+
+    if (height % frame_count) != 0:
+        error("%s: height %i isn't a multiple of %i frames" % (path, height, frame_count))
+
+    # Pad each row to a multiple of 8 texels
+    padded_width = align(width)
+    padded = []
+    for y in range(height):
+        padded.extend(texels[y * width:(y + 1) * width])
+        padded.extend([TRANSPARENT] * (padded_width - width))
+
+    return Sprite(options["name"], padded_width, height // frame_count, frame_count, padded,
+                  options.get("endcode", "on") != "off")
+
+
+def spec_read(path):
+    sprites = []
+    spec_dir = os.path.dirname(path)
+    with open(path, "r") as fp:
+        for line in fp:
+            fields = line.split()
+            if (len(fields) == 0) or fields[0].startswith("#"):
+                continue
+            options = dict(field.split("=", 1) for field in fields[1:])
+            if "name" not in options:
+                error("%s: missing name=" % (fields[0]))
+            if "palette" in options:
+                options["palette"] = os.path.join(spec_dir, options["palette"])
+            sprites.append(sprite_read(os.path.join(spec_dir, fields[0]), options))
+    return sprites
+
+
+def palette_place(palettes, colors, capacity):
+    """Returns the palette the colors fit in the first capacity entries of,
+    adding to it or creating a new one. Colors are only ever appended, so
+    earlier sprites keep their indices"""
+    best = None
+    for palette in palettes:
+        missing = [color for color in colors if color not in palette]
+        if (len(palette) + len(missing)) > capacity:
+            continue
+        if any(palette.index(color) >= capacity for color in colors if color in palette):
+            continue
+        # Prefer the palette that needs the fewest new colors
+        if (best is None) or (len(missing) < best[1]):
+            best = (palette, len(missing))
+    if best is None:
+        palette = []
+        palettes.append(palette)
+    else:
+        palette = best[0]
+    for color in colors:
+        if color not in palette:
+            palette.append(color)
+    return palette
+
+
+def sprites_color_assign(sprites):
+    cluts = []
+    banks = []
+    # Place the sprites with the most colors first, so the small ones can fill
+    # in the gaps
+    order = sorted(sprites, key=lambda sprite: -len(set(sprite.texels)))
+    for sprite in order:
+        colors = sorted(set(sprite.texels) - {TRANSPARENT})
+        # Without transparent and, unless the sprite disables them, the end code
+        reserved = 2 if sprite.end_code else 1
+        if len(colors) <= (CLUT_COLOR_COUNT - reserved):
+            sprite.color_mode = COLOR_MODE_CLUT_4BPP
+            sprite.palette = palette_place(cluts, colors, CLUT_COLOR_COUNT - reserved)
+        elif len(colors) <= (BANK_COLOR_COUNT - reserved):
+            sprite.color_mode = COLOR_MODE_BANK_8BPP
+            sprite.palette = palette_place(banks, colors, BANK_COLOR_COUNT - reserved)
+        else:
+            sprite.color_mode = COLOR_MODE_RGB
+    return cluts, banks
+
+
+def sprite_encode(sprite, frame):
+    frame_texel_count = sprite.width * sprite.height
+    texels = sprite.texels[frame * frame_texel_count:(frame + 1) * frame_texel_count]
+    if sprite.color_mode == COLOR_MODE_RGB:
+        return words_to_bytes(texels)
+    # Index 0 is transparent, so palette entry i is index i + 1
+    lookup = {color: index + 1 for index, color in enumerate(sprite.palette)}
+    lookup[TRANSPARENT] = 0
+    indices = [lookup[texel] for texel in texels]
+    if sprite.color_mode == COLOR_MODE_BANK_8BPP:
+        return bytes(indices)
+    return bytes((indices[i] << 4) | indices[i + 1] for i in range(0, len(indices), 2))
+
+
+def palette_encode(palette, color_count):
+    return words_to_bytes([TRANSPARENT] + palette + [TRANSPARENT] * (color_count - 1 - len(palette)))
+
+
+def main():
+    if len(sys.argv) != 4:
+        print("%s [spec] [output] [symbol]" % (os.path.basename(sys.argv[0])))
+        sys.exit(2)
+
+    spec_path = sys.argv[1]
+    output_path = sys.argv[2]
+    symbol = sys.argv[3]
+
+    sprites = spec_read(spec_path)
+    if len(sprites) == 0:
+        error("%s: no sprites" % (spec_path))
+
+    cluts, banks = sprites_color_assign(sprites)
+
+    # Group by color mode, so the frames that may need padding are together
+    atlas = bytearray()
+    padding = 0
+    for color_mode in (COLOR_MODE_RGB, COLOR_MODE_BANK_8BPP, COLOR_MODE_CLUT_4BPP):
+        for sprite in sprites:
+            if sprite.color_mode != color_mode:
+                continue
+            sprite.offset = len(atlas)
+            for frame in range(sprite.frame_count):
+                data = sprite_encode(sprite, frame)
+                sprite.frame_size = align(len(data))
+                padding += sprite.frame_size - len(data)
+                atlas += data + bytes(sprite.frame_size - len(data))
+
+    clut_offset = len(atlas)
+    for clut in cluts:
+        atlas += palette_encode(clut, CLUT_COLOR_COUNT)
+
+    output_dir = os.path.dirname(output_path)
+    output_name = os.path.basename(output_path)
+
+    with open(os.path.join(output_dir, output_name.upper() + ".TEX"), "wb") as fp:
+        fp.write(atlas)
+
+    if len(banks) > 0:
+        with open(os.path.join(output_dir, output_name.upper() + ".PAL"), "wb") as fp:
+            for bank in banks:
+                fp.write(palette_encode(bank, BANK_COLOR_COUNT))
+
+    with open(output_path + ".h", "w") as fp:
+        guard = symbol.upper() + "_H"
+        fp.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+        fp.write("#include \"sprite_batch.h\"\n\n")
+        for index, sprite in enumerate(sprites):
+            fp.write("#define %s_%s (%i)\n" % (symbol.upper(), sprite.name.upper(), index))
+        fp.write("\nextern const sprite_atlas_t %s;\n\n#endif /* %s */\n" % (symbol, guard))
+
+    with open(output_path + ".c", "w") as fp:
+        fp.write("#include \"%s.h\"\n\n" % (output_name))
+        fp.write("static const sprite_atlas_entry_t _entries[] = {\n")
+        for index, sprite in enumerate(sprites):
+            palette = 0
+            if sprite.color_mode == COLOR_MODE_CLUT_4BPP:
+                palette = cluts.index(sprite.palette)
+            elif sprite.color_mode == COLOR_MODE_BANK_8BPP:
+                palette = banks.index(sprite.palette)
+            fp.write("        { /* %s */\n" % (sprite.name))
+            fp.write("                .offset      = 0x%05X,\n" % (sprite.offset))
+            fp.write("                .frame_size  = 0x%05X,\n" % (sprite.frame_size))
+            fp.write("                .width       = %i,\n" % (sprite.width))
+            fp.write("                .height      = %i,\n" % (sprite.height))
+            fp.write("                .frame_count = %i,\n" % (sprite.frame_count))
+            fp.write("                .color_mode  = %i,\n" % (sprite.color_mode))
+            fp.write("                .palette     = %i\n" % (palette))
+            fp.write("        }%s\n" % ("," if (index + 1) < len(sprites) else ""))
+        fp.write("};\n\n")
+        fp.write("const sprite_atlas_t %s = {\n" % (symbol))
+        fp.write("        .entries     = _entries,\n")
+        fp.write("        .entry_count = %i,\n" % (len(sprites)))
+        fp.write("        .clut_offset = 0x%05X,\n" % (clut_offset))
+        fp.write("        .size        = 0x%05X\n" % (len(atlas)))
+        fp.write("};\n")
+
+    for sprite in sprites:
+        print("%-16s %3ix%-3i x%-3i mode %i, %6i bytes" % (sprite.name, sprite.width, sprite.height,
+              sprite.frame_count, sprite.color_mode, sprite.frame_size * sprite.frame_count))
+    print("%i bytes (%i padding), %i lookup tables, %i color banks" % (len(atlas), padding, len(cluts), len(banks)))
+
+
+if __name__ == "__main__":
+    main()
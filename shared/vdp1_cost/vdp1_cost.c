@@ -0,0 +1,264 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include "vdp1_cost.h"
+
+#define CMDCTRL_END          (1 << 15)
+#define CMDCTRL_JUMP_SKIP    (1 << 14)
+#define CMDCTRL_ZOOM_POINT(x) (((x) >> 8) & 0x000F)
+#define CMDCTRL_COMMAND(x)   ((x) & 0x000F)
+
+#define CMDPMOD_MSB_ON        (1 << 15)
+#define CMDPMOD_COLOR_MODE(x) (((x) >> 3) & 0x0007)
+#define CMDPMOD_CC_MASK       (0x0007)
+#define CMDPMOD_CC_SHADOW     (0x0001)
+#define CMDPMOD_CC_HALF_TRANS (0x0003)
+#define CMDPMOD_CC_GOURAUD    (0x0004)
+
+#define COMMAND_NORMAL_SPRITE    (0x0)
+#define COMMAND_SCALED_SPRITE    (0x1)
+#define COMMAND_DISTORTED_SPRITE (0x2)
+#define COMMAND_POLYGON          (0x4)
+#define COMMAND_POLYLINE         (0x5)
+#define COMMAND_LINE             (0x6)
+
+/* Widths and heights are clamped to this. The VDP1 only keeps 13 bits of each
+ * coordinate, so nothing it draws can be any larger */
+#define EXTENT_MAX (8192)
+
+/* The VDP1 takes about a cycle per untextured pixel, and eight cycles make a
+ * tick */
+const vdp1_cost_model_t vdp1_cost_model_default = {
+        .cmdt    = 1280,
+        .line    = 256,
+        .pixel   = {
+                [VDP1_COST_PIXEL_UNTEXTURED] = 32,
+                [VDP1_COST_PIXEL_4BPP]       = 40,
+                [VDP1_COST_PIXEL_8BPP]       = 48,
+                [VDP1_COST_PIXEL_16BPP]      = 64
+        },
+        .gouraud = 8,
+        .blend   = 64
+};
+
+static void _area_estimate(const vdp1_cmdt_t *cmdt, uint32_t *lines,
+    uint32_t *pixels);
+static uint32_t _length_calculate(const int16_vec2_t *a, const int16_vec2_t *b);
+
+uint32_t
+vdp1_cost_pixel_get(const vdp1_cost_model_t *model, uint16_t command,
+    uint16_t draw_mode)
+{
+        uint32_t cost;
+
+        if (command <= COMMAND_DISTORTED_SPRITE + 1) {
+                switch (CMDPMOD_COLOR_MODE(draw_mode)) {
+                case 0:
+                case 1:
+                        cost = model->pixel[VDP1_COST_PIXEL_4BPP];
+                        break;
+                case 2:
+                case 3:
+                case 4:
+                        cost = model->pixel[VDP1_COST_PIXEL_8BPP];
+                        break;
+                default:
+                        cost = model->pixel[VDP1_COST_PIXEL_16BPP];
+                        break;
+                }
+        } else {
+                cost = model->pixel[VDP1_COST_PIXEL_UNTEXTURED];
+        }
+
+        const uint16_t cc = draw_mode & CMDPMOD_CC_MASK;
+
+        if ((cc & CMDPMOD_CC_GOURAUD) != 0) {
+                cost += model->gouraud;
+        }
+
+        const uint16_t blend_cc = cc & ~CMDPMOD_CC_GOURAUD;
+
+        if ((blend_cc == CMDPMOD_CC_SHADOW) ||
+            (blend_cc == CMDPMOD_CC_HALF_TRANS) ||
+            ((draw_mode & CMDPMOD_MSB_ON) != 0)) {
+                cost += model->blend;
+        }
+
+        return cost;
+}
+
+uint32_t
+vdp1_cost_cmdt_estimate(const vdp1_cost_model_t *model, const vdp1_cmdt_t *cmdt)
+{
+        if ((cmdt->cmd_ctrl & CMDCTRL_END) != 0) {
+                return 0;
+        }
+
+        /* In 64 bits, as a primitive far off screen can cover more pixels
+         * than a 32-bit cost can hold */
+        uint64_t cost;
+        cost = model->cmdt;
+
+        /* Skipped command tables are still fetched */
+        if ((cmdt->cmd_ctrl & CMDCTRL_JUMP_SKIP) == 0) {
+                uint32_t lines;
+                uint32_t pixels;
+
+                _area_estimate(cmdt, &lines, &pixels);
+
+                const uint32_t pixel_cost = vdp1_cost_pixel_get(model,
+                    CMDCTRL_COMMAND(cmdt->cmd_ctrl), cmdt->cmd_pmod);
+
+                cost += ((uint64_t)lines * model->line) + ((uint64_t)pixels * pixel_cost);
+        }
+
+        /* Round up, so that a list of small primitives isn't free */
+        cost = (cost + (1 << VDP1_COST_SHIFT) - 1) >> VDP1_COST_SHIFT;
+
+        return min(cost, (uint64_t)UINT32_MAX);
+}
+
+uint32_t
+vdp1_cost_list_estimate(const vdp1_cost_model_t *model, const vdp1_cmdt_t *cmdts,
+    uint32_t count)
+{
+        uint32_t total;
+        total = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                if ((cmdts[i].cmd_ctrl & CMDCTRL_END) != 0) {
+                        break;
+                }
+
+                const uint32_t cost = vdp1_cost_cmdt_estimate(model, &cmdts[i]);
+
+                /* Saturate rather than wrap */
+                total = (cost > (UINT32_MAX - total)) ? UINT32_MAX : (total + cost);
+        }
+
+        return total;
+}
+
+uint32_t
+vdp1_budget_fit(vdp1_budget_entry_t *entries, uint32_t count, uint32_t budget)
+{
+        uint32_t total;
+        total = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                total += entries[i].cost;
+        }
+
+        if (total <= budget) {
+                return count;
+        }
+
+        /* Insertion sort, highest priority first. Lists are short, and equal
+         * priorities keep their order */
+        for (uint32_t i = 1; i < count; i++) {
+                const vdp1_budget_entry_t entry = entries[i];
+
+                uint32_t j;
+
+                for (j = i; (j > 0) && (entries[j - 1].priority < entry.priority); j--) {
+                        entries[j] = entries[j - 1];
+                }
+
+                entries[j] = entry;
+        }
+
+        /* Stop at the first entry that doesn't fit, rather than keep a lower
+         * priority entry that happens to be cheaper */
+        uint32_t kept_count;
+        kept_count = 0;
+
+        total = 0;
+
+        for (; kept_count < count; kept_count++) {
+                if ((total + entries[kept_count].cost) > budget) {
+                        break;
+                }
+
+                total += entries[kept_count].cost;
+        }
+
+        return kept_count;
+}
+
+static void
+_area_estimate(const vdp1_cmdt_t *cmdt, uint32_t *lines, uint32_t *pixels)
+{
+        const int16_vec2_t * const v = cmdt->cmd_vertices;
+
+        uint32_t width;
+        uint32_t height;
+
+        switch (CMDCTRL_COMMAND(cmdt->cmd_ctrl)) {
+        case COMMAND_NORMAL_SPRITE:
+                width = ((cmdt->cmd_size >> 8) & 0x3F) << 3;
+                height = cmdt->cmd_size & 0xFF;
+
+                *lines = height;
+                *pixels = width * height;
+                break;
+        case COMMAND_SCALED_SPRITE:
+                /* With a zoom point, vertex B holds the display size.
+                 * Without, vertices A and C are opposite corners */
+                if (CMDCTRL_ZOOM_POINT(cmdt->cmd_ctrl) != 0) {
+                        width = abs(v[1].x);
+                        height = abs(v[1].y);
+                } else {
+                        width = abs(v[2].x - v[0].x) + 1;
+                        height = abs(v[2].y - v[0].y) + 1;
+                }
+
+                width = min(width, (uint32_t)EXTENT_MAX);
+                height = min(height, (uint32_t)EXTENT_MAX);
+
+                *lines = height;
+                *pixels = width * height;
+                break;
+        case COMMAND_DISTORTED_SPRITE:
+        case COMMAND_DISTORTED_SPRITE + 1:
+        case COMMAND_POLYGON:
+                /* Lines are drawn from edge AD to edge BC, as many as the
+                 * longer of the two is long. Each is as long as the
+                 * distance between the edges there */
+                height = max(_length_calculate(&v[0], &v[3]),
+                    _length_calculate(&v[1], &v[2])) + 1;
+                width = ((_length_calculate(&v[0], &v[1]) +
+                        _length_calculate(&v[3], &v[2])) / 2) + 1;
+
+                *lines = height;
+                *pixels = width * height;
+                break;
+        case COMMAND_POLYLINE:
+        case COMMAND_POLYLINE + 2:
+                *lines = 4;
+                *pixels = _length_calculate(&v[0], &v[1]) +
+                    _length_calculate(&v[1], &v[2]) +
+                    _length_calculate(&v[2], &v[3]) +
+                    _length_calculate(&v[3], &v[0]) + 4;
+                break;
+        case COMMAND_LINE:
+                *lines = 1;
+                *pixels = _length_calculate(&v[0], &v[1]) + 1;
+                break;
+        default:
+                /* Clip and local coordinates */
+                *lines = 0;
+                *pixels = 0;
+                break;
+        }
+}
+
+/* The VDP1 steps a pixel at a time along the major axis */
+static uint32_t
+_length_calculate(const int16_vec2_t *a, const int16_vec2_t *b)
+{
+        const uint32_t length = max(abs(b->x - a->x), abs(b->y - a->y));
+
+        return min(length, (uint32_t)EXTENT_MAX);
+}
@@ -0,0 +1,81 @@
+#ifndef _SHARED_VDP1_COST_VDP1_COST_H_
+#define _SHARED_VDP1_COST_VDP1_COST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <yaul.h>
+
+/* How each pixel is fetched: no texture, or a texel of 4, 8, or 16 bits */
+#define VDP1_COST_PIXEL_UNTEXTURED (0)
+#define VDP1_COST_PIXEL_4BPP       (1)
+#define VDP1_COST_PIXEL_8BPP       (2)
+#define VDP1_COST_PIXEL_16BPP      (3)
+#define VDP1_COST_PIXEL_COUNT      (4)
+
+/* Costs are in 1/256 of a perf.c tick (the CPU clock divided by 8), so that
+ * per pixel costs of a fraction of a tick can be stored */
+#define VDP1_COST_SHIFT (8)
+
+typedef struct vdp1_cost_model {
+        /* Fetching and setting up a command table */
+        uint32_t cmdt;
+        /* Setting up each line of a sprite or polygon */
+        uint32_t line;
+        /* Per pixel, by how the pixel is fetched */
+        uint32_t pixel[VDP1_COST_PIXEL_COUNT];
+        /* Added per pixel for gouraud shading */
+        uint32_t gouraud;
+        /* Added per pixel for shadows, half-transparency, and the MSB on
+         * mode, which read back from the framebuffer */
+        uint32_t blend;
+} vdp1_cost_model_t;
+
+/* One entry of a list to fit into a budget */
+typedef struct vdp1_budget_entry {
+        /* In ticks */
+        uint32_t cost;
+        /* Higher priority entries are kept first */
+        uint16_t priority;
+        /* Free for the caller, usually an index into its own list */
+        uint16_t index;
+} vdp1_budget_entry_t;
+
+/* Rough figures for a 28.6 MHz clock. Calibrate for real ones */
+extern const vdp1_cost_model_t vdp1_cost_model_default;
+
+/* Times the VDP1 drawing a few primitives, and fits the model to them. Call
+ * before the first vdp1_sync_render(), as this drives the VDP1 directly and
+ * overwrites the start of the command table partition. Run it on hardware, or
+ * on an emulator whose VDP1 timing is to be trusted */
+void vdp1_cost_calibrate(vdp1_cost_model_t *model, uint16_t width,
+    uint16_t height);
+
+/* Returns how many ticks the VDP1 takes to draw cmdts, after setting the clip
+ * and local coordinates to a width x height screen, centered on the origin.
+ * Same caveats as vdp1_cost_calibrate() */
+uint32_t vdp1_cost_draw_time(const vdp1_cmdt_t *cmdts, uint32_t count,
+    uint16_t width, uint16_t height);
+
+/* Returns the per pixel cost for a command (the low 4 bits of CMDCTRL) drawn
+ * with a draw mode (CMDPMOD) */
+uint32_t vdp1_cost_pixel_get(const vdp1_cost_model_t *model, uint16_t command,
+    uint16_t draw_mode);
+
+/* Returns the estimated cost of drawing a command table, in ticks. Off screen
+ * pixels are counted, as the VDP1 still walks them */
+uint32_t vdp1_cost_cmdt_estimate(const vdp1_cost_model_t *model,
+    const vdp1_cmdt_t *cmdt);
+
+/* Returns the estimated cost of a list, in ticks, stopping at the end command */
+uint32_t vdp1_cost_list_estimate(const vdp1_cost_model_t *model,
+    const vdp1_cmdt_t *cmdts, uint32_t count);
+
+/* Drops the lowest priority entries until the rest fit in budget ticks. The
+ * entries are reordered so that the ones kept come first, highest priority
+ * first. Returns how many are kept, which is less than count if the list is
+ * over budget */
+uint32_t vdp1_budget_fit(vdp1_budget_entry_t *entries, uint32_t count,
+    uint32_t budget);
+
+#endif /* !_SHARED_VDP1_COST_VDP1_COST_H_ */
@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include "perf.h"
+#include "vdp1_cost.h"
+
+/* Drives the VDP1 directly, so unlike vdp1_cost.c, this only builds for the
+ * Saturn */
+
+/* System clip, user clip, and local coordinates */
+#define PRELUDE_CMDT_COUNT (3)
+
+/* CEF, set by the VDP1 when it's done drawing */
+#define EDSR_CEF (1 << 1)
+
+#define CMDPMOD_CC_HALF_TRANS (0x0003)
+#define CMDPMOD_CC_GOURAUD    (0x0004)
+
+/* Number of 1x1 polygons drawn to time the command table cost */
+#define CALIBRATE_CMDT_COUNT (64)
+/* Width and height of the square drawn to time the per pixel costs */
+#define CALIBRATE_SIZE       (192)
+
+static void _square_set(vdp1_cmdt_t *cmdt, int16_t left, int16_t top,
+    int16_t right, int16_t bottom);
+static uint32_t _square_draw_time(const vdp1_cmdt_t *cmdt, uint16_t width,
+    uint16_t height);
+static uint32_t _per_pixel_solve(int32_t ticks, int32_t known, int32_t pixels);
+
+void
+vdp1_cost_calibrate(vdp1_cost_model_t *model, uint16_t width, uint16_t height)
+{
+        assert(width >= CALIBRATE_SIZE);
+        assert(height >= CALIBRATE_SIZE);
+
+        const int16_t left = -(CALIBRATE_SIZE / 2);
+        const int16_t right = (CALIBRATE_SIZE / 2) - 1;
+
+        vdp1_vram_partitions_t vdp1_vram_partitions;
+
+        vdp1_vram_partitions_get(&vdp1_vram_partitions);
+
+        vdp1_cmdt_t * const cmdts = malloc(sizeof(vdp1_cmdt_t) * CALIBRATE_CMDT_COUNT);
+        assert(cmdts != NULL);
+
+        perf_init();
+
+        vdp1_cmdt_draw_mode_t draw_mode;
+        draw_mode.raw = 0x0000;
+
+        /* The cost of a command table, from polygons a pixel in size */
+        for (uint32_t i = 0; i < CALIBRATE_CMDT_COUNT; i++) {
+                vdp1_cmdt_polygon_set(&cmdts[i]);
+                vdp1_cmdt_draw_mode_set(&cmdts[i], draw_mode);
+                cmdts[i].cmd_colr = 0x8000;
+
+                _square_set(&cmdts[i], 0, 0, 0, 0);
+        }
+
+        const uint32_t cmdts_ticks =
+            vdp1_cost_draw_time(cmdts, CALIBRATE_CMDT_COUNT, width, height);
+
+        model->cmdt = (cmdts_ticks << VDP1_COST_SHIFT) /
+            (CALIBRATE_CMDT_COUNT + PRELUDE_CMDT_COUNT);
+
+        vdp1_cmdt_t * const cmdt = &cmdts[0];
+
+        /* A column a pixel wide, then the full square. The difference is all
+         * in the pixels, and what's left of the column is in the lines */
+        _square_set(cmdt, 0, left, 0, right);
+        const uint32_t column_ticks = _square_draw_time(cmdt, width, height);
+
+        _square_set(cmdt, left, left, right, right);
+        const uint32_t square_ticks = _square_draw_time(cmdt, width, height);
+
+        const int32_t square_pixels = CALIBRATE_SIZE * CALIBRATE_SIZE;
+
+        model->pixel[VDP1_COST_PIXEL_UNTEXTURED] =
+            _per_pixel_solve(square_ticks - column_ticks, 0,
+                square_pixels - CALIBRATE_SIZE);
+
+        const int32_t lines_cost = (column_ticks << VDP1_COST_SHIFT) -
+            model->cmdt - (CALIBRATE_SIZE * model->pixel[VDP1_COST_PIXEL_UNTEXTURED]);
+
+        model->line = (lines_cost > 0) ? (lines_cost / CALIBRATE_SIZE) : 0;
+
+        const int32_t known_cost = model->cmdt + (CALIBRATE_SIZE * model->line);
+
+        /* The gouraud table can hold anything. Only the time matters */
+        draw_mode.raw = CMDPMOD_CC_GOURAUD;
+        vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
+        vdp1_cmdt_gouraud_base_set(cmdt, (vdp1_vram_t)vdp1_vram_partitions.gouraud_base);
+
+        model->gouraud = _per_pixel_solve(_square_draw_time(cmdt, width, height),
+            known_cost + (square_pixels * model->pixel[VDP1_COST_PIXEL_UNTEXTURED]),
+            square_pixels);
+
+        draw_mode.raw = CMDPMOD_CC_HALF_TRANS;
+        vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
+
+        model->blend = _per_pixel_solve(_square_draw_time(cmdt, width, height),
+            known_cost + (square_pixels * model->pixel[VDP1_COST_PIXEL_UNTEXTURED]),
+            square_pixels);
+
+        /* Same with whatever is in the texture partition */
+        const vdp1_cmdt_color_bank_t color_bank = {
+                .raw = 0x0000
+        };
+
+        draw_mode.raw = 0x0000;
+
+        vdp1_cmdt_distorted_sprite_set(cmdt);
+        vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
+        vdp1_cmdt_char_base_set(cmdt, (vdp1_vram_t)vdp1_vram_partitions.texture_base);
+        vdp1_cmdt_char_size_set(cmdt, 64, 64);
+        _square_set(cmdt, left, left, right, right);
+
+        vdp1_cmdt_color_mode0_set(cmdt, color_bank);
+        model->pixel[VDP1_COST_PIXEL_4BPP] =
+            _per_pixel_solve(_square_draw_time(cmdt, width, height), known_cost,
+                square_pixels);
+
+        vdp1_cmdt_color_mode4_set(cmdt, color_bank);
+        model->pixel[VDP1_COST_PIXEL_8BPP] =
+            _per_pixel_solve(_square_draw_time(cmdt, width, height), known_cost,
+                square_pixels);
+
+        vdp1_cmdt_color_mode5_set(cmdt);
+        model->pixel[VDP1_COST_PIXEL_16BPP] =
+            _per_pixel_solve(_square_draw_time(cmdt, width, height), known_cost,
+                square_pixels);
+
+        free(cmdts);
+}
+
+uint32_t
+vdp1_cost_draw_time(const vdp1_cmdt_t *cmdts, uint32_t count, uint16_t width,
+    uint16_t height)
+{
+        const int16_vec2_t system_clip_coord =
+            INT16_VEC2_INITIALIZER(width - 1, height - 1);
+
+        const int16_vec2_t user_clip_ul =
+            INT16_VEC2_INITIALIZER(0, 0);
+
+        const int16_vec2_t user_clip_lr =
+            INT16_VEC2_INITIALIZER(width - 1, height - 1);
+
+        const int16_vec2_t local_coord =
+            INT16_VEC2_INITIALIZER(width / 2, height / 2);
+
+        vdp1_cmdt_t * const vram_cmdts = (vdp1_cmdt_t *)VDP1_CMD_TABLE(0, 0);
+
+        vdp1_cmdt_system_clip_coord_set(&vram_cmdts[0]);
+        vdp1_cmdt_vtx_system_clip_coord_set(&vram_cmdts[0], system_clip_coord);
+
+        vdp1_cmdt_user_clip_coord_set(&vram_cmdts[1]);
+        vdp1_cmdt_vtx_user_clip_coord_set(&vram_cmdts[1], user_clip_ul, user_clip_lr);
+
+        vdp1_cmdt_local_coord_set(&vram_cmdts[2]);
+        vdp1_cmdt_vtx_local_coord_set(&vram_cmdts[2], local_coord);
+
+        if (count > 0) {
+                scu_dma_transfer(0, &vram_cmdts[PRELUDE_CMDT_COUNT], cmdts,
+                    sizeof(vdp1_cmdt_t) * count);
+                scu_dma_transfer_wait(0);
+        }
+
+        vdp1_cmdt_end_set(&vram_cmdts[PRELUDE_CMDT_COUNT + count]);
+
+        /* Keep the sprite end interrupt from reaching the VDP1 sync code */
+        const scu_ic_mask_t mask = scu_ic_mask_get();
+        scu_ic_mask_set(SCU_IC_MASK_ALL);
+
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                MEMORY_WRITE(16, VDP1(PTMR), 0x0001);
+
+                /* CEF is cleared once drawing starts, then set when it ends.
+                 * Even the prelude takes longer to draw than the few cycles
+                 * it takes to start */
+                while ((MEMORY_READ(16, VDP1(EDSR)) & EDSR_CEF) != 0) {
+                }
+
+                while ((MEMORY_READ(16, VDP1(EDSR)) & EDSR_CEF) == 0) {
+                }
+        } perf_counter_end(&perf);
+
+        scu_ic_mask_set(mask);
+
+        return perf.ticks;
+}
+
+static void
+_square_set(vdp1_cmdt_t *cmdt, int16_t left, int16_t top, int16_t right,
+    int16_t bottom)
+{
+        cmdt->cmd_vertices[0].x = left;
+        cmdt->cmd_vertices[0].y = top;
+        cmdt->cmd_vertices[1].x = right;
+        cmdt->cmd_vertices[1].y = top;
+        cmdt->cmd_vertices[2].x = right;
+        cmdt->cmd_vertices[2].y = bottom;
+        cmdt->cmd_vertices[3].x = left;
+        cmdt->cmd_vertices[3].y = bottom;
+}
+
+static uint32_t
+_square_draw_time(const vdp1_cmdt_t *cmdt, uint16_t width, uint16_t height)
+{
+        return vdp1_cost_draw_time(cmdt, 1, width, height);
+}
+
+/* Returns what's left of ticks once known is taken out, per pixel. Timing
+ * noise can leave nothing, in which case the cost is taken to be 0 */
+static uint32_t
+_per_pixel_solve(int32_t ticks, int32_t known, int32_t pixels)
+{
+        const int32_t cost = (ticks << VDP1_COST_SHIFT) - known;
+
+        if (cost <= 0) {
+                return 0;
+        }
+
+        return cost / pixels;
+}
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "vdp1-balls.h"
 
@@ -18,6 +19,8 @@
 
 #include "q0_12_4.h"
 
+#include "vdp1_cost.h"
+
 #define VDP1_VRAM_CMDT_COUNT    (BALL_MAX_COUNT + 3)
 #define VDP1_VRAM_TEXTURE_SIZE  (0x0005BF60)
 #define VDP1_VRAM_GOURAUD_COUNT (1024)
@@ -46,6 +49,9 @@
 
 #define BALL_SPEED (0x000E)
 
+/* A 60 Hz frame is about 59700 ticks. Leave some for the estimate being off */
+#define VDP1_BUDGET_TICKS (50000)
+
 static q0_12_4_t _balls_pos_x[BALL_MAX_COUNT] __aligned(0x1000);
 static q0_12_4_t _balls_pos_y[BALL_MAX_COUNT] __aligned(0x1000);
 
@@ -54,6 +60,8 @@ static int16_t _balls_cmd_ya[2][BALL_MAX_COUNT] __aligned(0x1000);
 
 static volatile uint32_t _transfer_over_count = 0;
 
+static vdp1_cost_model_t _cost_model;
+
 struct buffer_context {
         balls_handle_t *balls_handle;
         vdp1_cmdt_t *cmdt_draw_end;
@@ -66,6 +74,8 @@ static void _vblank_out_handler(void *work);
 
 static void _transfer_over(void *work);
 
+static uint32_t _balls_budget_count_calculate(void);
+
 int
 main(void)
 {
@@ -109,6 +119,10 @@ main(void)
         uint32_t balls_count;
         balls_count = 1;
 
+        /* Past this many, balls are moved but not drawn, rather than have the
+         * VDP1 run over into the next frame */
+        const uint32_t balls_budget_count = _balls_budget_count_calculate();
+
         balls_handle_t *balls_handle[2];
         smpc_peripheral_digital_t digital;
 
@@ -179,24 +193,26 @@ main(void)
                         balls_count = BALL_MAX_COUNT;
                 }
 
+                const uint32_t draw_count = min(balls_count, balls_budget_count);
+
                 perf_counter_start(&cpu_perf); {
                         balls_position_update(buffer_context->balls_handle, balls_count);
                         balls_position_clamp(buffer_context->balls_handle, balls_count);
 
-                        balls_cmdts_update(buffer_context->balls_handle, balls_count);
+                        balls_cmdts_update(buffer_context->balls_handle, draw_count);
                 } perf_counter_end(&cpu_perf);
 
                 /* Wait for the previous sync (if any) */
                 vdp1_sync_wait();
 
                 perf_counter_start(&dma_perf); {
-                        balls_cmdts_position_put(buffer_context->balls_handle, VDP1_CMDT_ORDER_BALL_START_INDEX, balls_count);
+                        balls_cmdts_position_put(buffer_context->balls_handle, VDP1_CMDT_ORDER_BALL_START_INDEX, draw_count);
                 } perf_counter_end(&dma_perf);
 
                 vdp1_cmdt_end_clear(previous_buffer_context->cmdt_draw_end);
 
                 buffer_context->cmdt_draw_end =
-                    (vdp1_cmdt_t *)VDP1_CMD_TABLE(VDP1_CMDT_ORDER_BALL_START_INDEX + balls_count, 0);
+                    (vdp1_cmdt_t *)VDP1_CMD_TABLE(VDP1_CMDT_ORDER_BALL_START_INDEX + draw_count, 0);
 
                 vdp1_cmdt_end_set(buffer_context->cmdt_draw_end);
 
@@ -211,6 +227,7 @@ main(void)
 
                 dbgio_printf("[H[2J"
                              "ball_count: %4lu, which: %lu\n"
+                             "drawn: %4lu (budget: %4lu)\n"
                              " CPU: %7lu (max: %7lu)\n"
                              " DMA: %7lu (max: %7lu)\n"
                              "VDP1: %7lu (max: %7lu)\n"
@@ -218,6 +235,8 @@ main(void)
                              "Transfer-over: %i\n",
                     balls_count,
                     which_context,
+                    draw_count,
+                    balls_budget_count,
                     cpu_perf.ticks,
                     cpu_perf.max_ticks,
                     dma_perf.ticks,
@@ -271,6 +290,16 @@ _vdp1_init(void)
 
         vdp2_sprite_priority_set(0, 6);
 
+        vdp1_env_set(&vdp1_env);
+
+        vdp1_vram_partitions_set(VDP1_VRAM_CMDT_COUNT,
+            VDP1_VRAM_TEXTURE_SIZE,
+            VDP1_VRAM_GOURAUD_COUNT,
+            VDP1_VRAM_CLUT_COUNT);
+
+        /* Calibrating overwrites the first command tables, so do it before
+         * they're written */
+        vdp1_cost_calibrate(&_cost_model, RESOLUTION_WIDTH, RESOLUTION_HEIGHT);
 
         const int16_vec2_t local_coords =
             INT16_VEC2_INITIALIZER((RESOLUTION_WIDTH / 2) - BALL_HWIDTH - 1,
@@ -292,13 +321,6 @@ _vdp1_init(void)
         vdp1_cmdt_vtx_local_coord_set(&cmdt[VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX],
             local_coords);
 
-        vdp1_env_set(&vdp1_env);
-
-        vdp1_vram_partitions_set(VDP1_VRAM_CMDT_COUNT,
-            VDP1_VRAM_TEXTURE_SIZE,
-            VDP1_VRAM_GOURAUD_COUNT,
-            VDP1_VRAM_CLUT_COUNT);
-
         vdp1_sync_interval_set(0);
 }
 
@@ -314,6 +336,27 @@ _vdp2_init(void)
         vdp2_tvmd_display_set();
 }
 
+static uint32_t
+_balls_budget_count_calculate(void)
+{
+        /* Only the size and color mode of the balls matter */
+        vdp1_cmdt_t cmdt;
+
+        (void)memset(&cmdt, 0x00, sizeof(vdp1_cmdt_t));
+
+        vdp1_cmdt_normal_sprite_set(&cmdt);
+        vdp1_cmdt_char_size_set(&cmdt, BALL_WIDTH, BALL_HEIGHT);
+
+        const uint32_t ball_cost =
+            max(vdp1_cost_cmdt_estimate(&_cost_model, &cmdt), 1);
+        /* The system clip and local coordinates */
+        const uint32_t prelude_cost =
+            vdp1_cost_list_estimate(&_cost_model, (vdp1_cmdt_t *)VDP1_CMD_TABLE(0, 0),
+                VDP1_CMDT_ORDER_BALL_START_INDEX);
+
+        return min((VDP1_BUDGET_TICKS - prelude_cost) / ball_cost, BALL_MAX_COUNT);
+}
+
 static void
 _vblank_out_handler(void *work __unused)
 {
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "cmdt_sync.h"
+
 #define SCREEN_WIDTH    320
 #define SCREEN_HEIGHT   224
 
@@ -30,6 +32,7 @@
 static smpc_peripheral_digital_t _digital;
 
 static vdp1_cmdt_list_t *_cmdt_list = NULL;
+static cmdt_sync_t _cmdt_sync;
 static vdp1_vram_partitions_t _vdp1_vram_partitions;
 
 static void _cmdt_list_init(void);
@@ -49,6 +52,8 @@ main(void)
         _cmdt_list_init();
         _primitives_init();
 
+        cmdt_sync_init(&_cmdt_sync, ORDER_COUNT, 0);
+
         int16_vec2_t a = INT16_VEC2_INITIALIZER( 0,  0);
         int16_vec2_t b = INT16_VEC2_INITIALIZER(16, 16);
 
@@ -92,7 +97,7 @@ main(void)
 
                 _primitive_move(cmdt_polygon, p->x, p->y);
 
-                vdp1_sync_cmdt_list_put(_cmdt_list, 0);
+                cmdt_sync_put(&_cmdt_sync, _cmdt_list);
                 vdp1_sync_render();
                 vdp1_sync();
                 vdp1_sync_wait();
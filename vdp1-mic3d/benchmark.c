@@ -0,0 +1,251 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include "benchmark.h"
+#include "clip.h"
+#include "perf.h"
+#include "vdp1_cost.h"
+#include "zsort.h"
+
+#define BUCKET_COUNT (512)
+/* 16-bit depth down to 9 bits */
+#define BUCKET_SHIFT (7)
+
+#define PRIMITIVE_COUNT_MAX (8192)
+
+#define SCREEN_WIDTH  (352)
+#define SCREEN_HEIGHT (224)
+
+#define CLIP_ITERATION_COUNT (64)
+
+typedef struct bucket_entry {
+        struct bucket_entry *next;
+        uint16_t index;
+} bucket_entry_t;
+
+static uint32_t _bucket_sort(const uint16_t *depths, uint32_t count,
+    bucket_entry_t **buckets, bucket_entry_t *entries, uint16_t *order);
+static uint32_t _radix_sort(zsort_t *zsort, const uint16_t *depths,
+    uint32_t count, uint16_t *order);
+
+static void _clip_case_run(const char *name, const clip_t *clip,
+    const vdp1_cmdt_t *cmdt, bool sprite);
+
+void
+benchmark_zsort_run(void)
+{
+        static const uint32_t primitive_counts[] = {
+                256, 512, 2048, 8192
+        };
+
+        uint16_t * const depths = malloc(sizeof(uint16_t) * PRIMITIVE_COUNT_MAX);
+        uint16_t * const order = malloc(sizeof(uint16_t) * PRIMITIVE_COUNT_MAX);
+        bucket_entry_t ** const buckets = malloc(sizeof(bucket_entry_t *) * BUCKET_COUNT);
+        bucket_entry_t * const entries = malloc(sizeof(bucket_entry_t) * PRIMITIVE_COUNT_MAX);
+
+        assert(depths != NULL);
+        assert(order != NULL);
+        assert(buckets != NULL);
+        assert(entries != NULL);
+
+        zsort_t zsort;
+        zsort_init(&zsort, PRIMITIVE_COUNT_MAX);
+
+        /* Any cheap pseudo random sequence will do */
+        uint32_t seed = 0x2545F491;
+
+        for (uint32_t i = 0; i < PRIMITIVE_COUNT_MAX; i++) {
+                seed = (seed * 1103515245) + 12345;
+
+                depths[i] = seed >> 16;
+        }
+
+        perf_init();
+
+        dbgio_printf("zsort benchmark (ticks)\n");
+
+        for (uint32_t i = 0; i < (sizeof(primitive_counts) / sizeof(*primitive_counts)); i++) {
+                const uint32_t count = primitive_counts[i];
+
+                const uint32_t bucket_ticks =
+                    _bucket_sort(depths, count, buckets, entries, order);
+                const uint32_t radix_ticks =
+                    _radix_sort(&zsort, depths, count, order);
+
+                dbgio_printf("%5lu: bucket %7lu, radix %7lu\n",
+                    count, bucket_ticks, radix_ticks);
+        }
+
+        zsort_deinit(&zsort);
+
+        free(entries);
+        free(buckets);
+        free(order);
+        free(depths);
+}
+
+void
+benchmark_clip_run(void)
+{
+        static const vdp1_cmdt_draw_mode_t draw_mode = {
+                .raw = 0x0000
+        };
+
+        static const int16_vec2_t polygon_centered[] = {
+                INT16_VEC2_INITIALIZER(-300, -300),
+                INT16_VEC2_INITIALIZER( 300, -300),
+                INT16_VEC2_INITIALIZER( 300,  300),
+                INT16_VEC2_INITIALIZER(-300,  300)
+        };
+
+        /* A floor, seen at an angle, with most of it off the bottom */
+        static const int16_vec2_t polygon_floor[] = {
+                INT16_VEC2_INITIALIZER(-220,   40),
+                INT16_VEC2_INITIALIZER( 220,   40),
+                INT16_VEC2_INITIALIZER( 700,  500),
+                INT16_VEC2_INITIALIZER(-700,  500)
+        };
+
+        /* The 100x100 backdrop, which fits on screen */
+        static const int16_vec2_t polygon_backdrop[] = {
+                INT16_VEC2_INITIALIZER( -50,  -50),
+                INT16_VEC2_INITIALIZER(  50,  -50),
+                INT16_VEC2_INITIALIZER(  50,   50),
+                INT16_VEC2_INITIALIZER( -50,   50)
+        };
+
+        /* Same as the floor, but textured */
+        static const int16_vec2_t sprite_floor[] = {
+                INT16_VEC2_INITIALIZER(-220,   40),
+                INT16_VEC2_INITIALIZER( 220,   40),
+                INT16_VEC2_INITIALIZER( 700,  500),
+                INT16_VEC2_INITIALIZER(-700,  500)
+        };
+
+        vdp1_vram_partitions_t vdp1_vram_partitions;
+
+        vdp1_vram_partitions_get(&vdp1_vram_partitions);
+
+        clip_t clip;
+        clip_init(&clip, -SCREEN_WIDTH / 2, -SCREEN_HEIGHT / 2,
+            (SCREEN_WIDTH / 2) - 1, (SCREEN_HEIGHT / 2) - 1, 0);
+
+        vdp1_cmdt_t cmdt;
+
+        perf_init();
+
+        dbgio_printf("clip benchmark (ticks)\n");
+
+        vdp1_cmdt_polygon_set(&cmdt);
+        vdp1_cmdt_draw_mode_set(&cmdt, draw_mode);
+        cmdt.cmd_colr = 0xBDEF;
+
+        vdp1_cmdt_vtx_set(&cmdt, polygon_centered);
+        _clip_case_run("centered", &clip, &cmdt, false);
+
+        vdp1_cmdt_vtx_set(&cmdt, polygon_floor);
+        _clip_case_run("floor", &clip, &cmdt, false);
+
+        vdp1_cmdt_vtx_set(&cmdt, polygon_backdrop);
+        _clip_case_run("backdrop", &clip, &cmdt, false);
+
+        /* Whatever is in the texture partition will do. Only the time it
+         * takes to draw matters */
+        vdp1_cmdt_distorted_sprite_set(&cmdt);
+        vdp1_cmdt_draw_mode_set(&cmdt, draw_mode);
+        vdp1_cmdt_color_mode5_set(&cmdt);
+        vdp1_cmdt_char_base_set(&cmdt, (vdp1_vram_t)vdp1_vram_partitions.texture_base);
+        vdp1_cmdt_char_size_set(&cmdt, 64, 64);
+
+        vdp1_cmdt_vtx_set(&cmdt, sprite_floor);
+        _clip_case_run("textured", &clip, &cmdt, true);
+}
+
+static void
+_clip_case_run(const char *name, const clip_t *clip, const vdp1_cmdt_t *cmdt,
+    bool sprite)
+{
+        vdp1_cmdt_t clipped[CLIP_CMDT_COUNT_MAX];
+        uint32_t clipped_count;
+        clipped_count = 0;
+
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                for (uint32_t i = 0; i < CLIP_ITERATION_COUNT; i++) {
+                        clipped_count = (sprite)
+                            ? clip_distorted_sprite(clip, cmdt, 16, clipped)
+                            : clip_polygon(clip, cmdt, clipped);
+                }
+        } perf_counter_end(&perf);
+
+        const uint32_t clip_ticks = perf.ticks / CLIP_ITERATION_COUNT;
+        const uint32_t unclipped_ticks =
+            vdp1_cost_draw_time(cmdt, 1, SCREEN_WIDTH, SCREEN_HEIGHT);
+        const uint32_t clipped_ticks =
+            vdp1_cost_draw_time(clipped, clipped_count, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+        dbgio_printf("%8s: vdp1 %7lu -> %7lu (%lu cmdts), cpu %5lu\n",
+            name, unclipped_ticks, clipped_ticks, clipped_count, clip_ticks);
+}
+
+static uint32_t
+_bucket_sort(const uint16_t *depths, uint32_t count, bucket_entry_t **buckets,
+    bucket_entry_t *entries, uint16_t *order)
+{
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                for (uint32_t i = 0; i < BUCKET_COUNT; i++) {
+                        buckets[i] = NULL;
+                }
+
+                for (uint32_t i = 0; i < count; i++) {
+                        const uint32_t bucket = depths[i] >> BUCKET_SHIFT;
+
+                        entries[i].next = buckets[bucket];
+                        entries[i].index = i;
+
+                        buckets[bucket] = &entries[i];
+                }
+
+                uint32_t order_index = 0;
+
+                for (int32_t i = BUCKET_COUNT - 1; i >= 0; i--) {
+                        for (const bucket_entry_t *entry = buckets[i]; entry != NULL; entry = entry->next) {
+                                order[order_index] = entry->index;
+                                order_index++;
+                        }
+                }
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
+
+static uint32_t
+_radix_sort(zsort_t *zsort, const uint16_t *depths, uint32_t count,
+    uint16_t *order)
+{
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                zsort_clear(zsort);
+
+                for (uint32_t i = 0; i < count; i++) {
+                        zsort_add(zsort, depths[i], i);
+                }
+
+                const uint32_t * const sorted = zsort_sort(zsort);
+
+                for (uint32_t i = 0; i < count; i++) {
+                        order[i] = ZSORT_ENTRY_INDEX(sorted[i]);
+                }
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* Compares a 512 bucket depth sort against the radix sort in zsort.c at 256,
+ * 512, 2048, and 8192 primitives. mic3d's own sort can't be called on its own,
+ * so the bucket sort is a stand-in written here to work the same way. Results
+ * are printed with dbgio */
+void benchmark_zsort_run(void);
+
+/* Times how long the VDP1 takes to draw large polygons and distorted sprites
+ * that are mostly off screen, with and without clip.c trimming them first, and
+ * how long the trimming takes. Call before the first vdp1_sync_render(), as
+ * this drives the VDP1 directly. Results are printed with dbgio */
+void benchmark_clip_run(void);
+
+#endif /* BENCHMARK_H */
@@ -0,0 +1,431 @@
+#include <assert.h>
+#include <string.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "clip.h"
+
+/* Each of the four edges of the rectangle can add a vertex */
+#define VERTEX_COUNT_MAX (8)
+
+/* Vertical flip, in CMDCTRL */
+#define CMD_CTRL_FLIP_V (1 << 5)
+
+/* Values of t, along the edges of a distorted sprite, that are well outside of
+ * the sprite */
+#define T_BEFORE (-FIX16(1.0))
+#define T_AFTER  (FIX16(2.0))
+
+typedef struct clip_vertex {
+        /* X, then Y */
+        int32_t c[2];
+} clip_vertex_t;
+
+typedef struct clip_interval {
+        fix16_t lo;
+        fix16_t hi;
+} clip_interval_t;
+
+static uint32_t _edge_clip(const clip_vertex_t *in, uint32_t in_count,
+    clip_vertex_t *out, uint32_t axis, int32_t sign, int32_t bound);
+
+static uint32_t _bounds_test(const clip_t *clip, const vdp1_cmdt_t *cmdt);
+static uint64_t _area2_calculate(const clip_vertex_t *vertices, uint32_t count);
+
+static void _below_interval_calculate(int32_t a0, int32_t a1, int32_t b0,
+    int32_t b1, int32_t c, clip_interval_t *interval);
+static void _half_line_below_clip(int32_t p0, int32_t p1, int32_t c,
+    clip_interval_t *interval);
+
+static int32_t _div_round(int64_t num, int32_t den);
+static int16_t _lerp(int16_t a, int16_t b, int32_t num, int32_t den);
+
+/* Results of _bounds_test() */
+#define BOUNDS_INSIDE  (0)
+#define BOUNDS_OUTSIDE (1)
+#define BOUNDS_CROSS   (2)
+
+void
+clip_init(clip_t *clip, int16_t left, int16_t top, int16_t right,
+    int16_t bottom, uint32_t area_min)
+{
+        assert(left <= right);
+        assert(top <= bottom);
+
+        clip->left = left;
+        clip->top = top;
+        clip->right = right;
+        clip->bottom = bottom;
+        clip->area_min = area_min;
+}
+
+uint32_t
+clip_polygon(const clip_t *clip, const vdp1_cmdt_t *cmdt, vdp1_cmdt_t *out)
+{
+        const uint32_t bounds = _bounds_test(clip, cmdt);
+
+        if (bounds == BOUNDS_OUTSIDE) {
+                return 0;
+        }
+
+        *out = *cmdt;
+
+        if (bounds == BOUNDS_INSIDE) {
+                return 1;
+        }
+
+        clip_vertex_t vertices[2][VERTEX_COUNT_MAX];
+
+        for (uint32_t i = 0; i < 4; i++) {
+                vertices[0][i].c[0] = cmdt->cmd_vertices[i].x;
+                vertices[0][i].c[1] = cmdt->cmd_vertices[i].y;
+        }
+
+        const uint64_t area2 = _area2_calculate(vertices[0], 4);
+
+        /* Clip against left, right, top, then bottom, ping-ponging between
+         * the two vertex buffers */
+        uint32_t count;
+        count = 4;
+
+        count = _edge_clip(vertices[0], count, vertices[1], 0, -1, clip->left);
+        count = _edge_clip(vertices[1], count, vertices[0], 0,  1, clip->right);
+        count = _edge_clip(vertices[0], count, vertices[1], 1, -1, clip->top);
+        count = _edge_clip(vertices[1], count, vertices[0], 1,  1, clip->bottom);
+
+        if (count < 3) {
+                return 0;
+        }
+
+        const uint64_t clipped_area2 = _area2_calculate(vertices[0], count);
+
+        if ((area2 - clipped_area2) < (clip->area_min * 2)) {
+                return 1;
+        }
+
+        /* Fan out from the first vertex, two triangles per quad. The last
+         * quad of an odd fan repeats its last vertex */
+        const clip_vertex_t * const v = vertices[0];
+        const uint32_t quad_count = (count - 1) / 2;
+
+        for (uint32_t i = 0; i < quad_count; i++) {
+                const uint32_t first = (i * 2) + 1;
+                const uint32_t last = min(first + 2, count - 1);
+
+                out[i] = *cmdt;
+
+                out[i].cmd_vertices[0].x = v[0].c[0];
+                out[i].cmd_vertices[0].y = v[0].c[1];
+                out[i].cmd_vertices[1].x = v[first].c[0];
+                out[i].cmd_vertices[1].y = v[first].c[1];
+                out[i].cmd_vertices[2].x = v[first + 1].c[0];
+                out[i].cmd_vertices[2].y = v[first + 1].c[1];
+                out[i].cmd_vertices[3].x = v[last].c[0];
+                out[i].cmd_vertices[3].y = v[last].c[1];
+        }
+
+        return quad_count;
+}
+
+uint32_t
+clip_distorted_sprite(const clip_t *clip, const vdp1_cmdt_t *cmdt,
+    uint32_t bits, vdp1_cmdt_t *out)
+{
+        assert((bits == 4) || (bits == 8) || (bits == 16));
+
+        const uint32_t bounds = _bounds_test(clip, cmdt);
+
+        if (bounds == BOUNDS_OUTSIDE) {
+                return 0;
+        }
+
+        *out = *cmdt;
+
+        const uint32_t height = cmdt->cmd_size & 0x00FF;
+
+        if ((bounds == BOUNDS_INSIDE) || (height < 2) ||
+            ((cmdt->cmd_ctrl & CMD_CTRL_FLIP_V) != 0)) {
+                return 1;
+        }
+
+        const int16_vec2_t * const a = &cmdt->cmd_vertices[0];
+        const int16_vec2_t * const b = &cmdt->cmd_vertices[1];
+        const int16_vec2_t * const c = &cmdt->cmd_vertices[2];
+        const int16_vec2_t * const d = &cmdt->cmd_vertices[3];
+
+        /* Row t of the texture is drawn from A + (D - A)t to B + (C - B)t.
+         * For each edge of the rectangle, find the values of t where that
+         * whole line is outside */
+        clip_interval_t intervals[4];
+
+        _below_interval_calculate(a->x, d->x, b->x, c->x, clip->left, &intervals[0]);
+        _below_interval_calculate(a->y, d->y, b->y, c->y, clip->top, &intervals[1]);
+        _below_interval_calculate(-a->x, -d->x, -b->x, -c->x, -clip->right, &intervals[2]);
+        _below_interval_calculate(-a->y, -d->y, -b->y, -c->y, -clip->bottom, &intervals[3]);
+
+        fix16_t t_first;
+        t_first = FIX16(0.0);
+        fix16_t t_last;
+        t_last = FIX16(1.0);
+
+        bool moved;
+
+        do {
+                moved = false;
+
+                for (uint32_t i = 0; i < 4; i++) {
+                        if ((intervals[i].lo < t_first) && (t_first < intervals[i].hi)) {
+                                t_first = intervals[i].hi;
+                                moved = true;
+                        }
+                }
+        } while (moved);
+
+        do {
+                moved = false;
+
+                for (uint32_t i = 0; i < 4; i++) {
+                        if ((intervals[i].lo < t_last) && (t_last < intervals[i].hi)) {
+                                t_last = intervals[i].lo;
+                                moved = true;
+                        }
+                }
+        } while (moved);
+
+        if ((t_first > FIX16(1.0)) || (t_last < FIX16(0.0)) || (t_last < t_first)) {
+                return 0;
+        }
+
+        /* Round outwards to whole rows. The first row kept also has to start
+         * on an 8 byte boundary */
+        const int32_t row_max = height - 1;
+        const uint32_t width = ((cmdt->cmd_size >> 8) & 0x3F) * 8;
+        const uint32_t row_size = (width * bits) >> 3;
+
+        int32_t row_first;
+        row_first = (t_first * row_max) >> 16;
+        int32_t row_last;
+        row_last = ((t_last * row_max) + 0xFFFF) >> 16;
+
+        row_first = max(row_first, 0);
+        row_last = min(row_last, row_max);
+
+        if (((row_first * row_size) & 7) != 0) {
+                row_first &= ~1;
+        }
+
+        const uint32_t row_drop_count = row_first + (row_max - row_last);
+
+        /* Estimate the area outside from the number of rows dropped */
+        clip_vertex_t vertices[4];
+
+        for (uint32_t i = 0; i < 4; i++) {
+                vertices[i].c[0] = cmdt->cmd_vertices[i].x;
+                vertices[i].c[1] = cmdt->cmd_vertices[i].y;
+        }
+
+        const uint64_t area2 = _area2_calculate(vertices, 4);
+
+        if (((area2 / height) * row_drop_count) < (clip->area_min * 2)) {
+                return 1;
+        }
+
+        out->cmd_srca = cmdt->cmd_srca + ((row_first * row_size) >> 3);
+        out->cmd_size = (cmdt->cmd_size & 0xFF00) | (row_last - row_first + 1);
+
+        out->cmd_vertices[0].x = _lerp(a->x, d->x, row_first, row_max);
+        out->cmd_vertices[0].y = _lerp(a->y, d->y, row_first, row_max);
+        out->cmd_vertices[1].x = _lerp(b->x, c->x, row_first, row_max);
+        out->cmd_vertices[1].y = _lerp(b->y, c->y, row_first, row_max);
+        out->cmd_vertices[2].x = _lerp(b->x, c->x, row_last, row_max);
+        out->cmd_vertices[2].y = _lerp(b->y, c->y, row_last, row_max);
+        out->cmd_vertices[3].x = _lerp(a->x, d->x, row_last, row_max);
+        out->cmd_vertices[3].y = _lerp(a->y, d->y, row_last, row_max);
+
+        return 1;
+}
+
+/* One pass of Sutherland-Hodgman. A vertex is inside when
+ * sign * c[axis] <= sign * bound */
+static uint32_t
+_edge_clip(const clip_vertex_t *in, uint32_t in_count, clip_vertex_t *out,
+    uint32_t axis, int32_t sign, int32_t bound)
+{
+        const uint32_t other = axis ^ 1;
+
+        uint32_t out_count;
+        out_count = 0;
+
+        if (in_count == 0) {
+                return 0;
+        }
+
+        const clip_vertex_t *p;
+        p = &in[in_count - 1];
+        bool p_inside;
+        p_inside = (sign * p->c[axis]) <= (sign * bound);
+
+        for (uint32_t i = 0; i < in_count; i++) {
+                const clip_vertex_t * const q = &in[i];
+                const bool q_inside = (sign * q->c[axis]) <= (sign * bound);
+
+                if (p_inside != q_inside) {
+                        clip_vertex_t * const v = &out[out_count];
+
+                        /* Both differences can take up to 17 bits, so
+                         * their product can't be held in 32 bits */
+                        const int64_t num =
+                            (int64_t)(q->c[other] - p->c[other]) * (bound - p->c[axis]);
+
+                        v->c[axis] = bound;
+                        v->c[other] = p->c[other] +
+                            _div_round(num, q->c[axis] - p->c[axis]);
+
+                        out_count++;
+                }
+
+                if (q_inside) {
+                        out[out_count] = *q;
+
+                        out_count++;
+                }
+
+                p = q;
+                p_inside = q_inside;
+        }
+
+        assert(out_count <= VERTEX_COUNT_MAX);
+
+        return out_count;
+}
+
+static uint32_t
+_bounds_test(const clip_t *clip, const vdp1_cmdt_t *cmdt)
+{
+        int16_t x_min;
+        x_min = cmdt->cmd_vertices[0].x;
+        int16_t x_max;
+        x_max = x_min;
+        int16_t y_min;
+        y_min = cmdt->cmd_vertices[0].y;
+        int16_t y_max;
+        y_max = y_min;
+
+        for (uint32_t i = 1; i < 4; i++) {
+                x_min = min(x_min, cmdt->cmd_vertices[i].x);
+                x_max = max(x_max, cmdt->cmd_vertices[i].x);
+                y_min = min(y_min, cmdt->cmd_vertices[i].y);
+                y_max = max(y_max, cmdt->cmd_vertices[i].y);
+        }
+
+        if ((x_max < clip->left) || (x_min > clip->right) ||
+            (y_max < clip->top) || (y_min > clip->bottom)) {
+                return BOUNDS_OUTSIDE;
+        }
+
+        if ((x_min >= clip->left) && (x_max <= clip->right) &&
+            (y_min >= clip->top) && (y_max <= clip->bottom)) {
+                return BOUNDS_INSIDE;
+        }
+
+        return BOUNDS_CROSS;
+}
+
+/* Twice the area, with the shoelace formula. Far off screen vertices overflow
+ * 32 bits */
+static uint64_t
+_area2_calculate(const clip_vertex_t *vertices, uint32_t count)
+{
+        int64_t area2;
+        area2 = 0;
+
+        const clip_vertex_t *p;
+        p = &vertices[count - 1];
+
+        for (uint32_t i = 0; i < count; i++) {
+                const clip_vertex_t * const q = &vertices[i];
+
+                area2 += ((int64_t)p->c[0] * q->c[1]) - ((int64_t)q->c[0] * p->c[1]);
+
+                p = q;
+        }
+
+        return (area2 < 0) ? -area2 : area2;
+}
+
+/* The open interval of t for which both a0 + (a1 - a0)t and b0 + (b1 - b0)t
+ * are less than c. Empty when hi <= lo */
+static void
+_below_interval_calculate(int32_t a0, int32_t a1, int32_t b0, int32_t b1,
+    int32_t c, clip_interval_t *interval)
+{
+        interval->lo = T_BEFORE;
+        interval->hi = T_AFTER;
+
+        _half_line_below_clip(a0, a1, c, interval);
+        _half_line_below_clip(b0, b1, c, interval);
+}
+
+static void
+_half_line_below_clip(int32_t p0, int32_t p1, int32_t c,
+    clip_interval_t *interval)
+{
+        if (p0 == p1) {
+                if (p0 >= c) {
+                        interval->hi = interval->lo;
+                }
+
+                return;
+        }
+
+        int32_t num;
+        num = c - p0;
+        int32_t den;
+        den = p1 - p0;
+
+        if (den < 0) {
+                num = -num;
+                den = -den;
+        }
+
+        /* Where p crosses c, kept within T_BEFORE and T_AFTER so that it
+         * can't overflow */
+        fix16_t t;
+
+        if (num < 0) {
+                t = T_BEFORE;
+        } else if (num > den) {
+                t = T_AFTER;
+        } else {
+                t = ((uint32_t)num << 16) / (uint32_t)den;
+        }
+
+        if (p1 > p0) {
+                interval->hi = min(interval->hi, t);
+        } else {
+                interval->lo = max(interval->lo, t);
+        }
+}
+
+static int32_t
+_div_round(int64_t num, int32_t den)
+{
+        if (den < 0) {
+                num = -num;
+                den = -den;
+        }
+
+        if (num < 0) {
+                return -((-num + (den / 2)) / den);
+        }
+
+        return (num + (den / 2)) / den;
+}
+
+static int16_t
+_lerp(int16_t a, int16_t b, int32_t num, int32_t den)
+{
+        return a + _div_round((b - a) * num, den);
+}
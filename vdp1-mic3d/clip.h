@@ -0,0 +1,47 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include <mic3d.h>
+
+/* A polygon clipped to the rectangle is fanned out into at most this many
+ * quads */
+#define CLIP_CMDT_COUNT_MAX (3)
+
+typedef struct clip {
+        /* Inclusive, in the same coordinates as the vertices. This should
+         * match the user clip */
+        int16_t left;
+        int16_t top;
+        int16_t right;
+        int16_t bottom;
+
+        /* Primitives with fewer pixels than this outside of the rectangle are
+         * left alone. Below some size, the VDP1 rejects the outside pixels
+         * faster than the extra command tables cost */
+        uint32_t area_min;
+} clip_t;
+
+void clip_init(clip_t *clip, int16_t left, int16_t top, int16_t right,
+    int16_t bottom, uint32_t area_min);
+
+/* Clips a flat shaded polygon. The vertices must form a convex quad. Gouraud
+ * shaded and half-transparent polygons should not be clipped, as the pieces
+ * share edges.
+ *
+ * Writes up to CLIP_CMDT_COUNT_MAX command tables to out and returns how many.
+ * Returns 0 if the polygon is entirely outside, and 1 with an unchanged copy
+ * if not enough of it is outside */
+uint32_t clip_polygon(const clip_t *clip, const vdp1_cmdt_t *cmdt, vdp1_cmdt_t *out);
+
+/* Clips a distorted sprite by dropping the rows of the texture that are drawn
+ * entirely outside, and moving vertices A and B (D and C) along the edges to
+ * the first (last) row kept. The texture keeps the same mapping. Columns can't
+ * be dropped, as the width of the texture is also its stride.
+ *
+ * bits is the texel size of the sprite's color mode: 4, 8, or 16. Flipped
+ * sprites are left alone. Returns the same as clip_polygon(), with at most one
+ * command table written */
+uint32_t clip_distorted_sprite(const clip_t *clip, const vdp1_cmdt_t *cmdt,
+    uint32_t bits, vdp1_cmdt_t *out);
+
+#endif /* CLIP_H */
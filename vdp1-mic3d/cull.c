@@ -0,0 +1,195 @@
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+
+static void _sphere_view_center_calculate(const cull_frustum_t *frustum,
+    const cull_sphere_t *sphere, const fix16_mat43_t *world, fix16_vec3_t *center);
+static fix16_t _dot(const fix16_vec3_t *a, const fix16_vec3_t *b);
+static void _cross(const fix16_vec3_t *a, const fix16_vec3_t *b, fix16_vec3_t *result);
+static void _normalize(fix16_vec3_t *v);
+static uint32_t _sqrt64(uint64_t x);
+
+void
+cull_sphere_calculate(const mesh_t *mesh, cull_sphere_t *sphere)
+{
+        fix16_vec3_t aabb_min = mesh->points[0];
+        fix16_vec3_t aabb_max = mesh->points[0];
+
+        for (uint32_t i = 1; i < mesh->points_count; i++) {
+                const fix16_vec3_t * const point = &mesh->points[i];
+
+                aabb_min.x = min(aabb_min.x, point->x);
+                aabb_min.y = min(aabb_min.y, point->y);
+                aabb_min.z = min(aabb_min.z, point->z);
+
+                aabb_max.x = max(aabb_max.x, point->x);
+                aabb_max.y = max(aabb_max.y, point->y);
+                aabb_max.z = max(aabb_max.z, point->z);
+        }
+
+        sphere->center.x = (aabb_min.x + aabb_max.x) >> 1;
+        sphere->center.y = (aabb_min.y + aabb_max.y) >> 1;
+        sphere->center.z = (aabb_min.z + aabb_max.z) >> 1;
+
+        /* Squared distances easily overflow Q16.16, so accumulate in 64-bit */
+        uint64_t radius_squared = 0;
+
+        for (uint32_t i = 0; i < mesh->points_count; i++) {
+                const fix16_vec3_t * const point = &mesh->points[i];
+
+                const int64_t dx = point->x - sphere->center.x;
+                const int64_t dy = point->y - sphere->center.y;
+                const int64_t dz = point->z - sphere->center.z;
+
+                radius_squared = max(radius_squared, (uint64_t)((dx * dx) + (dy * dy) + (dz * dz)));
+        }
+
+        /* Round up so that the sphere always contains every point */
+        sphere->radius = _sqrt64(radius_squared) + 1;
+}
+
+void
+cull_frustum_set(cull_frustum_t *frustum, const camera_t *camera,
+    fix16_t x_slope, fix16_t y_slope, fix16_t near, fix16_t far)
+{
+        frustum->position = camera->position;
+
+        frustum->forward.x = camera->target.x - camera->position.x;
+        frustum->forward.y = camera->target.y - camera->position.y;
+        frustum->forward.z = camera->target.z - camera->position.z;
+        _normalize(&frustum->forward);
+
+        _cross(&frustum->forward, &camera->up, &frustum->right);
+        _normalize(&frustum->right);
+
+        _cross(&frustum->right, &frustum->forward, &frustum->up);
+
+        frustum->near = near;
+        frustum->far = far;
+
+        frustum->x_slope = x_slope;
+        frustum->y_slope = y_slope;
+
+        frustum->x_scale = _sqrt64(((uint64_t)FIX16(1.0) << 16) +
+            ((int64_t)x_slope * x_slope));
+        frustum->y_scale = _sqrt64(((uint64_t)FIX16(1.0) << 16) +
+            ((int64_t)y_slope * y_slope));
+}
+
+bool
+cull_sphere_test(const cull_frustum_t *frustum, const cull_sphere_t *sphere,
+    const fix16_mat43_t *world)
+{
+        fix16_vec3_t center;
+        _sphere_view_center_calculate(frustum, sphere, world, &center);
+
+        const fix16_t radius = sphere->radius;
+
+        const fix16_t z = _dot(&center, &frustum->forward);
+
+        if (((z + radius) < frustum->near) || ((z - radius) > frustum->far)) {
+                return false;
+        }
+
+        const fix16_t x = _dot(&center, &frustum->right);
+        const fix16_t x_limit = fix16_mul(frustum->x_slope, z) +
+            fix16_mul(frustum->x_scale, radius);
+
+        if ((x > x_limit) || (-x > x_limit)) {
+                return false;
+        }
+
+        const fix16_t y = _dot(&center, &frustum->up);
+        const fix16_t y_limit = fix16_mul(frustum->y_slope, z) +
+            fix16_mul(frustum->y_scale, radius);
+
+        if ((y > y_limit) || (-y > y_limit)) {
+                return false;
+        }
+
+        return true;
+}
+
+fix16_t
+cull_sphere_depth_calculate(const cull_frustum_t *frustum,
+    const cull_sphere_t *sphere, const fix16_mat43_t *world)
+{
+        fix16_vec3_t center;
+        _sphere_view_center_calculate(frustum, sphere, world, &center);
+
+        return _dot(&center, &frustum->forward);
+}
+
+/* Calculates the center of the sphere in world space, relative to the camera */
+static void
+_sphere_view_center_calculate(const cull_frustum_t *frustum,
+    const cull_sphere_t *sphere, const fix16_mat43_t *world, fix16_vec3_t *center)
+{
+        fix16_mat33_vec3_mul(&world->rotation, &sphere->center, center);
+
+        center->x += world->translation.x - frustum->position.x;
+        center->y += world->translation.y - frustum->position.y;
+        center->z += world->translation.z - frustum->position.z;
+}
+
+static fix16_t
+_dot(const fix16_vec3_t *a, const fix16_vec3_t *b)
+{
+        const int64_t dot = ((int64_t)a->x * b->x) +
+                            ((int64_t)a->y * b->y) +
+                            ((int64_t)a->z * b->z);
+
+        return (fix16_t)(dot >> 16);
+}
+
+static void
+_cross(const fix16_vec3_t *a, const fix16_vec3_t *b, fix16_vec3_t *result)
+{
+        result->x = fix16_mul(a->y, b->z) - fix16_mul(a->z, b->y);
+        result->y = fix16_mul(a->z, b->x) - fix16_mul(a->x, b->z);
+        result->z = fix16_mul(a->x, b->y) - fix16_mul(a->y, b->x);
+}
+
+static void
+_normalize(fix16_vec3_t *v)
+{
+        const uint64_t length_squared = ((int64_t)v->x * v->x) +
+                                        ((int64_t)v->y * v->y) +
+                                        ((int64_t)v->z * v->z);
+
+        const int64_t length = _sqrt64(length_squared);
+
+        if (length == 0) {
+                return;
+        }
+
+        v->x = ((int64_t)v->x << 16) / length;
+        v->y = ((int64_t)v->y << 16) / length;
+        v->z = ((int64_t)v->z << 16) / length;
+}
+
+static uint32_t
+_sqrt64(uint64_t x)
+{
+        uint64_t result = 0;
+        uint64_t bit = (uint64_t)1 << 62;
+
+        while (bit > x) {
+                bit >>= 2;
+        }
+
+        while (bit != 0) {
+                if (x >= (result + bit)) {
+                        x -= result + bit;
+                        result = (result >> 1) + bit;
+                } else {
+                        result >>= 1;
+                }
+
+                bit >>= 2;
+        }
+
+        return result;
+}
@@ -0,0 +1,48 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <mic3d.h>
+
+typedef struct cull_sphere {
+        /* Center in model space */
+        fix16_vec3_t center;
+        fix16_t radius;
+} cull_sphere_t;
+
+typedef struct cull_frustum {
+        fix16_vec3_t position;
+        /* Unit view space basis, built from the camera */
+        fix16_vec3_t right;
+        fix16_vec3_t up;
+        fix16_vec3_t forward;
+
+        fix16_t near;
+        fix16_t far;
+
+        /* Half the width (height) of the view plane at a depth of 1.0 */
+        fix16_t x_slope;
+        fix16_t y_slope;
+        /* Distance scale of the side planes. sqrt(1 + slope^2) */
+        fix16_t x_scale;
+        fix16_t y_scale;
+} cull_frustum_t;
+
+/* Calculates the bounding sphere of a mesh. Call once at load time */
+void cull_sphere_calculate(const mesh_t *mesh, cull_sphere_t *sphere);
+
+/* The slopes must match the projection mic3d uses, or meshes near the edges of
+ * the screen will be culled too early (or too late) */
+void cull_frustum_set(cull_frustum_t *frustum, const camera_t *camera,
+    fix16_t x_slope, fix16_t y_slope, fix16_t near, fix16_t far);
+
+/* Returns true if the sphere, transformed by world, is at least partially
+ * inside the frustum. The world matrix is expected to be a rigid transform */
+bool cull_sphere_test(const cull_frustum_t *frustum, const cull_sphere_t *sphere,
+    const fix16_mat43_t *world);
+
+/* Returns the view space depth of the center of the sphere, transformed by
+ * world */
+fix16_t cull_sphere_depth_calculate(const cull_frustum_t *frustum,
+    const cull_sphere_t *sphere, const fix16_mat43_t *world);
+
+#endif /* CULL_H */
@@ -0,0 +1,283 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "lod.h"
+#include "vdp1_cost.h"
+
+/* About pi, in 1/64ths */
+#define AREA_PI (201)
+
+static void _entry_add(draw_list_t *list, const mesh_t *mesh,
+    const fix16_mat43_t *xform, uint32_t flags, fix16_t radius, fix16_t depth);
+static uint32_t _entry_radius_calculate(const draw_entry_t *entry,
+    const cull_frustum_t *frustum, uint16_t width, uint16_t height);
+static uint32_t _entry_cost_estimate(const draw_entry_t *entry,
+    const vdp1_cost_model_t *model, uint32_t area, uint32_t rows);
+
+void
+draw_list_clear(draw_list_t *list)
+{
+        list->count = 0;
+        list->cost = 0;
+        list->dropped_count = 0;
+}
+
+uint32_t
+draw_list_mesh_add(draw_list_t *list, const cull_frustum_t *frustum,
+    const mesh_t *mesh, const cull_sphere_t *sphere, const fix16_mat43_t *xform,
+    uint32_t flags)
+{
+        if (!(cull_sphere_test(frustum, sphere, xform))) {
+                return 0;
+        }
+
+        const fix16_t depth = cull_sphere_depth_calculate(frustum, sphere, xform);
+
+        _entry_add(list, mesh, xform, flags, sphere->radius, depth);
+
+        return 1;
+}
+
+uint32_t
+draw_list_lod_add(draw_list_t *list, const cull_frustum_t *frustum,
+    lod_group_t *group, const fix16_mat43_t *xform, uint32_t flags)
+{
+        if (!(cull_sphere_test(frustum, group->sphere, xform))) {
+                return 0;
+        }
+
+        const fix16_t depth = cull_sphere_depth_calculate(frustum, group->sphere, xform);
+        const uint32_t level = lod_group_level_select(group, depth);
+
+        _entry_add(list, group->levels[level].mesh, xform, flags,
+            group->sphere->radius, depth);
+
+        return 1;
+}
+
+uint32_t
+draw_list_instances_add(draw_list_t *list, const cull_frustum_t *frustum,
+    const mesh_t *mesh, const cull_sphere_t *sphere, const fix16_mat43_t *xforms,
+    uint32_t count, uint32_t flags)
+{
+        uint32_t added_count = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                added_count += draw_list_mesh_add(list, frustum, mesh, sphere,
+                    &xforms[i], flags);
+        }
+
+        return added_count;
+}
+
+uint32_t
+draw_list_budget(draw_list_t *list, const cull_frustum_t *frustum,
+    const vdp1_cost_model_t *model, uint16_t width, uint16_t height,
+    uint32_t budget)
+{
+        vdp1_budget_entry_t budget_entries[DRAW_LIST_ENTRY_COUNT_MAX];
+        bool kept[DRAW_LIST_ENTRY_COUNT_MAX];
+
+        const uint32_t screen_area = width * height;
+
+        for (uint32_t i = 0; i < list->count; i++) {
+                const draw_entry_t * const entry = &list->entries[i];
+
+                /* The sphere's disc is about what a closed mesh covers */
+                const uint32_t radius =
+                    _entry_radius_calculate(entry, frustum, width, height);
+                const uint32_t area =
+                    min((radius * radius * AREA_PI) >> 6, screen_area);
+                const uint32_t rows = min(2 * radius, height);
+
+                budget_entries[i].cost =
+                    _entry_cost_estimate(entry, model, area, rows);
+                budget_entries[i].priority = min(area, 0xFFFFU);
+                budget_entries[i].index = i;
+
+                kept[i] = false;
+        }
+
+        const uint32_t kept_count = vdp1_budget_fit(budget_entries, list->count, budget);
+
+        list->cost = 0;
+
+        for (uint32_t i = 0; i < kept_count; i++) {
+                kept[budget_entries[i].index] = true;
+
+                list->cost += budget_entries[i].cost;
+        }
+
+        /* Keep the entries in the order they were added */
+        uint32_t count;
+        count = 0;
+
+        for (uint32_t i = 0; i < list->count; i++) {
+                if (kept[i]) {
+                        list->entries[count] = list->entries[i];
+
+                        count++;
+                }
+        }
+
+        list->dropped_count = list->count - count;
+        list->count = count;
+
+        return list->dropped_count;
+}
+
+uint32_t
+draw_list_split(const draw_list_t *list, uint32_t points_count_max,
+    uint32_t polygons_count_max)
+{
+        uint32_t total_count;
+        total_count = 0;
+
+        for (uint32_t i = 0; i < list->count; i++) {
+                total_count += list->entries[i].mesh->polygons_count;
+        }
+
+        /* Move the split back an entry at a time, for as long as the middle
+         * of the entry is in the second half */
+        uint32_t split;
+        split = list->count;
+
+        uint32_t polygons_count;
+        polygons_count = 0;
+
+        for (; split > 0; split--) {
+                const mesh_t * const mesh = list->entries[split - 1].mesh;
+
+                if (mesh->points_count > points_count_max) {
+                        break;
+                }
+
+                if ((polygons_count + mesh->polygons_count) > polygons_count_max) {
+                        break;
+                }
+
+                if (((2 * polygons_count) + mesh->polygons_count) > total_count) {
+                        break;
+                }
+
+                polygons_count += mesh->polygons_count;
+        }
+
+        return split;
+}
+
+void
+draw_list_render(const draw_list_t *list)
+{
+        draw_list_range_render(list, 0, list->count);
+}
+
+void
+draw_list_range_render(const draw_list_t *list, uint32_t first, uint32_t count)
+{
+        assert((first + count) <= list->count);
+
+        for (uint32_t i = first; i < (first + count); i++) {
+                const draw_entry_t * const entry = &list->entries[i];
+
+                if ((entry->flags & DRAW_FLAGS_LIGHTING) != 0) {
+                        render_enable(RENDER_FLAGS_LIGHTING);
+                } else {
+                        render_disable(RENDER_FLAGS_LIGHTING);
+                }
+
+                render_mesh_xform(entry->mesh, &entry->xform);
+        }
+
+        render_disable(RENDER_FLAGS_LIGHTING);
+}
+
+static void
+_entry_add(draw_list_t *list, const mesh_t *mesh, const fix16_mat43_t *xform,
+    uint32_t flags, fix16_t radius, fix16_t depth)
+{
+        assert(list->count < DRAW_LIST_ENTRY_COUNT_MAX);
+
+        draw_entry_t * const entry = &list->entries[list->count];
+
+        entry->mesh = mesh;
+        entry->xform = *xform;
+        entry->flags = flags;
+        entry->radius = radius;
+        entry->depth = depth;
+
+        list->count++;
+}
+
+/* Returns the radius, in pixels, of the sphere projected onto the screen */
+static uint32_t
+_entry_radius_calculate(const draw_entry_t *entry, const cull_frustum_t *frustum,
+    uint16_t width, uint16_t height)
+{
+        /* Large enough to cover the screen */
+        const uint32_t radius_max = max(width, height);
+
+        if (entry->depth <= frustum->near) {
+                return radius_max;
+        }
+
+        /* Half the width of the view plane at the sphere's depth, in 1/256ths */
+        const uint32_t view_hwidth = fix16_mul(entry->depth, frustum->x_slope) >> 8;
+
+        if (view_hwidth == 0) {
+                return radius_max;
+        }
+
+        /* In 1/256ths of half the screen width */
+        const uint32_t ratio = entry->radius / view_hwidth;
+
+        /* This also keeps the math below from overflowing */
+        if (ratio >= 512) {
+                return radius_max;
+        }
+
+        return min((ratio * (width / 2)) >> 8, radius_max);
+}
+
+/* Spreads the area evenly over the polygons. Back facing polygons are counted,
+ * so the estimate is on the high side */
+static uint32_t
+_entry_cost_estimate(const draw_entry_t *entry, const vdp1_cost_model_t *model,
+    uint32_t area, uint32_t rows)
+{
+        const mesh_t * const mesh = entry->mesh;
+
+        if (mesh->polygons_count == 0) {
+                return 0;
+        }
+
+        uint32_t pixel_cost;
+        pixel_cost = 0;
+
+        for (uint32_t i = 0; i < mesh->polygons_count; i++) {
+                const attribute_t * const attribute = &mesh->attributes[i];
+
+                pixel_cost += vdp1_cost_pixel_get(model,
+                    attribute->control.command, attribute->draw_mode.raw);
+        }
+
+        pixel_cost /= mesh->polygons_count;
+
+        /* Lit meshes are gouraud shaded */
+        if ((entry->flags & DRAW_FLAGS_LIGHTING) != 0) {
+                pixel_cost += model->gouraud;
+        }
+
+        /* At least a line per polygon, and the rows the mesh covers */
+        const uint32_t lines = mesh->polygons_count + rows;
+
+        const uint32_t cost = (mesh->polygons_count * model->cmdt) +
+            (lines * model->line) + (area * pixel_cost);
+
+        return cost >> VDP1_COST_SHIFT;
+}
@@ -0,0 +1,71 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "lod.h"
+#include "vdp1_cost.h"
+
+#define DRAW_LIST_ENTRY_COUNT_MAX (32)
+
+#define DRAW_FLAGS_NONE     (0)
+#define DRAW_FLAGS_LIGHTING (1 << 0)
+
+typedef struct draw_entry {
+        const mesh_t *mesh;
+        fix16_mat43_t xform;
+        uint32_t flags;
+        /* Bounding sphere radius, and the view space depth of its center */
+        fix16_t radius;
+        fix16_t depth;
+} draw_entry_t;
+
+/* A list of visible meshes, built without calling into mic3d. This allows the
+ * list to be built on one CPU while the other renders */
+typedef struct draw_list {
+        draw_entry_t entries[DRAW_LIST_ENTRY_COUNT_MAX];
+        uint32_t count;
+        angle_t theta;
+        /* Set by draw_list_budget(). Estimated VDP1 ticks of the entries
+         * kept, and how many were dropped */
+        uint32_t cost;
+        uint32_t dropped_count;
+} draw_list_t;
+
+void draw_list_clear(draw_list_t *list);
+
+/* Each add culls against the frustum first, and returns the number of entries
+ * added */
+uint32_t draw_list_mesh_add(draw_list_t *list, const cull_frustum_t *frustum,
+    const mesh_t *mesh, const cull_sphere_t *sphere, const fix16_mat43_t *xform,
+    uint32_t flags);
+uint32_t draw_list_lod_add(draw_list_t *list, const cull_frustum_t *frustum,
+    lod_group_t *group, const fix16_mat43_t *xform, uint32_t flags);
+uint32_t draw_list_instances_add(draw_list_t *list, const cull_frustum_t *frustum,
+    const mesh_t *mesh, const cull_sphere_t *sphere, const fix16_mat43_t *xforms,
+    uint32_t count, uint32_t flags);
+
+/* Estimates what each entry costs the VDP1 from its polygon count and how
+ * much of a width x height screen its sphere covers. If the list is over
+ * budget ticks, drops the entries that cover the least of the screen until it
+ * fits. Returns the number of entries dropped */
+uint32_t draw_list_budget(draw_list_t *list, const cull_frustum_t *frustum,
+    const vdp1_cost_model_t *model, uint16_t width, uint16_t height,
+    uint32_t budget);
+
+/* Returns where to split the list in two with about as many polygons on each
+ * side. Every entry from the split on has at most points_count_max points, and
+ * together they have at most polygons_count_max polygons */
+uint32_t draw_list_split(const draw_list_t *list, uint32_t points_count_max,
+    uint32_t polygons_count_max);
+
+/* Calls render_mesh_xform() on each entry. Call between render_start() and
+ * render_end() */
+void draw_list_render(const draw_list_t *list);
+
+/* Same as above, for count entries, starting from first */
+void draw_list_range_render(const draw_list_t *list, uint32_t first,
+    uint32_t count);
+
+#endif /* DRAW_LIST_H */
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raster.h"
+
+typedef struct {
+        int32_t clip_x;
+        int32_t clip_y;
+        int32_t local_x;
+        int32_t local_y;
+} raster_state_t;
+
+typedef struct {
+        /* Q16.16 screen position */
+        int32_t x;
+        int32_t y;
+        /* Q16.16 texture coordinates */
+        int32_t u;
+        int32_t v;
+        /* Q16.16 gouraud color, per channel */
+        int32_t g[3];
+} raster_point_t;
+
+static void _quad_draw(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt);
+static void _line_draw(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt,
+    const raster_point_t *l, const raster_point_t *r);
+static void _pixel_plot(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt,
+    int32_t x, int32_t y, const raster_point_t *p);
+static void _point_lerp(const raster_point_t *a, const raster_point_t *b, int32_t t, raster_point_t *result);
+static uint16_t _vram_read16(const raster_t *raster, uint32_t offset);
+static int32_t _chebyshev(const raster_point_t *a, const raster_point_t *b);
+static int32_t _lerp(int32_t a, int32_t b, int32_t t);
+
+void
+raster_clear(raster_t *raster, uint16_t color)
+{
+        for (uint32_t i = 0; i < (RASTER_WIDTH * RASTER_HEIGHT); i++) {
+                raster->fb[i] = color;
+        }
+
+        raster->unsupported_count = 0;
+}
+
+void
+raster_vram_write(raster_t *raster, uint32_t offset, const uint16_t *data, uint32_t count)
+{
+        for (uint32_t i = 0; i < count; i++) {
+                raster->vram[offset + (i * 2) + 0] = data[i] >> 8;
+                raster->vram[offset + (i * 2) + 1] = data[i] & 0xFF;
+        }
+}
+
+void
+raster_cmdts_draw(raster_t *raster, const vdp1_cmdt_t *cmdts, uint32_t count)
+{
+        raster_state_t state = {
+                .clip_x  = RASTER_WIDTH - 1,
+                .clip_y  = RASTER_HEIGHT - 1,
+                .local_x = 0,
+                .local_y = 0
+        };
+
+        for (uint32_t i = 0; i < count; i++) {
+                const vdp1_cmdt_t * const cmdt = &cmdts[i];
+
+                if ((cmdt->cmd_ctrl & VDP1_CMDT_END) != 0) {
+                        break;
+                }
+
+                switch (cmdt->cmd_ctrl & 0x000F) {
+                case VDP1_CMDT_SYSTEM_CLIP:
+                        state.clip_x = cmdt->cmd_xc;
+                        state.clip_y = cmdt->cmd_yc;
+                        break;
+                case VDP1_CMDT_LOCAL_COORD:
+                        state.local_x = cmdt->cmd_xa;
+                        state.local_y = cmdt->cmd_ya;
+                        break;
+                case VDP1_CMDT_DISTORTED_SPRITE:
+                case VDP1_CMDT_POLYGON:
+                        _quad_draw(raster, &state, cmdt);
+                        break;
+                default:
+                        raster->unsupported_count++;
+                        break;
+                }
+        }
+}
+
+bool
+raster_ppm_write(const raster_t *raster, const char *filename)
+{
+        FILE * const fp = fopen(filename, "wb");
+
+        if (fp == NULL) {
+                return false;
+        }
+
+        fprintf(fp, "P6\n%i %i\n255\n", RASTER_WIDTH, RASTER_HEIGHT);
+
+        for (uint32_t i = 0; i < (RASTER_WIDTH * RASTER_HEIGHT); i++) {
+                const uint16_t pixel = raster->fb[i];
+
+                const uint8_t rgb[3] = {
+                        ((pixel >>  0) & 0x1F) << 3,
+                        ((pixel >>  5) & 0x1F) << 3,
+                        ((pixel >> 10) & 0x1F) << 3
+                };
+
+                fwrite(rgb, sizeof(rgb), 1, fp);
+        }
+
+        return (fclose(fp) == 0);
+}
+
+/* Draws the quad the way VDP1 does: the A-D and B-C edges are walked in step,
+ * and a line is drawn between them for each step. Lines are stepped at twice
+ * the length of the longest edge so that no holes are left between them */
+static void
+_quad_draw(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt)
+{
+        const vdp1_cmdt_draw_mode_t draw_mode = { .raw = cmdt->cmd_pmod };
+
+        const int32_t width = ((cmdt->cmd_size >> 8) & 0x3F) * 8;
+        const int32_t height = cmdt->cmd_size & 0xFF;
+
+        const int16_t xs[4] = { cmdt->cmd_xa, cmdt->cmd_xb, cmdt->cmd_xc, cmdt->cmd_xd };
+        const int16_t ys[4] = { cmdt->cmd_ya, cmdt->cmd_yb, cmdt->cmd_yc, cmdt->cmd_yd };
+        const int32_t us[4] = { 0, width - 1, width - 1, 0 };
+        const int32_t vs[4] = { 0, 0, height - 1, height - 1 };
+
+        raster_point_t points[4];
+
+        for (uint32_t i = 0; i < 4; i++) {
+                raster_point_t * const point = &points[i];
+
+                point->x = (xs[i] + state->local_x) << 16;
+                point->y = (ys[i] + state->local_y) << 16;
+                point->u = max(us[i], 0) << 16;
+                point->v = max(vs[i], 0) << 16;
+
+                if (draw_mode.cc_mode == VDP1_CMDT_CC_GOURAUD) {
+                        const uint16_t color =
+                            _vram_read16(raster, (cmdt->cmd_grda * 8) + (i * 2));
+
+                        point->g[0] = ((color >>  0) & 0x1F) << 16;
+                        point->g[1] = ((color >>  5) & 0x1F) << 16;
+                        point->g[2] = ((color >> 10) & 0x1F) << 16;
+                } else {
+                        point->g[0] = 16 << 16;
+                        point->g[1] = 16 << 16;
+                        point->g[2] = 16 << 16;
+                }
+        }
+
+        const int32_t length = max(_chebyshev(&points[0], &points[3]),
+            _chebyshev(&points[1], &points[2]));
+        const int32_t steps = (length * 2) + 1;
+
+        for (int32_t i = 0; i <= steps; i++) {
+                const int32_t t = (int32_t)(((int64_t)i << 16) / steps);
+
+                raster_point_t l;
+                raster_point_t r;
+
+                _point_lerp(&points[0], &points[3], t, &l);
+                _point_lerp(&points[1], &points[2], t, &r);
+
+                _line_draw(raster, state, cmdt, &l, &r);
+        }
+}
+
+static void
+_line_draw(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt,
+    const raster_point_t *l, const raster_point_t *r)
+{
+        const int32_t steps = (_chebyshev(l, r) * 2) + 1;
+
+        for (int32_t i = 0; i <= steps; i++) {
+                const int32_t t = (int32_t)(((int64_t)i << 16) / steps);
+
+                raster_point_t p;
+
+                _point_lerp(l, r, t, &p);
+
+                _pixel_plot(raster, state, cmdt, (p.x + 0x8000) >> 16, (p.y + 0x8000) >> 16, &p);
+        }
+}
+
+static void
+_pixel_plot(raster_t *raster, const raster_state_t *state, const vdp1_cmdt_t *cmdt,
+    int32_t x, int32_t y, const raster_point_t *p)
+{
+        if ((x < 0) || (y < 0) || (x > state->clip_x) || (y > state->clip_y) ||
+            (x >= RASTER_WIDTH) || (y >= RASTER_HEIGHT)) {
+                return;
+        }
+
+        const vdp1_cmdt_draw_mode_t draw_mode = { .raw = cmdt->cmd_pmod };
+
+        uint16_t color;
+
+        if ((cmdt->cmd_ctrl & 0x000F) == VDP1_CMDT_POLYGON) {
+                color = cmdt->cmd_colr;
+        } else {
+                const int32_t width = ((cmdt->cmd_size >> 8) & 0x3F) * 8;
+                const uint32_t u = p->u >> 16;
+                const uint32_t v = p->v >> 16;
+                const uint32_t texel = (v * width) + u;
+                const uint32_t base = cmdt->cmd_srca * 8;
+
+                switch (draw_mode.color_mode) {
+                case VDP1_CMDT_CM_CB_256: {
+                        const uint8_t index = raster->vram[(base + texel) & (RASTER_VRAM_SIZE - 1)];
+
+                        if ((index == 0) && !draw_mode.trans_pixel_disable) {
+                                return;
+                        }
+
+                        color = raster->cram[(cmdt->cmd_colr + index) & ((RASTER_CRAM_SIZE / 2) - 1)];
+                        break;
+                }
+                case VDP1_CMDT_CM_RGB_32768:
+                        color = _vram_read16(raster, base + (texel * 2));
+
+                        if ((color == 0x0000) && !draw_mode.trans_pixel_disable) {
+                                return;
+                        }
+                        break;
+                default:
+                        /* Other color modes aren't used by the example */
+                        color = 0x801F;
+                        break;
+                }
+        }
+
+        if (draw_mode.cc_mode == VDP1_CMDT_CC_GOURAUD) {
+                uint16_t shaded = color & 0x8000;
+
+                for (uint32_t c = 0; c < 3; c++) {
+                        const int32_t channel = ((color >> (c * 5)) & 0x1F) + (p->g[c] >> 16) - 16;
+
+                        shaded |= min(max(channel, 0), 31) << (c * 5);
+                }
+
+                color = shaded;
+        }
+
+        raster->fb[(y * RASTER_WIDTH) + x] = color;
+}
+
+static void
+_point_lerp(const raster_point_t *a, const raster_point_t *b, int32_t t, raster_point_t *result)
+{
+        result->x = _lerp(a->x, b->x, t);
+        result->y = _lerp(a->y, b->y, t);
+        result->u = _lerp(a->u, b->u, t);
+        result->v = _lerp(a->v, b->v, t);
+        result->g[0] = _lerp(a->g[0], b->g[0], t);
+        result->g[1] = _lerp(a->g[1], b->g[1], t);
+        result->g[2] = _lerp(a->g[2], b->g[2], t);
+}
+
+static uint16_t
+_vram_read16(const raster_t *raster, uint32_t offset)
+{
+        offset &= RASTER_VRAM_SIZE - 2;
+
+        return (raster->vram[offset] << 8) | raster->vram[offset + 1];
+}
+
+static int32_t
+_chebyshev(const raster_point_t *a, const raster_point_t *b)
+{
+        const int32_t dx = abs((b->x - a->x) >> 16);
+        const int32_t dy = abs((b->y - a->y) >> 16);
+
+        return max(dx, dy);
+}
+
+static int32_t
+_lerp(int32_t a, int32_t b, int32_t t)
+{
+        return a + (int32_t)(((int64_t)(b - a) * t) >> 16);
+}
@@ -0,0 +1,38 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <mic3d.h>
+
+#define RASTER_WIDTH  (352)
+#define RASTER_HEIGHT (224)
+
+#define RASTER_VRAM_SIZE (0x80000)
+#define RASTER_CRAM_SIZE (0x1000)
+
+typedef struct raster {
+        /* VDP1 VRAM, big endian like on the Saturn */
+        uint8_t vram[RASTER_VRAM_SIZE];
+        /* VDP2 CRAM in mode 0 (RGB1555). The color bank sprite modes are
+         * resolved through it while drawing, where VDP2 would do it */
+        uint16_t cram[RASTER_CRAM_SIZE / 2];
+
+        uint16_t fb[RASTER_WIDTH * RASTER_HEIGHT];
+
+        /* Commands that were skipped because they aren't supported */
+        uint32_t unsupported_count;
+} raster_t;
+
+void raster_clear(raster_t *raster, uint16_t color);
+
+/* Copies host data into VRAM, swapping each 16-bit word to big endian */
+void raster_vram_write(raster_t *raster, uint32_t offset, const uint16_t *data, uint32_t count);
+
+/* Draws a command list until the end command, like VDP1 does on a frame
+ * change. Supports polygons and distorted sprites, along with the system
+ * clipping and local coordinate commands */
+void raster_cmdts_draw(raster_t *raster, const vdp1_cmdt_t *cmdts, uint32_t count);
+
+/* Writes the framebuffer as a binary PPM file. Returns false on failure */
+bool raster_ppm_write(const raster_t *raster, const char *filename);
+
+#endif /* RASTER_H */
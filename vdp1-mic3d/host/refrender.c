@@ -0,0 +1,1139 @@
+/*
+ * Host reference renderer for vdp1-mic3d
+ *
+ * Builds each frame with the same scene, culling, LOD, draw list, budget, and
+ * clipping code as vdp1-mic3d.c, built for the host against shim/. Where
+ * mic3d would take over, the meshes go through a plain C transform, clip,
+ * and sort pipeline instead, which writes VDP1 command tables into a buffer.
+ * These are then drawn with the software rasterizer in raster.c. Frames can
+ * be written out as PPM files, and hashes of the command lists and
+ * framebuffers can be checked against a golden file to see if a change
+ * altered the picture.
+ *
+ * The pipeline is a reference, not a copy of mic3d. Its fixed point math,
+ * clipping, and sorting rules are written to be easy to follow.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mic3d.h>
+
+#include "clip.h"
+#include "cull.h"
+#include "draw_list.h"
+#include "mesh_pack.h"
+#include "scene.h"
+#include "vdp1_cost.h"
+
+#include "raster.h"
+
+#define SCREEN_WIDTH  (RASTER_WIDTH)
+#define SCREEN_HEIGHT (RASTER_HEIGHT)
+
+/* Projection distance in pixels. A slope of 1.0 spans half the screen width,
+ * matching FRUSTUM_X_SLOPE in vdp1-mic3d.c */
+#define SCREEN_FOCAL (SCREEN_WIDTH / 2)
+
+#define NEAR_DEPTH (FIX16(1.0))
+/* Polygons with a vertex past this many pixels from the center are rejected,
+ * so that the coordinates always fit in VDP1's 13-bit range */
+#define GUARD_BAND (2048)
+
+#define POINT_COUNT_MAX   (1024)
+#define POLYGON_COUNT_MAX (2048)
+/* Two extra for the system clipping and local coordinate commands, and one
+ * for the end command */
+#define CMDT_COUNT_MAX    (POLYGON_COUNT_MAX + 3)
+
+#define VRAM_TEXTURE_BASE (0x20000)
+#define VRAM_GOURAUD_BASE (0x70000)
+
+/* Grey ramp uploaded by vdp1-mic3d.c, followed by a table for each lit
+ * polygon */
+#define GOURAUD_RAMP_COUNT (512)
+#define GOURAUD_LIGHT_BASE (GOURAUD_RAMP_COUNT)
+
+/* The rest match vdp1-mic3d.c */
+#define CLIP_AREA_MIN     (2048)
+#define VDP1_BUDGET_TICKS (50000)
+
+#define FRUSTUM_X_SLOPE (FIX16(1.0))
+#define FRUSTUM_Y_SLOPE (FIX16(0.7))
+#define FRUSTUM_NEAR    (FIX16(1.0))
+#define FRUSTUM_FAR     (FIX16(1024.0))
+
+#define FRAME_COUNT_DEFAULT (8)
+#define FRAME_STEP_DEFAULT  (30)
+
+#define ASSET_PATH_DEFAULT "../assets"
+
+typedef enum stage {
+        STAGE_SCENE,
+        STAGE_TRANSFORM,
+        STAGE_CLIP,
+        STAGE_SORT,
+        STAGE_CMDT,
+        STAGE_RASTER,
+        STAGE_COUNT
+} stage_t;
+
+typedef struct view {
+        fix16_vec3_t position;
+        fix16_vec3_t right;
+        fix16_vec3_t up;
+        fix16_vec3_t forward;
+        /* Light direction in world space, pointing towards the light */
+        fix16_vec3_t light;
+} view_t;
+
+typedef struct object {
+        const mesh_t *mesh;
+        fix16_mat43_t world;
+        bool lighting;
+} object_t;
+
+typedef struct screen_point {
+        int32_t x;
+        int32_t y;
+        fix16_t depth;
+        /* Gouraud value (0..31) from lighting */
+        uint8_t shade;
+} screen_point_t;
+
+typedef struct visible_polygon {
+        vdp1_cmdt_t cmdt;
+        uint8_t shades[4];
+        bool lighting;
+        fix16_t depth;
+        /* Submission order. Breaks ties so that sorting is deterministic */
+        uint32_t order;
+} visible_polygon_t;
+
+typedef struct frame {
+        visible_polygon_t polygons[POLYGON_COUNT_MAX];
+        uint32_t polygons_count;
+        uint32_t polygons_submitted;
+
+        visible_polygon_t *sorted[POLYGON_COUNT_MAX];
+
+        vdp1_cmdt_t cmdts[CMDT_COUNT_MAX];
+        uint32_t cmdts_count;
+
+        uint64_t stage_ns[STAGE_COUNT];
+} frame_t;
+
+typedef struct texture {
+        uint16_t size;
+        uint16_t vram_index;
+} texture_t;
+
+extern const mesh_t mesh_cube;
+extern const mesh_t mesh_torus;
+extern mesh_t mesh_torus_lod1;
+extern mesh_t mesh_torus_lod2;
+
+extern void mesh_torus_lod_init(void);
+
+extern const picture_t picture_mika;
+extern const picture_t picture_tails;
+extern const picture_t picture_baku;
+
+extern const palette_t palette_baku;
+
+static raster_t _raster;
+static frame_t _frame;
+static view_t _view;
+static texture_t _textures[3];
+
+static mesh_t _mesh_m;
+static mesh_t _mesh_i;
+static mesh_t _mesh_c;
+
+static cull_frustum_t _frustum;
+static clip_t _screen_clip;
+static scene_config_t _scene_config;
+static scene_t _scene;
+static draw_list_t _draw_list;
+
+/* Set by render_enable() and render_disable() */
+static bool _lighting;
+
+static void _usage(const char *program);
+
+static void _view_init(view_t *view);
+static void _vram_init(raster_t *raster, const char *asset_path);
+static void _scene_init(const char *asset_path);
+static void _mesh_load(const char *asset_path, const char *filename, mesh_t *mesh);
+static void *_file_read(const char *asset_path, const char *filename, size_t *size);
+static void _mesh_pack_swap(uint8_t *pack, size_t size);
+static void _swap16(uint8_t *p, uint32_t count);
+static void _swap32(uint8_t *p, uint32_t count);
+
+static void _frame_render(frame_t *frame, raster_t *raster, scene_t *scene);
+static void _frame_start(frame_t *frame);
+static void _frame_end(frame_t *frame, raster_t *raster);
+static void _polygons_insert(const draw_list_t *list);
+static void _object_submit(frame_t *frame, const object_t *object);
+static void _transform(const object_t *object, screen_point_t *points);
+static void _clip(frame_t *frame, const object_t *object, const screen_point_t *points);
+static void _polygon_cmdt_build(const attribute_t *attribute, const screen_point_t * const *p, vdp1_cmdt_t *cmdt);
+static void _sort(frame_t *frame);
+static void _cmdts_build(frame_t *frame, raster_t *raster);
+
+static uint32_t _cmdts_hash(const frame_t *frame);
+static uint32_t _fb_hash(const raster_t *raster);
+static uint32_t _fnv1a16(uint32_t hash, uint16_t value);
+
+static void _timings_print(uint32_t iterations);
+static int _golden_check(const char *filename, uint32_t frame_index, uint32_t cmdts_hash, uint32_t fb_hash);
+
+static fix16_t _dot(const fix16_vec3_t *a, const fix16_vec3_t *b);
+static void _mat33_vec3_mul(const fix16_mat33_t *m, const fix16_vec3_t *v, fix16_vec3_t *result);
+static uint64_t _ns_get(void);
+
+int
+main(int argc, char *argv[])
+{
+        uint32_t frame_count = FRAME_COUNT_DEFAULT;
+        uint32_t frame_step = FRAME_STEP_DEFAULT;
+        uint32_t timing_iterations = 0;
+        const char *asset_path = ASSET_PATH_DEFAULT;
+        const char *output_path = NULL;
+        const char *golden_filename = NULL;
+        bool golden_write = false;
+
+        int opt;
+
+        while ((opt = getopt(argc, argv, "f:s:a:o:g:wt:h")) != -1) {
+                switch (opt) {
+                case 'f':
+                        frame_count = strtoul(optarg, NULL, 0);
+                        break;
+                case 's':
+                        frame_step = strtoul(optarg, NULL, 0);
+                        break;
+                case 'a':
+                        asset_path = optarg;
+                        break;
+                case 'o':
+                        output_path = optarg;
+                        break;
+                case 'g':
+                        golden_filename = optarg;
+                        break;
+                case 'w':
+                        golden_write = true;
+                        break;
+                case 't':
+                        timing_iterations = strtoul(optarg, NULL, 0);
+                        break;
+                default:
+                        _usage(argv[0]);
+                        return 2;
+                }
+        }
+
+        if ((golden_write && (golden_filename == NULL)) || (frame_step == 0)) {
+                _usage(argv[0]);
+                return 2;
+        }
+
+        _view_init(&_view);
+        _vram_init(&_raster, asset_path);
+        _scene_init(asset_path);
+
+        if (timing_iterations > 0) {
+                _timings_print(timing_iterations);
+
+                return 0;
+        }
+
+        FILE *golden_fp = NULL;
+
+        if (golden_write) {
+                golden_fp = fopen(golden_filename, "w");
+
+                if (golden_fp == NULL) {
+                        fprintf(stderr, "%s: %s\n", golden_filename, strerror(errno));
+                        return 1;
+                }
+        }
+
+        int mismatch_count = 0;
+
+        for (uint32_t i = 0; i < frame_count; i++) {
+                const uint32_t frame_index = i * frame_step;
+
+                /* The scene only moves a frame at a time, and LOD selection
+                 * depends on the frames before, so every frame in between is
+                 * built too */
+                if (i > 0) {
+                        for (uint32_t j = 1; j < frame_step; j++) {
+                                scene_build(&_scene, &_draw_list);
+                        }
+                }
+
+                _frame_render(&_frame, &_raster, &_scene);
+
+                const uint32_t cmdts_hash = _cmdts_hash(&_frame);
+                const uint32_t fb_hash = _fb_hash(&_raster);
+
+                printf("frame %4" PRIu32 ": %4" PRIu32 " cmdts, %2" PRIu32 " meshes (%" PRIu32 " dropped), cmdts %08" PRIx32 ", fb %08" PRIx32 "\n",
+                    frame_index, _frame.cmdts_count, _draw_list.count, _draw_list.dropped_count,
+                    cmdts_hash, fb_hash);
+
+                if (_raster.unsupported_count > 0) {
+                        fprintf(stderr, "frame %" PRIu32 ": %" PRIu32 " unsupported commands\n",
+                            frame_index, _raster.unsupported_count);
+                }
+
+                if (output_path != NULL) {
+                        char filename[1024];
+
+                        snprintf(filename, sizeof(filename), "%s/frame_%04" PRIu32 ".ppm",
+                            output_path, frame_index);
+
+                        if (!(raster_ppm_write(&_raster, filename))) {
+                                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                                return 1;
+                        }
+                }
+
+                if (golden_fp != NULL) {
+                        fprintf(golden_fp, "%" PRIu32 " %08" PRIx32 " %08" PRIx32 "\n",
+                            frame_index, cmdts_hash, fb_hash);
+                } else if (golden_filename != NULL) {
+                        mismatch_count += _golden_check(golden_filename, frame_index, cmdts_hash, fb_hash);
+                }
+        }
+
+        if (golden_fp != NULL) {
+                fclose(golden_fp);
+        }
+
+        if (mismatch_count > 0) {
+                fprintf(stderr, "%i frame(s) differ from %s\n", mismatch_count, golden_filename);
+                return 1;
+        }
+
+        return 0;
+}
+
+void
+render_enable(uint32_t flags)
+{
+        if ((flags & RENDER_FLAGS_LIGHTING) != 0) {
+                _lighting = true;
+        }
+}
+
+void
+render_disable(uint32_t flags)
+{
+        if ((flags & RENDER_FLAGS_LIGHTING) != 0) {
+                _lighting = false;
+        }
+}
+
+void
+render_mesh_xform(const mesh_t *mesh, const fix16_mat43_t *world_matrix)
+{
+        const object_t object = {
+                .mesh     = mesh,
+                .world    = *world_matrix,
+                .lighting = _lighting
+        };
+
+        _object_submit(&_frame, &object);
+}
+
+/* Like mic3d, depth is the view space Z, which is negative in front of the
+ * camera */
+void
+render_cmdt_insert(const vdp1_cmdt_t *cmdt, fix16_t depth)
+{
+        frame_t * const frame = &_frame;
+
+        frame->polygons_submitted++;
+
+        if (frame->polygons_count >= POLYGON_COUNT_MAX) {
+                return;
+        }
+
+        visible_polygon_t * const visible = &frame->polygons[frame->polygons_count];
+
+        visible->cmdt = *cmdt;
+        visible->lighting = false;
+        visible->depth = -depth;
+        visible->order = frame->polygons_count;
+
+        frame->polygons_count++;
+}
+
+static void
+_usage(const char *program)
+{
+        fprintf(stderr,
+            "%s [-f frames] [-s frame-step] [-a asset-directory] [-o ppm-directory] [-g golden-file [-w]] [-t iterations]\n"
+            "  -f  Number of frames to render (default %i)\n"
+            "  -s  Frames to advance the scene between rendered frames (default %i)\n"
+            "  -a  Directory to load the packed meshes and shading tables from (default %s)\n"
+            "  -o  Write each frame as a PPM file into this directory\n"
+            "  -g  Compare the hashes of each frame against this file\n"
+            "  -w  Write the hashes to the golden file instead\n"
+            "  -t  Print per stage timings, averaged over this many iterations\n",
+            program, FRAME_COUNT_DEFAULT, FRAME_STEP_DEFAULT, ASSET_PATH_DEFAULT);
+}
+
+static void
+_view_init(view_t *view)
+{
+        /* Same camera as vdp1-mic3d.c, looking from (0,0,10) at the origin.
+         * Like VDP1, screen Y points down, so the basis is mirrored in X to
+         * keep the letters reading "MIC" */
+        view->position = (fix16_vec3_t)FIX16_VEC3_INITIALIZER( 0.0, 0.0, 10.0);
+        view->right    = (fix16_vec3_t)FIX16_VEC3_INITIALIZER(-1.0, 0.0,  0.0);
+        view->up       = (fix16_vec3_t)FIX16_VEC3_INITIALIZER( 0.0, 1.0,  0.0);
+        view->forward  = (fix16_vec3_t)FIX16_VEC3_INITIALIZER( 0.0, 0.0, -1.0);
+
+        /* Roughly unit length */
+        view->light    = (fix16_vec3_t)FIX16_VEC3_INITIALIZER(-0.4, 0.6, 0.7);
+}
+
+static void
+_vram_init(raster_t *raster, const char *asset_path)
+{
+        const picture_t * const pictures[] = {
+                &picture_mika,
+                &picture_tails,
+                &picture_baku
+        };
+
+        uint32_t offset = VRAM_TEXTURE_BASE;
+
+        /* Same slots the texture cache gives the pictures in vdp1-mic3d.c */
+        for (uint32_t i = 0; i < 3; i++) {
+                const picture_t * const picture = pictures[i];
+
+                raster_vram_write(raster, offset, picture->data, picture->data_size / 2);
+
+                _textures[i].size = ((picture->width / 8) << 8) | picture->height;
+                _textures[i].vram_index = offset / 8;
+
+                offset += (picture->data_size + 0x1F) & ~0x1F;
+        }
+
+        const uint16_t * const palette = palette_baku.data;
+
+        for (uint32_t i = 0; i < (palette_baku.data_size / 2); i++) {
+                raster->cram[i] = palette[i];
+        }
+
+        /* The ramp is already big endian, so it goes into VRAM as is */
+        size_t ramp_size;
+        void * const ramp = _file_read(asset_path, "gouraud_ramp.gst", &ramp_size);
+
+        if (ramp_size != (GOURAUD_RAMP_COUNT * sizeof(vdp1_gouraud_table_t))) {
+                fprintf(stderr, "gouraud_ramp.gst: expected %i tables\n", GOURAUD_RAMP_COUNT);
+                exit(1);
+        }
+
+        memcpy(&raster->vram[VRAM_GOURAUD_BASE], ramp, ramp_size);
+
+        free(ramp);
+}
+
+/* Sets up the scene like main() in vdp1-mic3d.c. The rooms are left out, since
+ * they stream from CD */
+static void
+_scene_init(const char *asset_path)
+{
+        _mesh_load(asset_path, "mesh_m.msh", &_mesh_m);
+        _mesh_load(asset_path, "mesh_i.msh", &_mesh_i);
+        _mesh_load(asset_path, "mesh_c.msh", &_mesh_c);
+
+        mesh_torus_lod_init();
+
+        camera_t camera;
+
+        camera.position = _view.position;
+        camera.target = (fix16_vec3_t)FIX16_VEC3_INITIALIZER(0.0, 0.0, 0.0);
+        camera.up = _view.up;
+
+        cull_frustum_set(&_frustum, &camera, FRUSTUM_X_SLOPE, FRUSTUM_Y_SLOPE,
+            FRUSTUM_NEAR, FRUSTUM_FAR);
+
+        /* The origin is in the center of the screen */
+        clip_init(&_screen_clip, -SCREEN_WIDTH / 2, -SCREEN_HEIGHT / 2,
+            (SCREEN_WIDTH / 2) - 1, (SCREEN_HEIGHT / 2) - 1, CLIP_AREA_MIN);
+
+        _scene_config.torus_meshes[0] = &mesh_torus;
+        _scene_config.torus_meshes[1] = &mesh_torus_lod1;
+        _scene_config.torus_meshes[2] = &mesh_torus_lod2;
+        _scene_config.cube_mesh = &mesh_cube;
+        _scene_config.letter_meshes[0] = &_mesh_m;
+        _scene_config.letter_meshes[1] = &_mesh_i;
+        _scene_config.letter_meshes[2] = &_mesh_c;
+        _scene_config.room_meshes = NULL;
+        _scene_config.room_spheres = NULL;
+        _scene_config.frustum = &_frustum;
+        _scene_config.cost_model = &vdp1_cost_model_default;
+        _scene_config.width = SCREEN_WIDTH;
+        _scene_config.height = SCREEN_HEIGHT;
+        _scene_config.budget = VDP1_BUDGET_TICKS;
+
+        scene_init(&_scene, &_scene_config);
+}
+
+/* The mesh and its attributes are never freed */
+static void
+_mesh_load(const char *asset_path, const char *filename, mesh_t *mesh)
+{
+        size_t size;
+        uint8_t * const pack = _file_read(asset_path, filename, &size);
+
+        _mesh_pack_swap(pack, size);
+
+        const uint32_t polygons_count = mesh_pack_polygons_count_get(pack);
+
+        attribute_t * const attributes = malloc(sizeof(attribute_t) * polygons_count);
+
+        if (attributes == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                exit(1);
+        }
+
+        mesh_pack_load(pack, mesh, attributes);
+}
+
+static void *
+_file_read(const char *asset_path, const char *filename, size_t *size)
+{
+        char path[1024];
+
+        snprintf(path, sizeof(path), "%s/%s", asset_path, filename);
+
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
+                exit(1);
+        }
+
+        fseek(fp, 0, SEEK_END);
+        const long file_size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        void * const data = malloc(file_size);
+
+        if ((data == NULL) || (fread(data, 1, file_size, fp) != (size_t)file_size)) {
+                fprintf(stderr, "%s: failed to read\n", path);
+                exit(1);
+        }
+
+        fclose(fp);
+
+        *size = file_size;
+
+        return data;
+}
+
+/* Packed meshes are big endian, as the Saturn reads them in place. Swaps each
+ * field to host order, so that mesh_pack_load() can do the same here */
+static void
+_mesh_pack_swap(uint8_t *pack, size_t size)
+{
+        if (size < 32) {
+                fprintf(stderr, "packed mesh too small (%zu bytes)\n", size);
+                exit(1);
+        }
+
+        /* Version through the padding, then the four offsets */
+        _swap16(&pack[4], 6);
+        _swap32(&pack[16], 4);
+
+        uint16_t header[6];
+        uint32_t offsets[4];
+
+        memcpy(header, &pack[4], sizeof(header));
+        memcpy(offsets, &pack[16], sizeof(offsets));
+
+        const uint16_t flags = header[1];
+        const uint16_t points_count = header[2];
+        const uint16_t polygons_count = header[3];
+        const uint16_t attributes_count = header[4];
+
+        /* Same as MESH_PACK_FLAG_NORMALS and MESH_PACK_FLAG_SHADING_SLOTS in
+         * mesh_pack.c */
+        const bool has_normals = (flags & (1 << 0)) != 0;
+        const bool has_shading_slots = (flags & (1 << 1)) != 0;
+
+        const size_t polygons_end = offsets[2] + (polygons_count * 12) +
+            (has_shading_slots ? (polygons_count * 2) : 0);
+
+        if (((offsets[0] + (points_count * 12)) > size) ||
+            (has_normals && ((offsets[1] + (points_count * 12)) > size)) ||
+            (polygons_end > size) ||
+            ((offsets[3] + (attributes_count * 8)) > size)) {
+                fprintf(stderr, "packed mesh is truncated\n");
+                exit(1);
+        }
+
+        _swap32(&pack[offsets[0]], points_count * 3);
+
+        if (has_normals) {
+                _swap32(&pack[offsets[1]], points_count * 3);
+        }
+
+        /* Six words per polygon, followed by a shading slot per polygon */
+        _swap16(&pack[offsets[2]], polygons_count * 6);
+
+        if (has_shading_slots) {
+                _swap16(&pack[offsets[2] + (polygons_count * 12)], polygons_count);
+        }
+
+        /* Draw mode, command, link type, base color, and texture slot */
+        for (uint32_t i = 0; i < attributes_count; i++) {
+                uint8_t * const attribute = &pack[offsets[3] + (i * 8)];
+
+                _swap16(&attribute[0], 1);
+                _swap16(&attribute[4], 2);
+        }
+}
+
+static void
+_swap16(uint8_t *p, uint32_t count)
+{
+        for (uint32_t i = 0; i < count; i++, p += 2) {
+                const uint16_t value = (p[0] << 8) | p[1];
+
+                memcpy(p, &value, sizeof(value));
+        }
+}
+
+static void
+_swap32(uint8_t *p, uint32_t count)
+{
+        for (uint32_t i = 0; i < count; i++, p += 4) {
+                const uint32_t value = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+
+                memcpy(p, &value, sizeof(value));
+        }
+}
+
+static void
+_frame_render(frame_t *frame, raster_t *raster, scene_t *scene)
+{
+        _frame_start(frame);
+
+        const uint64_t start = _ns_get();
+        scene_build(scene, &_draw_list);
+        frame->stage_ns[STAGE_SCENE] += _ns_get() - start;
+
+        draw_list_render(&_draw_list);
+
+        _polygons_insert(&_draw_list);
+
+        _frame_end(frame, raster);
+}
+
+static void
+_frame_start(frame_t *frame)
+{
+        frame->polygons_count = 0;
+        frame->polygons_submitted = 0;
+
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+                frame->stage_ns[i] = 0;
+        }
+}
+
+static void
+_frame_end(frame_t *frame, raster_t *raster)
+{
+        uint64_t start = _ns_get();
+        _sort(frame);
+        frame->stage_ns[STAGE_SORT] += _ns_get() - start;
+
+        start = _ns_get();
+        _cmdts_build(frame, raster);
+        frame->stage_ns[STAGE_CMDT] += _ns_get() - start;
+
+        start = _ns_get();
+        raster_clear(raster, 0x8000);
+        raster_cmdts_draw(raster, frame->cmdts, frame->cmdts_count);
+        frame->stage_ns[STAGE_RASTER] += _ns_get() - start;
+}
+
+/* Inserts the polygons vdp1-mic3d.c inserts, clipped the same way */
+static void
+_polygons_insert(const draw_list_t *list)
+{
+        const uint64_t start = _ns_get();
+
+        scene_polygon_t polygons[SCENE_POLYGON_COUNT];
+
+        scene_polygons_build(list, polygons);
+
+        for (uint32_t i = 0; i < SCENE_POLYGON_COUNT; i++) {
+                vdp1_cmdt_t clipped_cmdts[CLIP_CMDT_COUNT_MAX];
+
+                const uint32_t count = clip_polygon(&_screen_clip, &polygons[i].cmdt, clipped_cmdts);
+
+                for (uint32_t j = 0; j < count; j++) {
+                        render_cmdt_insert(&clipped_cmdts[j], polygons[i].depth);
+                }
+        }
+
+        _frame.stage_ns[STAGE_CLIP] += _ns_get() - start;
+}
+
+static void
+_object_submit(frame_t *frame, const object_t *object)
+{
+        static screen_point_t points[POINT_COUNT_MAX];
+
+        uint64_t start = _ns_get();
+        _transform(object, points);
+        frame->stage_ns[STAGE_TRANSFORM] += _ns_get() - start;
+
+        start = _ns_get();
+        _clip(frame, object, points);
+        frame->stage_ns[STAGE_CLIP] += _ns_get() - start;
+}
+
+/* Transforms each point into view space and projects it. Lit meshes also get
+ * a shade per point from their normals */
+static void
+_transform(const object_t *object, screen_point_t *points)
+{
+        const mesh_t * const mesh = object->mesh;
+        const fix16_mat43_t * const world = &object->world;
+
+        if (mesh->points_count > POINT_COUNT_MAX) {
+                fprintf(stderr, "mesh has too many points (%" PRIu32 ")\n", mesh->points_count);
+                exit(1);
+        }
+
+        for (uint32_t i = 0; i < mesh->points_count; i++) {
+                fix16_vec3_t p;
+
+                _mat33_vec3_mul(&world->rotation, &mesh->points[i], &p);
+
+                p.x += world->translation.x - _view.position.x;
+                p.y += world->translation.y - _view.position.y;
+                p.z += world->translation.z - _view.position.z;
+
+                const fix16_t x = _dot(&p, &_view.right);
+                const fix16_t y = _dot(&p, &_view.up);
+                const fix16_t depth = _dot(&p, &_view.forward);
+
+                screen_point_t * const point = &points[i];
+
+                point->depth = depth;
+
+                if (depth >= NEAR_DEPTH) {
+                        point->x = ((int64_t)x * SCREEN_FOCAL) / depth;
+                        point->y = ((int64_t)y * SCREEN_FOCAL) / depth;
+                } else {
+                        point->x = 0;
+                        point->y = 0;
+                }
+
+                point->shade = 16;
+
+                if (object->lighting && (mesh->normals != NULL)) {
+                        fix16_vec3_t normal;
+
+                        _mat33_vec3_mul(&world->rotation, &mesh->normals[i], &normal);
+
+                        const fix16_t intensity = min(max(_dot(&normal, &_view.light), 0), FIX16(1.0));
+
+                        point->shade = 4 + ((intensity * 27) >> 16);
+                }
+        }
+}
+
+/* Rejects polygons that cross the near plane, fall outside the guard band or
+ * the screen, or face away. The rest are queued for sorting */
+static void
+_clip(frame_t *frame, const object_t *object, const screen_point_t *points)
+{
+        const mesh_t * const mesh = object->mesh;
+
+        fix16_t previous_depth = 0;
+
+        for (uint32_t i = 0; i < mesh->polygons_count; i++) {
+                const polygon_t * const polygon = &mesh->polygons[i];
+
+                frame->polygons_submitted++;
+
+                const screen_point_t * const p[4] = {
+                        &points[polygon->indices.p0],
+                        &points[polygon->indices.p1],
+                        &points[polygon->indices.p2],
+                        &points[polygon->indices.p3]
+                };
+
+                uint32_t outcode_and = 0x0F;
+                bool rejected = false;
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        if ((p[j]->depth < NEAR_DEPTH) ||
+                            (abs(p[j]->x) >= GUARD_BAND) || (abs(p[j]->y) >= GUARD_BAND)) {
+                                rejected = true;
+                                break;
+                        }
+
+                        uint32_t outcode = 0;
+
+                        outcode |= (p[j]->x < -(SCREEN_WIDTH / 2)) ? 0x01 : 0;
+                        outcode |= (p[j]->x >= (SCREEN_WIDTH / 2)) ? 0x02 : 0;
+                        outcode |= (p[j]->y < -(SCREEN_HEIGHT / 2)) ? 0x04 : 0;
+                        outcode |= (p[j]->y >= (SCREEN_HEIGHT / 2)) ? 0x08 : 0;
+
+                        outcode_and &= outcode;
+                }
+
+                if (rejected || (outcode_and != 0)) {
+                        continue;
+                }
+
+                if (polygon->flags.plane_type == PLANE_TYPE_SINGLE) {
+                        const int64_t cross =
+                            ((int64_t)(p[1]->x - p[0]->x) * (p[2]->y - p[0]->y)) -
+                            ((int64_t)(p[1]->y - p[0]->y) * (p[2]->x - p[0]->x));
+
+                        if (cross >= 0) {
+                                continue;
+                        }
+                }
+
+                fix16_t depth;
+
+                switch (polygon->flags.sort_type) {
+                case SORT_TYPE_MIN:
+                        depth = min(min(p[0]->depth, p[1]->depth), min(p[2]->depth, p[3]->depth));
+                        break;
+                case SORT_TYPE_MAX:
+                        depth = max(max(p[0]->depth, p[1]->depth), max(p[2]->depth, p[3]->depth));
+                        break;
+                case SORT_TYPE_BFR:
+                        /* Drawn right before the previous polygon */
+                        depth = previous_depth + 1;
+                        break;
+                case SORT_TYPE_CENTER:
+                default:
+                        depth = (fix16_t)(((int64_t)p[0]->depth + p[1]->depth +
+                                           p[2]->depth + p[3]->depth) / 4);
+                        break;
+                }
+
+                previous_depth = depth;
+
+                if (frame->polygons_count >= POLYGON_COUNT_MAX) {
+                        continue;
+                }
+
+                visible_polygon_t * const visible = &frame->polygons[frame->polygons_count];
+
+                _polygon_cmdt_build(&mesh->attributes[i], p, &visible->cmdt);
+
+                visible->lighting = object->lighting;
+                visible->depth = depth;
+                visible->order = frame->polygons_count;
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        visible->shades[j] = p[j]->shade;
+                }
+
+                frame->polygons_count++;
+        }
+}
+
+static void
+_polygon_cmdt_build(const attribute_t *attribute, const screen_point_t * const *p,
+    vdp1_cmdt_t *cmdt)
+{
+        cmdt->cmd_ctrl = (attribute->control.link_type << 12) | attribute->control.command;
+        cmdt->cmd_link = 0;
+        cmdt->cmd_pmod = attribute->draw_mode.raw;
+        cmdt->cmd_colr = attribute->palette_data.base_color.raw;
+        cmdt->cmd_srca = 0;
+        cmdt->cmd_size = 0;
+
+        if (attribute->control.command != COMMAND_TYPE_POLYGON) {
+                const texture_t * const texture = &_textures[attribute->texture_slot % 3];
+
+                cmdt->cmd_srca = texture->vram_index;
+                cmdt->cmd_size = texture->size;
+        }
+
+        for (uint32_t i = 0; i < 4; i++) {
+                cmdt->cmd_vertices[i].x = p[i]->x;
+                cmdt->cmd_vertices[i].y = p[i]->y;
+        }
+
+        cmdt->cmd_grda = (VRAM_GOURAUD_BASE / 8) + attribute->shading_slot;
+        cmdt->reserved = 0;
+}
+
+static int
+_polygon_compare(const void *a, const void *b)
+{
+        const visible_polygon_t * const pa = *(visible_polygon_t * const *)a;
+        const visible_polygon_t * const pb = *(visible_polygon_t * const *)b;
+
+        /* Back to front. Equal depths keep their submission order */
+        if (pa->depth != pb->depth) {
+                return (pa->depth > pb->depth) ? -1 : 1;
+        }
+
+        return (pa->order < pb->order) ? -1 : 1;
+}
+
+static void
+_sort(frame_t *frame)
+{
+        for (uint32_t i = 0; i < frame->polygons_count; i++) {
+                frame->sorted[i] = &frame->polygons[i];
+        }
+
+        qsort(frame->sorted, frame->polygons_count, sizeof(*frame->sorted), _polygon_compare);
+}
+
+static void
+_cmdts_build(frame_t *frame, raster_t *raster)
+{
+        vdp1_cmdt_t * const cmdts = frame->cmdts;
+
+        uint32_t count = 0;
+
+        memset(cmdts, 0, sizeof(vdp1_cmdt_t) * 2);
+
+        cmdts[count].cmd_ctrl = VDP1_CMDT_SYSTEM_CLIP;
+        cmdts[count].cmd_xc = SCREEN_WIDTH - 1;
+        cmdts[count].cmd_yc = SCREEN_HEIGHT - 1;
+        count++;
+
+        cmdts[count].cmd_ctrl = VDP1_CMDT_LOCAL_COORD;
+        cmdts[count].cmd_xa = SCREEN_WIDTH / 2;
+        cmdts[count].cmd_ya = SCREEN_HEIGHT / 2;
+        count++;
+
+        for (uint32_t i = 0; i < frame->polygons_count; i++) {
+                const visible_polygon_t * const polygon = frame->sorted[i];
+
+                vdp1_cmdt_t * const cmdt = &cmdts[count];
+
+                *cmdt = polygon->cmdt;
+
+                if (polygon->lighting) {
+                        const uint32_t slot = GOURAUD_LIGHT_BASE + (count - 2);
+
+                        uint16_t table[4];
+
+                        for (uint32_t j = 0; j < 4; j++) {
+                                const uint16_t shade = polygon->shades[j];
+
+                                table[j] = RGB1555(1, shade, shade, shade).raw;
+                        }
+
+                        raster_vram_write(raster, VRAM_GOURAUD_BASE + (slot * 8), table, 4);
+
+                        cmdt->cmd_grda = (VRAM_GOURAUD_BASE / 8) + slot;
+                }
+
+                count++;
+        }
+
+        memset(&cmdts[count], 0, sizeof(vdp1_cmdt_t));
+        cmdts[count].cmd_ctrl = VDP1_CMDT_END;
+        count++;
+
+        frame->cmdts_count = count;
+}
+
+/* Hashed field by field, so the hash doesn't depend on host endianness */
+static uint32_t
+_cmdts_hash(const frame_t *frame)
+{
+        uint32_t hash = 0x811C9DC5;
+
+        for (uint32_t i = 0; i < frame->cmdts_count; i++) {
+                const uint16_t * const fields = (const uint16_t *)&frame->cmdts[i];
+
+                for (uint32_t j = 0; j < (sizeof(vdp1_cmdt_t) / 2); j++) {
+                        hash = _fnv1a16(hash, fields[j]);
+                }
+        }
+
+        return hash;
+}
+
+static uint32_t
+_fb_hash(const raster_t *raster)
+{
+        uint32_t hash = 0x811C9DC5;
+
+        for (uint32_t i = 0; i < (RASTER_WIDTH * RASTER_HEIGHT); i++) {
+                hash = _fnv1a16(hash, raster->fb[i]);
+        }
+
+        return hash;
+}
+
+static uint32_t
+_fnv1a16(uint32_t hash, uint16_t value)
+{
+        hash = (hash ^ (value >> 8)) * 0x01000193;
+        hash = (hash ^ (value & 0xFF)) * 0x01000193;
+
+        return hash;
+}
+
+static void
+_timings_print(uint32_t iterations)
+{
+        /* Each mesh on its own, unrotated as on frame 0 */
+        const struct {
+                const char *name;
+                const mesh_t *mesh;
+                bool lighting;
+        } meshes[] = {
+                { "torus",      &mesh_torus,      true  },
+                { "torus lod1", &mesh_torus_lod1, true  },
+                { "torus lod2", &mesh_torus_lod2, true  },
+                { "cube",       &mesh_cube,       false },
+                { "m",          &_mesh_m,         false },
+                { "i",          &_mesh_i,         false },
+                { "c",          &_mesh_c,         false }
+        };
+
+        const uint32_t mesh_count = sizeof(meshes) / sizeof(*meshes);
+
+        /* Each scene iteration starts over from frame 0 */
+        const scene_t scene = _scene;
+
+        printf("%-12s %6s %6s %10s %10s %10s %10s %10s %10s  (us per frame)\n",
+            "mesh", "polys", "drawn", "scene", "transform", "clip", "sort", "cmdt", "raster");
+
+        for (uint32_t i = 0; i <= mesh_count; i++) {
+                const char * const name = (i < mesh_count) ? meshes[i].name : "scene";
+
+                uint64_t totals[STAGE_COUNT] = { 0 };
+
+                for (uint32_t j = 0; j < iterations; j++) {
+                        if (i < mesh_count) {
+                                /* Close enough that nothing is behind the
+                                 * near plane, and far enough that the torus
+                                 * fits */
+                                object_t object = {
+                                        .mesh     = meshes[i].mesh,
+                                        .world    = { .translation = FIX16_VEC3_INITIALIZER(0.0, 0.0, -60.0) },
+                                        .lighting = meshes[i].lighting
+                                };
+
+                                fix16_mat33_identity(&object.world.rotation);
+
+                                _frame_start(&_frame);
+                                _object_submit(&_frame, &object);
+                                _frame_end(&_frame, &_raster);
+                        } else {
+                                _scene = scene;
+
+                                _frame_render(&_frame, &_raster, &_scene);
+                        }
+
+                        for (uint32_t k = 0; k < STAGE_COUNT; k++) {
+                                totals[k] += _frame.stage_ns[k];
+                        }
+                }
+
+                printf("%-12s %6" PRIu32 " %6" PRIu32, name, _frame.polygons_submitted, _frame.polygons_count);
+
+                for (uint32_t k = 0; k < STAGE_COUNT; k++) {
+                        printf(" %10.2f", (double)totals[k] / (iterations * 1000.0));
+                }
+
+                printf("\n");
+        }
+}
+
+static int
+_golden_check(const char *filename, uint32_t frame_index, uint32_t cmdts_hash, uint32_t fb_hash)
+{
+        FILE * const fp = fopen(filename, "r");
+
+        if (fp == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                exit(1);
+        }
+
+        uint32_t golden_frame;
+        uint32_t golden_cmdts_hash;
+        uint32_t golden_fb_hash;
+
+        int result = -1;
+
+        while (fscanf(fp, "%" SCNu32 " %" SCNx32 " %" SCNx32,
+                &golden_frame, &golden_cmdts_hash, &golden_fb_hash) == 3) {
+                if (golden_frame != frame_index) {
+                        continue;
+                }
+
+                result = ((golden_cmdts_hash == cmdts_hash) && (golden_fb_hash == fb_hash)) ? 0 : 1;
+                break;
+        }
+
+        fclose(fp);
+
+        if (result < 0) {
+                fprintf(stderr, "frame %" PRIu32 ": not in %s\n", frame_index, filename);
+                return 1;
+        }
+
+        if (result > 0) {
+                fprintf(stderr, "frame %" PRIu32 ": expected cmdts %08" PRIx32 ", fb %08" PRIx32 "\n",
+                    frame_index, golden_cmdts_hash, golden_fb_hash);
+        }
+
+        return result;
+}
+
+static fix16_t
+_dot(const fix16_vec3_t *a, const fix16_vec3_t *b)
+{
+        const int64_t dot = ((int64_t)a->x * b->x) +
+                            ((int64_t)a->y * b->y) +
+                            ((int64_t)a->z * b->z);
+
+        return (fix16_t)(dot >> 16);
+}
+
+static void
+_mat33_vec3_mul(const fix16_mat33_t *m, const fix16_vec3_t *v, fix16_vec3_t *result)
+{
+        const fix16_vec3_t * const rows = (const fix16_vec3_t *)m->frow;
+
+        result->x = _dot(&rows[0], v);
+        result->y = _dot(&rows[1], v);
+        result->z = _dot(&rows[2], v);
+}
+
+static uint64_t
+_ns_get(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
@@ -0,0 +1,106 @@
+#ifndef HOST_SHIM_MIC3D_H
+#define HOST_SHIM_MIC3D_H
+
+/* Just enough of mic3d for the portable sources of this example to build on
+ * the host. The render functions are implemented by refrender.c */
+
+#include <yaul.h>
+
+typedef enum {
+        SORT_TYPE_BFR,
+        SORT_TYPE_MIN,
+        SORT_TYPE_MAX,
+        SORT_TYPE_CENTER
+} sort_type_t;
+
+typedef enum {
+        PLANE_TYPE_SINGLE,
+        PLANE_TYPE_DOUBLE
+} plane_type_t;
+
+typedef enum {
+        COMMAND_TYPE_SPRITE           = VDP1_CMDT_NORMAL_SPRITE,
+        COMMAND_TYPE_SCALED_SPRITE    = VDP1_CMDT_SCALED_SPRITE,
+        COMMAND_TYPE_DISTORTED_SPRITE = VDP1_CMDT_DISTORTED_SPRITE,
+        COMMAND_TYPE_POLYGON          = VDP1_CMDT_POLYGON,
+        COMMAND_TYPE_POLYLINE         = VDP1_CMDT_POLYLINE,
+        COMMAND_TYPE_LINE             = VDP1_CMDT_LINE
+} command_type_t;
+
+typedef enum {
+        LINK_TYPE_JUMP_NEXT,
+        LINK_TYPE_JUMP_ASSIGN,
+        LINK_TYPE_JUMP_CALL,
+        LINK_TYPE_JUMP_RETURN
+} link_type_t;
+
+typedef struct {
+        struct {
+                uint16_t sort_type:2;
+                uint16_t plane_type:1;
+                uint16_t use_texture:1;
+                uint16_t :12;
+        } flags;
+
+        struct {
+                uint16_t p0;
+                uint16_t p1;
+                uint16_t p2;
+                uint16_t p3;
+        } indices;
+} polygon_t;
+
+typedef struct {
+        vdp1_cmdt_draw_mode_t draw_mode;
+
+        struct {
+                uint8_t command:4;
+                uint8_t link_type:4;
+        } control;
+
+        union {
+                rgb1555_t base_color;
+                uint16_t base_index;
+        } palette_data;
+
+        uint16_t texture_slot;
+        uint16_t shading_slot;
+} attribute_t;
+
+typedef struct {
+        const fix16_vec3_t *points;
+        uint32_t points_count;
+        const fix16_vec3_t *normals;
+        const polygon_t *polygons;
+        const attribute_t *attributes;
+        uint32_t polygons_count;
+} mesh_t;
+
+typedef struct {
+        const void *data;
+        size_t data_size;
+        uint16_t width;
+        uint16_t height;
+} picture_t;
+
+typedef struct {
+        const void *data;
+        size_t data_size;
+} palette_t;
+
+typedef struct {
+        fix16_vec3_t position;
+        fix16_vec3_t target;
+        fix16_vec3_t up;
+} camera_t;
+
+#define RENDER_FLAGS_NONE     (0)
+#define RENDER_FLAGS_LIGHTING (1 << 0)
+
+void render_enable(uint32_t flags);
+void render_disable(uint32_t flags);
+
+void render_mesh_xform(const mesh_t *mesh, const fix16_mat43_t *world_matrix);
+void render_cmdt_insert(const vdp1_cmdt_t *cmdt, fix16_t depth);
+
+#endif /* HOST_SHIM_MIC3D_H */
@@ -0,0 +1,267 @@
+#ifndef HOST_SHIM_YAUL_H
+#define HOST_SHIM_YAUL_H
+
+/* Just enough of libyaul for the portable sources of this example to build on
+ * the host: the fixed point math, and the VDP1 command table */
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define __packed     __attribute__ ((packed))
+#define __aligned(n) __attribute__ ((aligned(n)))
+#define __unused     __attribute__ ((unused))
+
+/* The C library usually has one already */
+#ifndef __always_inline
+#define __always_inline __attribute__ ((always_inline))
+#endif
+
+#define min(a, b) ({                                                           \
+        __typeof__(a) _a = (a);                                                \
+        __typeof__(b) _b = (b);                                                \
+        (_a < _b) ? _a : _b;                                                   \
+})
+
+#define max(a, b) ({                                                           \
+        __typeof__(a) _a = (a);                                                \
+        __typeof__(b) _b = (b);                                                \
+        (_a > _b) ? _a : _b;                                                   \
+})
+
+typedef int32_t fix16_t;
+
+typedef struct {
+        fix16_t x;
+        fix16_t y;
+        fix16_t z;
+} fix16_vec3_t;
+
+typedef struct {
+        fix16_t frow[3][3];
+} fix16_mat33_t;
+
+typedef struct {
+        fix16_mat33_t rotation;
+        fix16_vec3_t translation;
+} fix16_mat43_t;
+
+typedef struct {
+        int16_t x;
+        int16_t y;
+} int16_vec2_t;
+
+/* A full turn is 65536 */
+typedef int16_t angle_t;
+
+#define DEG2ANGLE(d) ((angle_t)((65536.0 * (d)) / 360.0))
+
+#define FIX16(x) ((fix16_t)(((x) >= 0) ? (((x) * 65536.0) + 0.5) : (((x) * 65536.0) - 0.5)))
+
+#define FIX16_VEC3_INITIALIZER(x, y, z) { FIX16(x), FIX16(y), FIX16(z) }
+
+static inline fix16_t
+fix16_mul(fix16_t a, fix16_t b)
+{
+        return (fix16_t)(((int64_t)a * b) >> 16);
+}
+
+static inline fix16_t
+fix16_int32_from(int32_t value)
+{
+        return value << 16;
+}
+
+static inline int32_t
+fix16_int32_to(fix16_t value)
+{
+        return value >> 16;
+}
+
+static inline int32_t
+angle_int32_to(angle_t angle)
+{
+        return angle;
+}
+
+static inline void
+fix16_mat33_identity(fix16_mat33_t *m)
+{
+        *m = (fix16_mat33_t){ { { FIX16(1.0), 0, 0 }, { 0, FIX16(1.0), 0 }, { 0, 0, FIX16(1.0) } } };
+}
+
+/* The host has no sine table, so these go through libm instead. The results
+ * can be off from libyaul's by a bit or two */
+static inline void
+fix16_sincos(angle_t angle, fix16_t *s, fix16_t *c)
+{
+        const double radians = angle * (M_PI / 32768.0);
+
+        *s = FIX16(sin(radians));
+        *c = FIX16(cos(radians));
+}
+
+static inline void
+fix16_mat33_vec3_mul(const fix16_mat33_t *m, const fix16_vec3_t *v, fix16_vec3_t *result)
+{
+        fix16_vec3_t r;
+
+        r.x = fix16_mul(m->frow[0][0], v->x) + fix16_mul(m->frow[0][1], v->y) + fix16_mul(m->frow[0][2], v->z);
+        r.y = fix16_mul(m->frow[1][0], v->x) + fix16_mul(m->frow[1][1], v->y) + fix16_mul(m->frow[1][2], v->z);
+        r.z = fix16_mul(m->frow[2][0], v->x) + fix16_mul(m->frow[2][1], v->y) + fix16_mul(m->frow[2][2], v->z);
+
+        *result = r;
+}
+
+/* Multiplies m0 on the right by a rotation about one axis. Columns i and j are
+ * the ones the rotation mixes */
+static inline void
+fix16_mat33_axis_rotate(const fix16_mat33_t *m0, angle_t angle, uint32_t i, uint32_t j,
+    fix16_mat33_t *result)
+{
+        fix16_t s;
+        fix16_t c;
+
+        fix16_sincos(angle, &s, &c);
+
+        fix16_mat33_t r = *m0;
+
+        for (uint32_t row = 0; row < 3; row++) {
+                const fix16_t a = m0->frow[row][i];
+                const fix16_t b = m0->frow[row][j];
+
+                r.frow[row][i] = fix16_mul(a, c) + fix16_mul(b, s);
+                r.frow[row][j] = fix16_mul(b, c) - fix16_mul(a, s);
+        }
+
+        *result = r;
+}
+
+static inline void
+fix16_mat33_x_rotate(const fix16_mat33_t *m0, angle_t angle, fix16_mat33_t *result)
+{
+        fix16_mat33_axis_rotate(m0, angle, 1, 2, result);
+}
+
+static inline void
+fix16_mat33_y_rotate(const fix16_mat33_t *m0, angle_t angle, fix16_mat33_t *result)
+{
+        fix16_mat33_axis_rotate(m0, angle, 2, 0, result);
+}
+
+static inline void
+fix16_mat33_z_rotate(const fix16_mat33_t *m0, angle_t angle, fix16_mat33_t *result)
+{
+        fix16_mat33_axis_rotate(m0, angle, 0, 1, result);
+}
+
+static inline void
+fix16_mat33_z_rotation_create(angle_t angle, fix16_mat33_t *result)
+{
+        fix16_mat33_identity(result);
+        fix16_mat33_z_rotate(result, angle, result);
+}
+
+typedef union {
+        struct {
+                uint16_t r:5;
+                uint16_t g:5;
+                uint16_t b:5;
+                uint16_t msb:1;
+        };
+
+        uint16_t raw;
+} rgb1555_t;
+
+#define RGB1555(msb, r, g, b)                                                  \
+    ((rgb1555_t){ .raw = (((msb) & 0x01) << 15) | (((b) & 0x1F) << 10) |      \
+                         (((g) & 0x1F) << 5) | ((r) & 0x1F) })
+
+/* CMDPMOD, in host bit order */
+typedef union {
+        struct {
+                uint16_t cc_mode:3;
+                uint16_t color_mode:3;
+                uint16_t trans_pixel_disable:1;
+                uint16_t end_code_disable:1;
+                uint16_t mesh_enable:1;
+                uint16_t cmod:1;
+                uint16_t user_clipping_enable:1;
+                uint16_t user_clipping_mode:1;
+                uint16_t pre_clipping_disable:1;
+                uint16_t hss_enable:1;
+                uint16_t :1;
+                uint16_t msb_enable:1;
+        };
+
+        uint16_t raw;
+} vdp1_cmdt_draw_mode_t;
+
+#define VDP1_CMDT_CM_CB_16      (0)
+#define VDP1_CMDT_CM_CLUT_16    (1)
+#define VDP1_CMDT_CM_CB_64      (2)
+#define VDP1_CMDT_CM_CB_128     (3)
+#define VDP1_CMDT_CM_CB_256     (4)
+#define VDP1_CMDT_CM_RGB_32768  (5)
+
+#define VDP1_CMDT_CC_REPLACE    (0)
+#define VDP1_CMDT_CC_GOURAUD    (4)
+
+/* Command table as laid out in VDP1 VRAM */
+typedef struct {
+        uint16_t cmd_ctrl;
+        uint16_t cmd_link;
+        uint16_t cmd_pmod;
+        uint16_t cmd_colr;
+        uint16_t cmd_srca;
+        uint16_t cmd_size;
+
+        union {
+                struct {
+                        int16_t cmd_xa;
+                        int16_t cmd_ya;
+                        int16_t cmd_xb;
+                        int16_t cmd_yb;
+                        int16_t cmd_xc;
+                        int16_t cmd_yc;
+                        int16_t cmd_xd;
+                        int16_t cmd_yd;
+                };
+
+                int16_vec2_t cmd_vertices[4];
+        };
+
+        uint16_t cmd_grda;
+        uint16_t reserved;
+} vdp1_cmdt_t;
+
+#define VDP1_CMDT_END           (0x8000)
+
+#define VDP1_CMDT_NORMAL_SPRITE    (0x0000)
+#define VDP1_CMDT_SCALED_SPRITE    (0x0001)
+#define VDP1_CMDT_DISTORTED_SPRITE (0x0002)
+#define VDP1_CMDT_POLYGON          (0x0004)
+#define VDP1_CMDT_POLYLINE         (0x0005)
+#define VDP1_CMDT_LINE             (0x0006)
+#define VDP1_CMDT_SYSTEM_CLIP      (0x0009)
+#define VDP1_CMDT_LOCAL_COORD      (0x000A)
+
+static inline void
+vdp1_cmdt_polygon_set(vdp1_cmdt_t *cmdt)
+{
+        cmdt->cmd_ctrl = (cmdt->cmd_ctrl & 0x7FF0) | VDP1_CMDT_POLYGON;
+}
+
+static inline void
+vdp1_cmdt_draw_mode_set(vdp1_cmdt_t *cmdt, vdp1_cmdt_draw_mode_t draw_mode)
+{
+        cmdt->cmd_pmod = draw_mode.raw;
+}
+
+typedef struct {
+        rgb1555_t colors[4];
+} vdp1_gouraud_table_t;
+
+#endif /* HOST_SHIM_YAUL_H */
@@ -0,0 +1,54 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "lod.h"
+
+void
+lod_group_init(lod_group_t *group, const cull_sphere_t *sphere, fix16_t hysteresis)
+{
+        group->level_count = 0;
+        group->sphere = sphere;
+        group->hysteresis = hysteresis;
+        group->level = 0;
+}
+
+void
+lod_group_level_add(lod_group_t *group, const mesh_t *mesh, fix16_t distance)
+{
+        assert(group->level_count < LOD_LEVEL_COUNT_MAX);
+
+        lod_level_t * const level = &group->levels[group->level_count];
+
+        level->mesh = mesh;
+        level->distance = distance;
+
+        group->level_count++;
+}
+
+uint32_t
+lod_group_level_select(lod_group_t *group, fix16_t depth)
+{
+        const lod_level_t * const levels = group->levels;
+
+        uint32_t level = group->level;
+
+        /* Walk from the current level until the depth falls inside a
+         * level's band, widened by the hysteresis on both sides */
+        while (((level + 1) < group->level_count) &&
+               (depth > (levels[level].distance + group->hysteresis))) {
+                level++;
+        }
+
+        while ((level > 0) &&
+               (depth < (levels[level - 1].distance - group->hysteresis))) {
+                level--;
+        }
+
+        group->level = level;
+
+        return level;
+}
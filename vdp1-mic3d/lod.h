@@ -0,0 +1,38 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <mic3d.h>
+
+#include "cull.h"
+
+#define LOD_LEVEL_COUNT_MAX (4)
+
+typedef struct lod_level {
+        const mesh_t *mesh;
+        /* The level is used while the view space depth is below this
+         * distance. Ignored for the last level */
+        fix16_t distance;
+} lod_level_t;
+
+typedef struct lod_group {
+        lod_level_t levels[LOD_LEVEL_COUNT_MAX];
+        uint32_t level_count;
+        /* Bounding sphere shared by every level. Calculate it from the most
+         * detailed level */
+        const cull_sphere_t *sphere;
+        /* Distance past a threshold the depth has to go before switching
+         * levels. Stops meshes near a threshold from flickering between
+         * levels */
+        fix16_t hysteresis;
+        uint32_t level;
+} lod_group_t;
+
+void lod_group_init(lod_group_t *group, const cull_sphere_t *sphere, fix16_t hysteresis);
+
+/* Levels must be added from the most to the least detailed */
+void lod_group_level_add(lod_group_t *group, const mesh_t *mesh, fix16_t distance);
+
+/* Selects a level from the view space depth, and returns it */
+uint32_t lod_group_level_select(lod_group_t *group, fix16_t depth);
+
+#endif /* LOD_H */
@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <string.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "mesh_pack.h"
+
+#define MESH_PACK_VERSION (1)
+
+#define MESH_PACK_FLAG_NORMALS       (1 << 0)
+#define MESH_PACK_FLAG_SHADING_SLOTS (1 << 1)
+
+#define PATCH_ADDRESS(pack, x) ((void *)((uintptr_t)(pack) + (uintptr_t)(x)))
+
+typedef struct {
+        char sig[4];
+        uint16_t version;
+        uint16_t flags;
+        uint16_t points_count;
+        uint16_t polygons_count;
+        uint16_t attributes_count;
+        uint16_t :16;
+        uint32_t points_offset;
+        uint32_t normals_offset;
+        uint32_t polygons_offset;
+        uint32_t attributes_offset;
+} __packed mesh_pack_t;
+
+typedef struct {
+        uint16_t flags;
+        uint16_t attribute_index;
+        uint16_t indices[4];
+} __packed mesh_pack_polygon_t;
+
+typedef struct {
+        uint16_t draw_mode;
+        uint8_t command;
+        uint8_t link_type;
+        uint16_t base_color;
+        uint16_t texture_slot;
+} __packed mesh_pack_attribute_t;
+
+static_assert(sizeof(mesh_pack_t) == 32);
+static_assert(sizeof(mesh_pack_polygon_t) == 12);
+static_assert(sizeof(mesh_pack_attribute_t) == 8);
+
+/* The polygon table is converted in place */
+static_assert(sizeof(polygon_t) <= sizeof(mesh_pack_polygon_t));
+
+static const mesh_pack_t *_pack_get(const void *ptr);
+
+uint32_t
+mesh_pack_polygons_count_get(const void *ptr)
+{
+        return _pack_get(ptr)->polygons_count;
+}
+
+void
+mesh_pack_load(void *ptr, mesh_t *mesh, attribute_t *attributes)
+{
+        const mesh_pack_t * const pack = _pack_get(ptr);
+
+        const mesh_pack_polygon_t * const pack_polygons =
+            PATCH_ADDRESS(pack, pack->polygons_offset);
+        const mesh_pack_attribute_t * const pack_attributes =
+            PATCH_ADDRESS(pack, pack->attributes_offset);
+
+        /* The shading slots follow the polygon table, so converting the
+         * polygons doesn't touch them */
+        const uint16_t * const shading_slots =
+            (const uint16_t *)&pack_polygons[pack->polygons_count];
+
+        /* Taken from the offset rather than from pack_polygons, which points
+         * to packed records */
+        polygon_t * const polygons = PATCH_ADDRESS(pack, pack->polygons_offset);
+
+        /* Walks forward, and each record is read completely before its
+         * converted entry is written over it */
+        for (uint32_t i = 0; i < pack->polygons_count; i++) {
+                const mesh_pack_polygon_t pack_polygon = pack_polygons[i];
+
+                assert(pack_polygon.attribute_index < pack->attributes_count);
+
+                const mesh_pack_attribute_t * const pack_attribute =
+                    &pack_attributes[pack_polygon.attribute_index];
+
+                attribute_t * const attribute = &attributes[i];
+
+                attribute->draw_mode.raw = pack_attribute->draw_mode;
+                attribute->control.command = pack_attribute->command;
+                attribute->control.link_type = pack_attribute->link_type;
+                attribute->palette_data.base_color.raw = pack_attribute->base_color;
+                attribute->texture_slot = pack_attribute->texture_slot;
+                attribute->shading_slot =
+                    ((pack->flags & MESH_PACK_FLAG_SHADING_SLOTS) != 0) ? shading_slots[i] : 0;
+
+                polygon_t * const polygon = &polygons[i];
+
+                polygon->flags.sort_type = pack_polygon.flags & 3;
+                polygon->flags.plane_type = (pack_polygon.flags >> 2) & 1;
+                polygon->flags.use_texture = (pack_polygon.flags >> 3) & 1;
+
+                polygon->indices.p0 = pack_polygon.indices[0];
+                polygon->indices.p1 = pack_polygon.indices[1];
+                polygon->indices.p2 = pack_polygon.indices[2];
+                polygon->indices.p3 = pack_polygon.indices[3];
+        }
+
+        mesh->points = PATCH_ADDRESS(pack, pack->points_offset);
+        mesh->points_count = pack->points_count;
+        mesh->normals = ((pack->flags & MESH_PACK_FLAG_NORMALS) != 0)
+            ? PATCH_ADDRESS(pack, pack->normals_offset)
+            : NULL;
+        mesh->polygons = polygons;
+        mesh->attributes = attributes;
+        mesh->polygons_count = pack->polygons_count;
+}
+
+static const mesh_pack_t *
+_pack_get(const void *ptr)
+{
+        const mesh_pack_t * const pack = ptr;
+
+        assert((memcmp(pack->sig, "MSH", 4)) == 0);
+        assert(pack->version == MESH_PACK_VERSION);
+
+        return pack;
+}
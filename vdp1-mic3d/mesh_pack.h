@@ -0,0 +1,16 @@
+#ifndef MESH_PACK_H
+#define MESH_PACK_H
+
+#include <mic3d.h>
+
+/* Returns the number of polygons in a packed mesh. The attribute buffer passed
+ * to mesh_pack_load() needs this many entries */
+uint32_t mesh_pack_polygons_count_get(const void *ptr);
+
+/* Loads a mesh packed by work/mesh_pack.py. The points and normals are used
+ * directly from the buffer, and the polygon table is converted in place. Each
+ * polygon's attribute is expanded from the shared attribute table into
+ * attributes */
+void mesh_pack_load(void *ptr, mesh_t *mesh, attribute_t *attributes);
+
+#endif /* MESH_PACK_H */
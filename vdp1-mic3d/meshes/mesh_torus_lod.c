@@ -0,0 +1,86 @@
+#include "mesh.h"
+
+/* mesh_torus is a grid of 32 rings with 16 segments each. The lower detail
+ * levels are built at startup by keeping every 2nd (4th) ring and segment */
+#define TORUS_RINGS    (32)
+#define TORUS_SEGMENTS (16)
+
+#define LOD1_STEP (2)
+#define LOD2_STEP (4)
+
+#define LOD1_COUNT ((TORUS_RINGS / LOD1_STEP) * (TORUS_SEGMENTS / LOD1_STEP))
+#define LOD2_COUNT ((TORUS_RINGS / LOD2_STEP) * (TORUS_SEGMENTS / LOD2_STEP))
+
+extern const mesh_t mesh_torus;
+
+static fix16_vec3_t _points_torus_lod1[LOD1_COUNT];
+static fix16_vec3_t _normals_torus_lod1[LOD1_COUNT];
+static polygon_t _polygons_torus_lod1[LOD1_COUNT];
+static attribute_t _attributes_torus_lod1[LOD1_COUNT];
+
+static fix16_vec3_t _points_torus_lod2[LOD2_COUNT];
+static fix16_vec3_t _normals_torus_lod2[LOD2_COUNT];
+static polygon_t _polygons_torus_lod2[LOD2_COUNT];
+static attribute_t _attributes_torus_lod2[LOD2_COUNT];
+
+mesh_t mesh_torus_lod1 = {
+        .points         = _points_torus_lod1,
+        .points_count   = LOD1_COUNT,
+        .normals        = _normals_torus_lod1,
+        .attributes     = _attributes_torus_lod1,
+        .polygons       = _polygons_torus_lod1,
+        .polygons_count = LOD1_COUNT
+};
+
+mesh_t mesh_torus_lod2 = {
+        .points         = _points_torus_lod2,
+        .points_count   = LOD2_COUNT,
+        .normals        = _normals_torus_lod2,
+        .attributes     = _attributes_torus_lod2,
+        .polygons       = _polygons_torus_lod2,
+        .polygons_count = LOD2_COUNT
+};
+
+static void _torus_decimate(uint32_t step, fix16_vec3_t *points,
+    fix16_vec3_t *normals, polygon_t *polygons, attribute_t *attributes);
+
+void
+mesh_torus_lod_init(void)
+{
+        _torus_decimate(LOD1_STEP, _points_torus_lod1, _normals_torus_lod1,
+            _polygons_torus_lod1, _attributes_torus_lod1);
+        _torus_decimate(LOD2_STEP, _points_torus_lod2, _normals_torus_lod2,
+            _polygons_torus_lod2, _attributes_torus_lod2);
+}
+
+static void
+_torus_decimate(uint32_t step, fix16_vec3_t *points, fix16_vec3_t *normals,
+    polygon_t *polygons, attribute_t *attributes)
+{
+        const uint32_t rings = TORUS_RINGS / step;
+        const uint32_t segments = TORUS_SEGMENTS / step;
+
+        for (uint32_t r = 0; r < rings; r++) {
+                for (uint32_t s = 0; s < segments; s++) {
+                        const uint32_t i = (r * segments) + s;
+                        const uint32_t src_i = (r * step * TORUS_SEGMENTS) + (s * step);
+
+                        points[i] = mesh_torus.points[src_i];
+                        normals[i] = mesh_torus.normals[src_i];
+
+                        /* Each polygon keeps the attribute of the polygon at
+                         * its top-left corner */
+                        attributes[i] = mesh_torus.attributes[src_i];
+
+                        const uint32_t next_r = (r + 1) % rings;
+                        const uint32_t next_s = (s + 1) % segments;
+
+                        /* Same winding as mesh_torus */
+                        polygons[i] = mesh_torus.polygons[src_i];
+                        polygons[i].indices.p0 = (r * segments) + s;
+                        polygons[i].indices.p1 = (next_r * segments) + s;
+                        polygons[i].indices.p2 = (next_r * segments) + next_s;
+                        polygons[i].indices.p3 = (r * segments) + next_s;
+                }
+        }
+}
@@ -1,8 +1,11 @@
 #include <assert.h>
-#include <stdlib.h>
+
+#include <yaul.h>
 
 #include <mic3d.h>
 
+#include "s3d.h"
+
 #define PATCH_ADDRESS(s3d, x) ((void *)((uintptr_t)(s3d) + (uintptr_t)(x)))
 
 #define ATTRIBUTE(f, s, t, c, g, a, d, o) {                                    \
@@ -15,33 +18,71 @@
         (d) & 0x3F /* dir */                                                   \
 }
 
+/* SGL color modes as stored in PICTURE.cmode */
+#define COL_16  (0 << 3)
+#define COL_64  (1 << 3)
+#define COL_128 (2 << 3)
+#define COL_256 (3 << 3)
+#define COL_32K (5 << 3)
+
+/* CMDPMOD color modes that index into a VDP2 CRAM color bank */
+#define CMDPMOD_COLOR_MODE(x) (((x) >> 3) & 0x0007)
+#define CMDPMOD_COLOR_MODE_LUT (1)
+#define CMDPMOD_COLOR_MODE_RGB (5)
+
+/* The last command that reads a texture */
+#define COMMAND_TEXTURED_LAST (0x3)
+
+typedef fix16_t POINT[3];
+typedef fix16_t VECTOR[3];
+
+typedef struct {
+        uint16_t Hsize;
+        uint16_t Vsize;
+        uint16_t CGadr;
+        uint16_t HVsize;
+} __packed TEXTURE;
+
+typedef struct {
+        uint16_t texno;
+        uint16_t cmode;
+        void *pcsrc;
+} __packed PICTURE;
+
+typedef struct {
+        uint16_t texno;
+        uint16_t cmode;
+        void *data;
+        uint32_t data_size;
+} __packed s3d_texture_t;
+
+typedef struct {
+        uint16_t bank;
+        uint16_t :16;
+        void *data;
+        uint32_t data_size;
+} __packed s3d_palette_t;
+
 typedef struct {
         char sig[4];
         uint32_t version;
         uint32_t flags;
         uint32_t object_count;
 
-        /* TEXTURE *textures; */
-        /* uint32_t textures_count; */
-        unsigned int :32;
-        unsigned int :32;
+        TEXTURE *textures;
+        uint32_t textures_count;
 
-        /* PALETTE *palettes; */
-        /* uint32_t palettes_count; */
-        unsigned int :32;
-        unsigned int :32;
+        /* The palette table isn't needed. Each palette data entry carries its
+         * own size */
+        void *palettes;
+        uint32_t palettes_count;
 
-        /* g3d_s3d_texture_t *texture_datas; */
-        /* g3d_s3d_palette_t *palette_datas; */
-        unsigned int :32;
-        unsigned int :32;
+        s3d_texture_t *texture_datas;
+        s3d_palette_t *palette_datas;
 
         void *eof;
 } __packed s3d_t;
 
-typedef fix16_t POINT[3];
-typedef fix16_t VECTOR[3];
-
 typedef struct {
         VECTOR norm;
         uint16_t Vertices[4];
@@ -62,7 +103,6 @@ typedef struct {
         uint32_t nbPoint;
         POLYGON *pltbl;
         uint32_t nbPolygon;
-        /* unsigned int :32; */
         ATTR *attbl;
         VECTOR *vntbl;
 } __packed XPDATA;
@@ -70,17 +110,305 @@ typedef struct {
 typedef struct {
         XPDATA xpdata;
 
-        /* PICTURE *pictures; */
-        /* uint32_t picture_count; */
-        unsigned int :32;
-        unsigned int :32;
+        PICTURE *pictures;
+        uint32_t picture_count;
 
-        unsigned int :32;
-        unsigned int :32;
-        /* vdp1_gouraud_table_t *gouraud_tables; */
-        /* uint32_t gouraud_table_count; */
+        vdp1_gouraud_table_t *gouraud_tables;
+        uint32_t gouraud_table_count;
 } __packed s3d_object_t;
 
+/* Both tables are converted in place. Each converted entry must fit inside the
+ * SGL entry it replaces */
+static_assert(sizeof(polygon_t) <= sizeof(POLYGON));
+static_assert(sizeof(attribute_t) <= sizeof(ATTR));
+
+static s3d_object_t *_s3d_objects_get(const s3d_t *s3d);
+
+static void _stream_sectors_read(s3d_stream_t *stream, uint32_t sector_count);
+static uint32_t _table_end_get(const void *offset, uint32_t count, uint32_t size);
+static uint32_t _resources_end_get(const s3d_t *s3d, uint32_t read_size);
+static uint32_t _object_end_get(const s3d_t *s3d, const s3d_object_t *object, uint32_t read_size);
+
+static void _header_load(s3d_t *s3d, s3d_context_t *context);
+static void _object_load(s3d_t *s3d, s3d_context_t *context, s3d_object_t *object, mesh_t *mesh);
+static void _object_patch(s3d_t *s3d, s3d_object_t *object);
+static void _object_convert(const s3d_context_t *context, const s3d_object_t *object);
+
+static void _textures_load(s3d_t *s3d, s3d_context_t *context);
+static void _pictures_load(const s3d_t *s3d, s3d_context_t *context, const s3d_object_t *object);
+static void _palettes_load(s3d_t *s3d, s3d_context_t *context);
+static void _gouraud_tables_load(s3d_context_t *context, const s3d_object_t *object);
+
+static void _file_loaded(const s3d_t *s3d, s3d_context_t *context);
+static uint16_t _colno_convert(const s3d_context_t *context, const ATTR *sgl_attr);
+
+static void _texture_load(s3d_context_t *context, uint32_t slot, const TEXTURE *texture, const void *data, uint32_t data_size);
+static uint32_t _picture_size_calculate(const TEXTURE *texture, uint16_t cmode);
+
+uint32_t
+s3d_object_count_get(const void *ptr)
+{
+        const s3d_t * const s3d = ptr;
+
+        return s3d->object_count;
+}
+
+void
+s3d_read(void *ptr, s3d_context_t *context, mesh_t *meshes)
+{
+        s3d_t * const s3d = ptr;
+
+        _header_load(s3d, context);
+
+        s3d_object_t * const s3d_objects = _s3d_objects_get(s3d);
+
+        for (uint32_t i = 0; i < s3d->object_count; i++) {
+                _object_load(s3d, context, &s3d_objects[i], &meshes[i]);
+        }
+
+        _file_loaded(s3d, context);
+}
+
+void
+s3d_stream_init(s3d_stream_t *stream, void *buffer, uint32_t buffer_size,
+    uint32_t fad, uint32_t size, s3d_context_t *context, mesh_t *meshes,
+    uint32_t meshes_count)
+{
+        assert(size <= buffer_size);
+
+        stream->context = context;
+        stream->meshes = meshes;
+        stream->meshes_count = meshes_count;
+        stream->buffer = buffer;
+        stream->fad = fad;
+        stream->size = size;
+        stream->read_size = 0;
+        stream->state = S3D_STREAM_STATE_HEADER;
+        stream->object_count = 0;
+        stream->objects_published = 0;
+}
+
+uint32_t
+s3d_stream_update(s3d_stream_t *stream, uint32_t sector_count)
+{
+        if (stream->state == S3D_STREAM_STATE_DONE) {
+                return stream->objects_published;
+        }
+
+        _stream_sectors_read(stream, sector_count);
+
+        s3d_t * const s3d = (s3d_t *)stream->buffer;
+
+        if (stream->state == S3D_STREAM_STATE_HEADER) {
+                if (stream->read_size < sizeof(s3d_t)) {
+                        return 0;
+                }
+
+                const uint32_t objects_end =
+                    sizeof(s3d_t) + (s3d->object_count * sizeof(s3d_object_t));
+
+                if (stream->read_size < objects_end) {
+                        return 0;
+                }
+
+                assert(s3d->object_count <= stream->meshes_count);
+
+                stream->object_count = s3d->object_count;
+                stream->state = S3D_STREAM_STATE_RESOURCES;
+        }
+
+        if (stream->state == S3D_STREAM_STATE_RESOURCES) {
+                if (stream->read_size < _resources_end_get(s3d, stream->read_size)) {
+                        return 0;
+                }
+
+                _header_load(s3d, stream->context);
+
+                stream->state = S3D_STREAM_STATE_OBJECTS;
+        }
+
+        s3d_object_t * const s3d_objects = _s3d_objects_get(s3d);
+
+        /* Objects are published in order. An object is only published once
+         * all of its tables have arrived */
+        while (stream->objects_published < stream->object_count) {
+                const uint32_t i = stream->objects_published;
+                s3d_object_t * const object = &s3d_objects[i];
+
+                if (stream->read_size < _object_end_get(s3d, object, stream->read_size)) {
+                        break;
+                }
+
+                _object_load(s3d, stream->context, object, &stream->meshes[i]);
+
+                stream->objects_published++;
+        }
+
+        if (stream->objects_published == stream->object_count) {
+                _file_loaded(s3d, stream->context);
+
+                stream->state = S3D_STREAM_STATE_DONE;
+        }
+
+        return stream->objects_published;
+}
+
+bool
+s3d_stream_done(const s3d_stream_t *stream)
+{
+        return (stream->state == S3D_STREAM_STATE_DONE);
+}
+
+static void
+_stream_sectors_read(s3d_stream_t *stream, uint32_t sector_count)
+{
+        const uint32_t remaining_size = stream->size - stream->read_size;
+
+        if (remaining_size == 0) {
+                return;
+        }
+
+        const uint32_t read_size =
+            min(sector_count * S3D_STREAM_SECTOR_SIZE, remaining_size);
+        const uint32_t sector_offset = stream->read_size / S3D_STREAM_SECTOR_SIZE;
+
+        int ret __unused;
+        ret = cd_block_sectors_read(stream->fad + sector_offset,
+            &stream->buffer[stream->read_size], read_size);
+        assert(ret == 0);
+
+        stream->read_size += read_size;
+}
+
+static uint32_t
+_table_end_get(const void *offset, uint32_t count, uint32_t size)
+{
+        if (count == 0) {
+                return 0;
+        }
+
+        return (uintptr_t)offset + (count * size);
+}
+
+static uint32_t
+_resources_end_get(const s3d_t *s3d, uint32_t read_size)
+{
+        uint32_t end;
+        end = _table_end_get(s3d->textures, s3d->textures_count, sizeof(TEXTURE));
+
+        if ((s3d->textures_count > 0) && (s3d->texture_datas != NULL)) {
+                end = max(end, _table_end_get(s3d->texture_datas,
+                        s3d->textures_count, sizeof(s3d_texture_t)));
+        }
+
+        if ((s3d->palettes_count > 0) && (s3d->palette_datas != NULL)) {
+                end = max(end, _table_end_get(s3d->palette_datas,
+                        s3d->palettes_count, sizeof(s3d_palette_t)));
+        }
+
+        /* The data tables must arrive first before the size of the data they
+         * point to is known */
+        if (read_size < end) {
+                return end;
+        }
+
+        if ((s3d->textures_count > 0) && (s3d->texture_datas != NULL)) {
+                const s3d_texture_t * const texture_datas =
+                    PATCH_ADDRESS(s3d, s3d->texture_datas);
+
+                for (uint32_t i = 0; i < s3d->textures_count; i++) {
+                        end = max(end, _table_end_get(texture_datas[i].data,
+                                1, texture_datas[i].data_size));
+                }
+        }
+
+        if ((s3d->palettes_count > 0) && (s3d->palette_datas != NULL)) {
+                const s3d_palette_t * const palette_datas =
+                    PATCH_ADDRESS(s3d, s3d->palette_datas);
+
+                for (uint32_t i = 0; i < s3d->palettes_count; i++) {
+                        end = max(end, _table_end_get(palette_datas[i].data,
+                                1, palette_datas[i].data_size));
+                }
+        }
+
+        return end;
+}
+
+static uint32_t
+_object_end_get(const s3d_t *s3d, const s3d_object_t *object, uint32_t read_size)
+{
+        /* By now, the header has been loaded and its addresses patched */
+        const uint32_t eof = (uintptr_t)s3d->eof - (uintptr_t)s3d;
+
+        const XPDATA * const xpdata = &object->xpdata;
+
+        uint32_t end;
+        end = _table_end_get(xpdata->pntbl, xpdata->nbPoint, sizeof(POINT));
+        end = max(end, _table_end_get(xpdata->pltbl, xpdata->nbPolygon, sizeof(POLYGON)));
+        end = max(end, _table_end_get(xpdata->attbl, xpdata->nbPolygon, sizeof(ATTR)));
+        /* Exporters don't always write one normal per vertex, so the normal
+         * table may be cut short by the end of the file */
+        end = max(end, min(eof, _table_end_get(xpdata->vntbl, xpdata->nbPoint, sizeof(VECTOR))));
+        end = max(end, _table_end_get(object->pictures, object->picture_count, sizeof(PICTURE)));
+        end = max(end, _table_end_get(object->gouraud_tables,
+                object->gouraud_table_count, sizeof(vdp1_gouraud_table_t)));
+
+        /* The size of the picture data is only known once the picture table
+         * has arrived */
+        if (read_size < end) {
+                return end;
+        }
+
+        if ((object->picture_count > 0) && (s3d->texture_datas == NULL)) {
+                const PICTURE * const pictures = PATCH_ADDRESS(s3d, object->pictures);
+                const TEXTURE * const textures = s3d->textures;
+
+                for (uint32_t i = 0; i < object->picture_count; i++) {
+                        const PICTURE * const picture = &pictures[i];
+
+                        end = max(end, _table_end_get(picture->pcsrc, 1,
+                                _picture_size_calculate(&textures[picture->texno],
+                                    picture->cmode)));
+                }
+        }
+
+        return end;
+}
+
+static void
+_header_load(s3d_t *s3d, s3d_context_t *context)
+{
+        assert((s3d->sig[0] == 'S') && (s3d->sig[1] == '3') && (s3d->sig[2] == 'D'));
+
+        s3d->eof = PATCH_ADDRESS(s3d, s3d->eof);
+
+        _textures_load(s3d, context);
+        _palettes_load(s3d, context);
+}
+
+static void
+_object_load(s3d_t *s3d, s3d_context_t *context, s3d_object_t *object, mesh_t *mesh)
+{
+        _object_patch(s3d, object);
+
+        if (s3d->texture_datas == NULL) {
+                _pictures_load(s3d, context, object);
+        }
+
+        _object_convert(context, object);
+        _gouraud_tables_load(context, object);
+
+        mesh->points = (const fix16_vec3_t *)object->xpdata.pntbl;
+        mesh->points_count = object->xpdata.nbPoint;
+        /* Per-vertex normals. Only meaningful when the exporter wrote one
+         * normal per vertex, which lighting requires */
+        mesh->normals = (const fix16_vec3_t *)object->xpdata.vntbl;
+        mesh->polygons = (const polygon_t *)object->xpdata.pltbl;
+        mesh->attributes = (const attribute_t *)object->xpdata.attbl;
+        mesh->polygons_count = object->xpdata.nbPolygon;
+}
+
 static s3d_object_t *
 _s3d_objects_get(const s3d_t *s3d)
 {
@@ -94,47 +422,202 @@ _object_patch(s3d_t *s3d, s3d_object_t *object)
         object->xpdata.pltbl = PATCH_ADDRESS(s3d, object->xpdata.pltbl);
         object->xpdata.attbl = PATCH_ADDRESS(s3d, object->xpdata.attbl);
         object->xpdata.vntbl = PATCH_ADDRESS(s3d, object->xpdata.vntbl);
-        /* object->gouraud_tables = PATCH_ADDRESS(s3d, object->gouraud_tables); */
-        /* object->pictures = PATCH_ADDRESS(s3d, object->pictures); */
+
+        if (object->picture_count > 0) {
+                object->pictures = PATCH_ADDRESS(s3d, object->pictures);
+
+                for (uint32_t i = 0; i < object->picture_count; i++) {
+                        object->pictures[i].pcsrc =
+                            PATCH_ADDRESS(s3d, object->pictures[i].pcsrc);
+                }
+        }
+
+        if (object->gouraud_table_count > 0) {
+                object->gouraud_tables = PATCH_ADDRESS(s3d, object->gouraud_tables);
+        }
 }
 
-void
-s3d_read(void *ptr, mesh_t *mesh)
+static void
+_object_convert(const s3d_context_t *context, const s3d_object_t *object)
 {
-        s3d_t * const s3d = ptr;
+        /* Both conversions walk forward, and each SGL entry is read completely
+         * before its converted entry is written over it */
+        for (uint32_t i = 0; i < object->xpdata.nbPolygon; i++) {
+                const ATTR sgl_attr = object->xpdata.attbl[i];
+                const POLYGON sgl_polygon = object->xpdata.pltbl[i];
 
-        s3d_object_t * const s3d_objects = _s3d_objects_get(s3d);
+                polygon_t * const polygon = &((polygon_t *)object->xpdata.pltbl)[i];
 
-        s3d->eof = PATCH_ADDRESS(s3d, s3d->eof);
+                polygon->flags.sort_type = sgl_attr.sort & 3;
+                polygon->flags.plane_type = sgl_attr.flag;
+                polygon->flags.use_texture = (sgl_attr.sort >> 2) & 1;
 
-        s3d_object_t * const object = &s3d_objects[0];
+                polygon->indices.p0 = sgl_polygon.Vertices[0];
+                polygon->indices.p1 = sgl_polygon.Vertices[1];
+                polygon->indices.p2 = sgl_polygon.Vertices[2];
+                polygon->indices.p3 = sgl_polygon.Vertices[3];
 
-        _object_patch(s3d, object);
+                attribute_t * const attribute = &((attribute_t *)object->xpdata.attbl)[i];
 
-        mesh->points = (fix16_vec3_t *)object->xpdata.pntbl;
-        mesh->points_count = object->xpdata.nbPoint;
-        attribute_t * const attributes =
-            malloc(sizeof(attribute_t) * object->xpdata.nbPolygon);
-        assert(attributes != NULL);
+                attribute->draw_mode.raw = sgl_attr.atrb;
+                attribute->control.command = sgl_attr.dir & 0xF;
+                attribute->control.link_type = LINK_TYPE_JUMP_ASSIGN;
+                attribute->palette_data.base_color.raw = _colno_convert(context, &sgl_attr);
+                attribute->texture_slot = context->texture_slot + sgl_attr.texno;
+                attribute->shading_slot = context->shading_slot + sgl_attr.gstb;
+        }
+}
 
-        mesh->attributes = attributes;
+/* The texture slots and palette banks are shared between objects, so only
+ * advance once every object has been converted */
+static void
+_file_loaded(const s3d_t *s3d, s3d_context_t *context)
+{
+        context->texture_slot += s3d->textures_count;
+        context->textures_loaded = 0;
 
-        for (uint32_t i = 0; i < object->xpdata.nbPolygon; i++) {
-                attribute_t * const attribute = &attributes[i];
-                const ATTR * const sgl_attr = &object->xpdata.attbl[i];
+        context->palette_bank += s3d->palettes_count;
+}
+
+static uint16_t
+_colno_convert(const s3d_context_t *context, const ATTR *sgl_attr)
+{
+        const uint16_t command = sgl_attr->dir & 0xF;
+        const uint16_t color_mode = CMDPMOD_COLOR_MODE(sgl_attr->atrb);
 
-                attribute->draw_mode.raw = sgl_attr->atrb;
-                attribute->control.sort_type = sgl_attr->sort & 3;
-                attribute->control.read_dir = (sgl_attr->dir >> 4) & 3;
-                attribute->control.use_texture = (sgl_attr->sort >> 2) & 1;
-                attribute->control.use_lighting = (sgl_attr->sort >> 3) & 1;
-                attribute->control.command = sgl_attr->dir & 0xF;
+        bool color_bank;
 
-                attribute->base_color.raw = sgl_attr->colno;
-                attribute->texture_slot = sgl_attr->texno;
-                attribute->shading_slot = sgl_attr->gstb;
+        if (command <= COMMAND_TEXTURED_LAST) {
+                /* In lookup table mode, colno is a VDP1 VRAM address */
+                color_bank = (color_mode != CMDPMOD_COLOR_MODE_LUT) &&
+                             (color_mode != CMDPMOD_COLOR_MODE_RGB);
+        } else {
+                /* Untextured colors are either RGB or a color number */
+                color_bank = (sgl_attr->colno & 0x8000) == 0;
         }
 
-        mesh->polygons = (polygon_t *)object->xpdata.pltbl;
-        mesh->polygons_count = object->xpdata.nbPolygon;
+        if (!color_bank) {
+                return sgl_attr->colno;
+        }
+
+        /* The file's palettes were uploaded starting at palette_bank */
+        return sgl_attr->colno + (context->palette_bank << 8);
+}
+
+static void
+_textures_load(s3d_t *s3d, s3d_context_t *context)
+{
+        assert((context->texture_slot + s3d->textures_count) <= context->textures_count);
+        assert(s3d->textures_count <= 32);
+
+        if (s3d->textures_count == 0) {
+                return;
+        }
+
+        s3d->textures = PATCH_ADDRESS(s3d, s3d->textures);
+
+        if (s3d->texture_datas == NULL) {
+                return;
+        }
+
+        s3d->texture_datas = PATCH_ADDRESS(s3d, s3d->texture_datas);
+
+        for (uint32_t i = 0; i < s3d->textures_count; i++) {
+                s3d_texture_t * const texture_data = &s3d->texture_datas[i];
+
+                texture_data->data = PATCH_ADDRESS(s3d, texture_data->data);
+
+                _texture_load(context, texture_data->texno,
+                    &s3d->textures[texture_data->texno], texture_data->data,
+                    texture_data->data_size);
+        }
+}
+
+static void
+_pictures_load(const s3d_t *s3d, s3d_context_t *context, const s3d_object_t *object)
+{
+        for (uint32_t i = 0; i < object->picture_count; i++) {
+                const PICTURE * const picture = &object->pictures[i];
+                const TEXTURE * const texture = &s3d->textures[picture->texno];
+
+                if ((context->textures_loaded & (1 << picture->texno)) != 0) {
+                        continue;
+                }
+
+                _texture_load(context, picture->texno, texture, picture->pcsrc,
+                    _picture_size_calculate(texture, picture->cmode));
+        }
+}
+
+static void
+_palettes_load(s3d_t *s3d, s3d_context_t *context)
+{
+        if ((s3d->palettes_count == 0) || (s3d->palette_datas == NULL)) {
+                return;
+        }
+
+        s3d->palette_datas = PATCH_ADDRESS(s3d, s3d->palette_datas);
+
+        for (uint32_t i = 0; i < s3d->palettes_count; i++) {
+                s3d_palette_t * const palette_data = &s3d->palette_datas[i];
+
+                palette_data->data = PATCH_ADDRESS(s3d, palette_data->data);
+
+                const uint16_t bank_256 = context->palette_bank + palette_data->bank;
+
+                scu_dma_transfer(0, (void *)VDP2_CRAM_MODE_0_OFFSET(bank_256, 0, 0),
+                    palette_data->data, palette_data->data_size);
+                scu_dma_transfer_wait(0);
+        }
+}
+
+static void
+_gouraud_tables_load(s3d_context_t *context, const s3d_object_t *object)
+{
+        if (object->gouraud_table_count == 0) {
+                return;
+        }
+
+        gst_set((vdp1_vram_t)&context->gouraud_tables[context->shading_slot]);
+        gst_put(object->gouraud_tables, object->gouraud_table_count);
+        gst_unset();
+
+        context->shading_slot += object->gouraud_table_count;
+}
+
+static void
+_texture_load(s3d_context_t *context, uint32_t slot, const TEXTURE *texture,
+    const void *data, uint32_t data_size)
+{
+        texture_t * const mic3d_texture = &context->textures[context->texture_slot + slot];
+
+        mic3d_texture->size       = TEXTURE_SIZE(texture->Hsize, texture->Vsize);
+        mic3d_texture->vram_index = TEXTURE_VRAM_INDEX(context->texture_base);
+
+        assert((context->texture_base + data_size) <= context->texture_end);
+
+        scu_dma_transfer(0, (void *)context->texture_base, data, data_size);
+        scu_dma_transfer_wait(0);
+
+        /* Texture addresses are in units of 8 bytes */
+        context->texture_base += (data_size + 7) & ~7;
+        context->textures_loaded |= 1 << slot;
+}
+
+static uint32_t
+_picture_size_calculate(const TEXTURE *texture, uint16_t cmode)
+{
+        const uint32_t pixel_count = texture->Hsize * texture->Vsize;
+
+        switch (cmode) {
+        case COL_16:
+                return pixel_count >> 1;
+        case COL_64:
+        case COL_128:
+        case COL_256:
+                return pixel_count;
+        case COL_32K:
+        default:
+                return pixel_count << 1;
+        }
 }
@@ -0,0 +1,74 @@
+#ifndef S3D_H
+#define S3D_H
+
+#include <mic3d.h>
+
+typedef struct s3d_context {
+        /* Texture list set with tlist_set() */
+        texture_t *textures;
+        uint32_t textures_count;
+        /* First free slot in the texture list. Advanced as textures are
+         * uploaded */
+        uint32_t texture_slot;
+        /* First free address in the VDP1 VRAM texture partition. Advanced as
+         * textures are uploaded */
+        vdp1_vram_t texture_base;
+        /* Textures must end before here */
+        vdp1_vram_t texture_end;
+        /* Bit n is set once texture n of the file being loaded is in VRAM.
+         * Objects that share a picture only upload it once */
+        uint32_t textures_loaded;
+
+        /* First free 256-color palette bank in VDP2 CRAM. Color bank numbers
+         * in the file are relative to it. Advanced once the file is loaded */
+        uint16_t palette_bank;
+
+        /* Gouraud shading tables set with gst_set() */
+        vdp1_gouraud_table_t *gouraud_tables;
+        /* First free shading slot. Advanced as gouraud tables are uploaded */
+        uint32_t shading_slot;
+} s3d_context_t;
+
+#define S3D_STREAM_SECTOR_SIZE (2048)
+
+typedef enum s3d_stream_state {
+        S3D_STREAM_STATE_HEADER,
+        S3D_STREAM_STATE_RESOURCES,
+        S3D_STREAM_STATE_OBJECTS,
+        S3D_STREAM_STATE_DONE
+} s3d_stream_state_t;
+
+typedef struct s3d_stream {
+        s3d_context_t *context;
+        mesh_t *meshes;
+        uint32_t meshes_count;
+        /* Must be large enough to hold the entire file */
+        uint8_t *buffer;
+        uint32_t fad;
+        uint32_t size;
+        uint32_t read_size;
+        s3d_stream_state_t state;
+        uint32_t object_count;
+        uint32_t objects_published;
+} s3d_stream_t;
+
+uint32_t s3d_object_count_get(const void *ptr);
+
+/* Loads every object in the S3D file into meshes, one mesh per object. The
+ * meshes point directly into the file buffer. The SGL polygon and attribute
+ * tables are converted in place, so no memory is allocated */
+void s3d_read(void *ptr, s3d_context_t *context, mesh_t *meshes);
+
+/* Streams an S3D file from CD. The file is read into buffer a few sectors at a
+ * time. Once the header and resources arrive, each object is loaded into its
+ * mesh as soon as all of its sectors are in. The file must fit in buffer_size
+ * bytes */
+void s3d_stream_init(s3d_stream_t *stream, void *buffer, uint32_t buffer_size, uint32_t fad, uint32_t size, s3d_context_t *context, mesh_t *meshes, uint32_t meshes_count);
+
+/* Reads at most sector_count sectors and returns the number of meshes that are
+ * ready to render. Call once per frame */
+uint32_t s3d_stream_update(s3d_stream_t *stream, uint32_t sector_count);
+
+bool s3d_stream_done(const s3d_stream_t *stream);
+
+#endif /* S3D_H */
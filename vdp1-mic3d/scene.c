@@ -0,0 +1,254 @@
+#include <string.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "lod.h"
+#include "scene.h"
+#include "scene_graph.h"
+
+#define TORUS_LOD_HYSTERESIS (FIX16(8.0))
+#define TORUS_DEPTH_NEAR     (FIX16(-60.0))
+#define TORUS_DEPTH_FAR      (FIX16(-400.0))
+
+static void _polygon_set(scene_polygon_t *polygon, const int16_vec2_t *vertices,
+    uint16_t color, fix16_t depth);
+
+void
+scene_init(scene_t *scene, const scene_config_t *config)
+{
+        scene->config = config;
+
+        cull_sphere_calculate(config->torus_meshes[0], &scene->torus_sphere);
+        cull_sphere_calculate(config->cube_mesh, &scene->cube_sphere);
+
+        for (uint32_t i = 0; i < SCENE_LETTER_COUNT; i++) {
+                cull_sphere_calculate(config->letter_meshes[i], &scene->letter_spheres[i]);
+        }
+
+        lod_group_init(&scene->torus_lod, &scene->torus_sphere, TORUS_LOD_HYSTERESIS);
+        lod_group_level_add(&scene->torus_lod, config->torus_meshes[0], FIX16(150.0));
+        lod_group_level_add(&scene->torus_lod, config->torus_meshes[1], FIX16(300.0));
+        lod_group_level_add(&scene->torus_lod, config->torus_meshes[2], FIX16(0.0));
+
+        scene_graph_t * const graph = &scene->graph;
+
+        scene_graph_init(graph);
+
+        fix16_mat43_t local;
+
+        fix16_mat33_identity(&local.rotation);
+
+        /* Move the torus back and forth to go through each level */
+        scene->torus_position.x = FIX16(   0.0);
+        scene->torus_position.y = FIX16(   0.0);
+        scene->torus_position.z = FIX16(-100.0);
+        scene->torus_depth_step = FIX16(-1.0);
+
+        local.translation = scene->torus_position;
+        scene->torus_node = scene_graph_node_add(graph, SCENE_NODE_NONE, &local);
+        scene_graph_node_lod_set(graph, scene->torus_node, &scene->torus_lod, DRAW_FLAGS_LIGHTING);
+
+        /* A row of cubes. Each cube spins in place, so the row itself only
+         * positions them */
+        local.translation.x = FIX16(  50.0);
+        local.translation.y = FIX16(   0.0);
+        local.translation.z = FIX16(-100.0);
+        const uint32_t cube_row_node = scene_graph_node_add(graph, SCENE_NODE_NONE, &local);
+
+        for (uint32_t i = 0; i < SCENE_CUBE_COUNT; i++) {
+                local.translation.x = fix16_int32_from(i * 25);
+                local.translation.y = FIX16(0.0);
+                local.translation.z = FIX16(0.0);
+
+                const uint32_t node = scene_graph_node_add(graph, cube_row_node, &local);
+                scene_graph_node_mesh_set(graph, node, config->cube_mesh, &scene->cube_sphere, DRAW_FLAGS_NONE);
+
+                if (i == 0) {
+                        scene->cube_nodes = node;
+                }
+        }
+
+        local.translation.x = FIX16(  0.0);
+        local.translation.y = FIX16( 10.0);
+        local.translation.z = FIX16(-40.0);
+        const uint32_t letters_node = scene_graph_node_add(graph, SCENE_NODE_NONE, &local);
+
+        const fix16_t letter_xs[SCENE_LETTER_COUNT] = {
+                FIX16( 10.0),
+                FIX16(  0.0),
+                FIX16(-10.0)
+        };
+
+        for (uint32_t i = 0; i < SCENE_LETTER_COUNT; i++) {
+                local.translation.x = letter_xs[i];
+                local.translation.y = FIX16(0.0);
+                local.translation.z = FIX16(0.0);
+
+                const uint32_t node = scene_graph_node_add(graph, letters_node, &local);
+                scene_graph_node_mesh_set(graph, node, config->letter_meshes[i],
+                    &scene->letter_spheres[i], DRAW_FLAGS_NONE);
+
+                if (i == 0) {
+                        scene->letter_nodes = node;
+                }
+        }
+
+        /* The rooms never move. Their nodes are added as they stream in, and
+         * their world transforms are only computed once */
+        local.translation.x = FIX16(   0.0);
+        local.translation.y = FIX16( -20.0);
+        local.translation.z = FIX16(-200.0);
+        scene->rooms_node = scene_graph_node_add(graph, SCENE_NODE_NONE, &local);
+        scene->room_node_count = 0;
+        scene->room_mesh_count = 0;
+
+        scene->theta = DEG2ANGLE(0.0);
+}
+
+void
+scene_build(scene_t *scene, draw_list_t *list)
+{
+        const scene_config_t * const config = scene->config;
+
+        scene_graph_t * const graph = &scene->graph;
+        const angle_t theta = scene->theta;
+
+        for (; scene->room_node_count < scene->room_mesh_count; scene->room_node_count++) {
+                fix16_mat43_t local;
+
+                fix16_mat33_identity(&local.rotation);
+                local.translation.x = FIX16(0.0);
+                local.translation.y = FIX16(0.0);
+                local.translation.z = FIX16(0.0);
+
+                const uint32_t node = scene_graph_node_add(graph, scene->rooms_node, &local);
+
+                scene_graph_node_mesh_set(graph, node,
+                    &config->room_meshes[scene->room_node_count],
+                    &config->room_spheres[scene->room_node_count], DRAW_FLAGS_NONE);
+        }
+
+        fix16_mat33_t rotation;
+        /* Must reset to identity matrix out since each XYZ rotation functions
+         * do not write to all the elements in the 3x3 matrix */
+        fix16_mat33_identity(&rotation);
+
+        /* Rotate around the origin first by Z, then Y, then X. Every spinning
+         * node shares the one rotation */
+        fix16_mat33_z_rotate(&rotation, theta, &rotation);
+        fix16_mat33_y_rotate(&rotation, theta, &rotation);
+        fix16_mat33_x_rotate(&rotation, theta, &rotation);
+
+        scene_graph_node_rotation_set(graph, scene->torus_node, &rotation);
+        scene_graph_node_translation_set(graph, scene->torus_node, &scene->torus_position);
+
+        for (uint32_t i = 0; i < SCENE_CUBE_COUNT; i++) {
+                scene_graph_node_rotation_set(graph, scene->cube_nodes + i, &rotation);
+        }
+
+        for (uint32_t i = 0; i < SCENE_LETTER_COUNT; i++) {
+                scene_graph_node_rotation_set(graph, scene->letter_nodes + i, &rotation);
+        }
+
+        scene_graph_update(graph);
+
+        draw_list_clear(list);
+
+        list->theta = theta;
+
+        scene_graph_draw_list_build(graph, list, config->frustum);
+
+        /* Rather than have the VDP1 run over into the next frame, drop what
+         * covers the least of the screen */
+        draw_list_budget(list, config->frustum, config->cost_model,
+            config->width, config->height, config->budget);
+
+        scene->theta += DEG2ANGLE(2.5);
+
+        scene->torus_position.z += scene->torus_depth_step;
+
+        if ((scene->torus_position.z <= TORUS_DEPTH_FAR) ||
+            (scene->torus_position.z >= TORUS_DEPTH_NEAR)) {
+                scene->torus_depth_step = -scene->torus_depth_step;
+        }
+}
+
+void
+scene_polygons_build(const draw_list_t *list, scene_polygon_t *polygons)
+{
+        /* Rotate a 2D quad */
+        const fix16_vec3_t points[] = {
+                FIX16_VEC3_INITIALIZER(-10.0, -10.0, 0),
+                FIX16_VEC3_INITIALIZER( 10.0, -10.0, 0),
+                FIX16_VEC3_INITIALIZER( 10.0,  10.0, 0),
+                FIX16_VEC3_INITIALIZER(-10.0,  10.0, 0)
+        };
+
+        /* Multiplying or dividing an angle requires a conditional sign
+         * extend, hence the need for angle_int32_to() */
+
+        /* Rotate the other way, and multiply the angle by 4 (shift by 2) */
+        const angle_t theta_mul_2 = angle_int32_to(-list->theta) << 2;
+
+        fix16_mat33_t rot_2d;
+        fix16_mat33_z_rotation_create(theta_mul_2, &rot_2d);
+
+        int16_vec2_t vertices[4];
+
+        for (uint32_t i = 0; i < 4; i++) {
+                fix16_vec3_t rot_p;
+                fix16_mat33_vec3_mul(&rot_2d, &points[i], &rot_p);
+
+                vertices[i].x = fix16_int32_to(rot_p.x);
+                vertices[i].y = fix16_int32_to(rot_p.y) + 20;
+        }
+
+        _polygon_set(&polygons[0], vertices, 0x8010, FIX16(-20.0));
+
+        const int16_vec2_t backdrop_vertices[4] = {
+                { .x = -50, .y = -50 },
+                { .x =  50, .y = -50 },
+                { .x =  50, .y =  50 },
+                { .x = -50, .y =  50 }
+        };
+
+        _polygon_set(&polygons[1], backdrop_vertices, 0xBDEF, FIX16(-150.0));
+
+        /* A floor, seen at an angle, that runs well off the bottom and sides
+         * of the screen. The clipper trims it every frame */
+        const int16_vec2_t floor_vertices[4] = {
+                { .x = -220, .y =  40 },
+                { .x =  220, .y =  40 },
+                { .x =  700, .y = 500 },
+                { .x = -700, .y = 500 }
+        };
+
+        _polygon_set(&polygons[2], floor_vertices, 0x9CE7, FIX16(-500.0));
+}
+
+static void
+_polygon_set(scene_polygon_t *polygon, const int16_vec2_t *vertices,
+    uint16_t color, fix16_t depth)
+{
+        vdp1_cmdt_t * const cmdt = &polygon->cmdt;
+
+        (void)memset(cmdt, 0x00, sizeof(vdp1_cmdt_t));
+
+        vdp1_cmdt_polygon_set(cmdt);
+
+        vdp1_cmdt_draw_mode_t draw_mode;
+        draw_mode.raw = 0x0000;
+        vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
+
+        for (uint32_t i = 0; i < 4; i++) {
+                cmdt->cmd_vertices[i] = vertices[i];
+        }
+
+        cmdt->cmd_colr = color;
+
+        polygon->depth = depth;
+}
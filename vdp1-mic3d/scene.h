@@ -0,0 +1,79 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "lod.h"
+#include "scene_graph.h"
+#include "vdp1_cost.h"
+
+#define SCENE_CUBE_COUNT   (4)
+#define SCENE_LETTER_COUNT (3)
+
+/* Polygons inserted directly each frame, back to front: the rotating quad,
+ * the backdrop, and the floor */
+#define SCENE_POLYGON_COUNT (3)
+
+typedef struct scene_config {
+        /* The torus levels, from the most to the least detailed */
+        const mesh_t *torus_meshes[3];
+        const mesh_t *cube_mesh;
+        /* M, I, and C, in that order */
+        const mesh_t *letter_meshes[SCENE_LETTER_COUNT];
+        /* Added to the graph as scene_t::room_mesh_count grows */
+        const mesh_t *room_meshes;
+        const cull_sphere_t *room_spheres;
+
+        const cull_frustum_t *frustum;
+        const vdp1_cost_model_t *cost_model;
+        uint16_t width;
+        uint16_t height;
+        /* In ticks. See draw_list_budget() */
+        uint32_t budget;
+} scene_config_t;
+
+/* Owned by whichever CPU builds the lists, except for room_mesh_count, which
+ * the CPU streaming the rooms sets before each build */
+typedef struct scene {
+        const scene_config_t *config;
+        scene_graph_t graph;
+
+        cull_sphere_t torus_sphere;
+        cull_sphere_t cube_sphere;
+        cull_sphere_t letter_spheres[SCENE_LETTER_COUNT];
+        lod_group_t torus_lod;
+
+        uint32_t torus_node;
+        /* First of SCENE_CUBE_COUNT consecutive nodes */
+        uint32_t cube_nodes;
+        /* First of SCENE_LETTER_COUNT consecutive nodes */
+        uint32_t letter_nodes;
+        uint32_t rooms_node;
+        uint32_t room_node_count;
+        fix16_vec3_t torus_position;
+        angle_t theta;
+        fix16_t torus_depth_step;
+
+        uint32_t room_mesh_count;
+} scene_t;
+
+typedef struct scene_polygon {
+        vdp1_cmdt_t cmdt;
+        fix16_t depth;
+} scene_polygon_t;
+
+/* Calculates the bounding spheres and the torus levels, and builds the graph.
+ * The config is kept, and has to outlive the scene */
+void scene_init(scene_t *scene, const scene_config_t *config);
+
+/* Adds the rooms streamed in since the last build, builds the list for the
+ * current frame, fits it to the budget, then advances the scene a frame */
+void scene_build(scene_t *scene, draw_list_t *list);
+
+/* Builds the SCENE_POLYGON_COUNT polygons for the frame list was built for.
+ * They aren't clipped */
+void scene_polygons_build(const draw_list_t *list, scene_polygon_t *polygons);
+
+#endif /* SCENE_H */
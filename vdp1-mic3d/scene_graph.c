@@ -0,0 +1,198 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "lod.h"
+#include "scene_graph.h"
+
+static void _world_calculate(const fix16_mat43_t *parent, const fix16_mat43_t *local,
+    fix16_mat43_t *world);
+static uint32_t _instances_count(const scene_graph_t *graph, uint32_t first);
+
+void
+scene_graph_init(scene_graph_t *graph)
+{
+        graph->count = 0;
+}
+
+uint32_t
+scene_graph_node_add(scene_graph_t *graph, uint32_t parent, const fix16_mat43_t *local)
+{
+        assert(graph->count < SCENE_GRAPH_NODE_COUNT_MAX);
+        assert((parent == SCENE_NODE_NONE) || (parent < graph->count));
+
+        const uint32_t index = graph->count;
+
+        scene_node_t * const node = &graph->nodes[index];
+
+        node->local = *local;
+        node->parent = parent;
+        node->flags = SCENE_NODE_FLAGS_DIRTY;
+        node->mesh = NULL;
+        node->sphere = NULL;
+        node->lod = NULL;
+        node->draw_flags = DRAW_FLAGS_NONE;
+
+        graph->count++;
+
+        return index;
+}
+
+void
+scene_graph_node_mesh_set(scene_graph_t *graph, uint32_t node,
+    const mesh_t *mesh, const cull_sphere_t *sphere, uint32_t draw_flags)
+{
+        assert(node < graph->count);
+
+        graph->nodes[node].mesh = mesh;
+        graph->nodes[node].sphere = sphere;
+        graph->nodes[node].lod = NULL;
+        graph->nodes[node].draw_flags = draw_flags;
+}
+
+void
+scene_graph_node_lod_set(scene_graph_t *graph, uint32_t node,
+    lod_group_t *lod, uint32_t draw_flags)
+{
+        assert(node < graph->count);
+
+        graph->nodes[node].mesh = NULL;
+        graph->nodes[node].sphere = NULL;
+        graph->nodes[node].lod = lod;
+        graph->nodes[node].draw_flags = draw_flags;
+}
+
+void
+scene_graph_node_rotation_set(scene_graph_t *graph, uint32_t node, const fix16_mat33_t *rotation)
+{
+        assert(node < graph->count);
+
+        graph->nodes[node].local.rotation = *rotation;
+        graph->nodes[node].flags |= SCENE_NODE_FLAGS_DIRTY;
+}
+
+void
+scene_graph_node_translation_set(scene_graph_t *graph, uint32_t node, const fix16_vec3_t *translation)
+{
+        assert(node < graph->count);
+
+        graph->nodes[node].local.translation = *translation;
+        graph->nodes[node].flags |= SCENE_NODE_FLAGS_DIRTY;
+}
+
+uint32_t
+scene_graph_update(scene_graph_t *graph)
+{
+        uint32_t update_count = 0;
+
+        /* Parents always come before their children, so by the time a node is
+         * reached, its parent's world transform is up to date */
+        for (uint32_t i = 0; i < graph->count; i++) {
+                scene_node_t * const node = &graph->nodes[i];
+
+                bool changed = ((node->flags & SCENE_NODE_FLAGS_DIRTY) != 0);
+
+                if (node->parent != SCENE_NODE_NONE) {
+                        changed |= ((graph->nodes[node->parent].flags & SCENE_NODE_FLAGS_CHANGED) != 0);
+                }
+
+                if (!changed) {
+                        node->flags &= ~SCENE_NODE_FLAGS_CHANGED;
+
+                        continue;
+                }
+
+                if (node->parent == SCENE_NODE_NONE) {
+                        graph->worlds[i] = node->local;
+                } else {
+                        _world_calculate(&graph->worlds[node->parent], &node->local,
+                            &graph->worlds[i]);
+                }
+
+                node->flags = SCENE_NODE_FLAGS_CHANGED;
+
+                update_count++;
+        }
+
+        return update_count;
+}
+
+uint32_t
+scene_graph_draw_list_build(const scene_graph_t *graph, draw_list_t *list,
+    const cull_frustum_t *frustum)
+{
+        uint32_t added_count = 0;
+
+        for (uint32_t i = 0; i < graph->count;) {
+                const scene_node_t * const node = &graph->nodes[i];
+
+                if (node->lod != NULL) {
+                        added_count += draw_list_lod_add(list, frustum, node->lod,
+                            &graph->worlds[i], node->draw_flags);
+
+                        i++;
+                } else if (node->mesh != NULL) {
+                        const uint32_t count = _instances_count(graph, i);
+
+                        added_count += draw_list_instances_add(list, frustum,
+                            node->mesh, node->sphere, &graph->worlds[i], count,
+                            node->draw_flags);
+
+                        i += count;
+                } else {
+                        i++;
+                }
+        }
+
+        return added_count;
+}
+
+static void
+_world_calculate(const fix16_mat43_t *parent, const fix16_mat43_t *local,
+    fix16_mat43_t *world)
+{
+        const fix16_mat33_t * const p = &parent->rotation;
+        const fix16_mat33_t * const l = &local->rotation;
+
+        for (uint32_t row = 0; row < 3; row++) {
+                for (uint32_t col = 0; col < 3; col++) {
+                        world->rotation.frow[row][col] =
+                            fix16_mul(p->frow[row][0], l->frow[0][col]) +
+                            fix16_mul(p->frow[row][1], l->frow[1][col]) +
+                            fix16_mul(p->frow[row][2], l->frow[2][col]);
+                }
+        }
+
+        fix16_mat33_vec3_mul(p, &local->translation, &world->translation);
+
+        world->translation.x += parent->translation.x;
+        world->translation.y += parent->translation.y;
+        world->translation.z += parent->translation.z;
+}
+
+/* Returns the number of consecutive nodes, starting at first, that draw the
+ * same mesh with the same sphere and flags */
+static uint32_t
+_instances_count(const scene_graph_t *graph, uint32_t first)
+{
+        const scene_node_t * const node = &graph->nodes[first];
+
+        uint32_t count = 1;
+
+        for (uint32_t i = first + 1; i < graph->count; i++, count++) {
+                const scene_node_t * const other = &graph->nodes[i];
+
+                if ((other->lod != NULL) ||
+                    (other->mesh != node->mesh) ||
+                    (other->sphere != node->sphere) ||
+                    (other->draw_flags != node->draw_flags)) {
+                        break;
+                }
+        }
+
+        return count;
+}
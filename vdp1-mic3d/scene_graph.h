@@ -0,0 +1,74 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "lod.h"
+
+#define SCENE_GRAPH_NODE_COUNT_MAX (32)
+
+#define SCENE_NODE_NONE (0xFFFF)
+
+#define SCENE_NODE_FLAGS_NONE    (0)
+/* The local transform changed since the last update */
+#define SCENE_NODE_FLAGS_DIRTY   (1 << 0)
+/* The world transform was recomputed in the last update */
+#define SCENE_NODE_FLAGS_CHANGED (1 << 1)
+
+typedef struct scene_node {
+        fix16_mat43_t local;
+        /* Index of the parent node, or SCENE_NODE_NONE */
+        uint16_t parent;
+        uint16_t flags;
+
+        /* What to draw. Group nodes have neither a mesh nor a LOD group */
+        const mesh_t *mesh;
+        const cull_sphere_t *sphere;
+        lod_group_t *lod;
+        uint32_t draw_flags;
+} scene_node_t;
+
+typedef struct scene_graph {
+        scene_node_t nodes[SCENE_GRAPH_NODE_COUNT_MAX];
+        /* Kept apart from the nodes so that the world transforms of sibling
+         * instances are contiguous, and can be passed as is to
+         * draw_list_instances_add() */
+        fix16_mat43_t worlds[SCENE_GRAPH_NODE_COUNT_MAX];
+        uint32_t count;
+} scene_graph_t;
+
+void scene_graph_init(scene_graph_t *graph);
+
+/* Adds a node and returns its index. Parents must be added before their
+ * children, which lets the graph be updated in a single pass over the nodes */
+uint32_t scene_graph_node_add(scene_graph_t *graph, uint32_t parent, const fix16_mat43_t *local);
+
+void scene_graph_node_mesh_set(scene_graph_t *graph, uint32_t node,
+    const mesh_t *mesh, const cull_sphere_t *sphere, uint32_t draw_flags);
+void scene_graph_node_lod_set(scene_graph_t *graph, uint32_t node,
+    lod_group_t *lod, uint32_t draw_flags);
+
+/* Each of these marks the node dirty */
+void scene_graph_node_rotation_set(scene_graph_t *graph, uint32_t node, const fix16_mat33_t *rotation);
+void scene_graph_node_translation_set(scene_graph_t *graph, uint32_t node, const fix16_vec3_t *translation);
+
+static inline __always_inline const fix16_mat43_t *
+scene_graph_node_world_get(const scene_graph_t *graph, uint32_t node)
+{
+        return &graph->worlds[node];
+}
+
+/* Recomputes the world transform of each dirty node and of everything below
+ * it. Nodes that haven't moved, along with their subtrees, are skipped.
+ * Returns the number of world transforms recomputed */
+uint32_t scene_graph_update(scene_graph_t *graph);
+
+/* Culls each drawable node against the frustum and adds it to the list.
+ * Consecutive nodes that draw the same mesh are added as one batch of
+ * instances. Returns the number of entries added */
+uint32_t scene_graph_draw_list_build(const scene_graph_t *graph, draw_list_t *list,
+    const cull_frustum_t *frustum);
+
+#endif /* SCENE_GRAPH_H */
@@ -0,0 +1,276 @@
+#include <assert.h>
+#include <string.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "texture_cache.h"
+
+/* VDP1 texture addresses are in units of 8 bytes */
+#define UNIT_SHIFT (3)
+
+/* The VDP1 may still be drawing with a texture used in the previous frame, so
+ * never evict a texture younger than this */
+#define EVICT_AGE_MIN (2)
+
+static bool _range_alloc(texture_cache_t *cache, uint16_t size, texture_cache_range_t *range);
+static void _range_free(texture_cache_t *cache, const texture_cache_range_t *range);
+static bool _lru_evict(texture_cache_t *cache);
+static void _range_retire(texture_cache_t *cache, const texture_cache_range_t *range,
+    uint32_t frame);
+static void _retired_reclaim(texture_cache_t *cache);
+
+void
+texture_cache_init(texture_cache_t *cache, texture_t *textures,
+    uint32_t textures_count, vdp1_vram_t base, uint32_t size)
+{
+        assert(textures_count <= TEXTURE_CACHE_ENTRY_COUNT_MAX);
+        assert((base & ((1 << UNIT_SHIFT) - 1)) == 0);
+        assert((size >> UNIT_SHIFT) <= 0xFFFF);
+
+        cache->textures = textures;
+        cache->textures_count = textures_count;
+        cache->base = base;
+
+        for (uint32_t i = 0; i < TEXTURE_CACHE_ENTRY_COUNT_MAX; i++) {
+                texture_cache_entry_t * const entry = &cache->entries[i];
+
+                entry->picture = NULL;
+                entry->ref_count = 0;
+                entry->resident = false;
+                entry->frame = 0;
+        }
+
+        cache->free_ranges[0].offset = 0;
+        cache->free_ranges[0].size = size >> UNIT_SHIFT;
+        cache->free_count = 1;
+
+        cache->retired_count = 0;
+
+        cache->frame = 0;
+}
+
+bool
+texture_cache_acquire(texture_cache_t *cache, uint32_t slot, const picture_t *picture)
+{
+        assert(slot < cache->textures_count);
+
+        texture_cache_entry_t * const entry = &cache->entries[slot];
+
+        /* A different picture in the same slot replaces the old one */
+        if (entry->resident && (entry->picture != picture)) {
+                assert(entry->ref_count == 0);
+
+                _range_retire(cache, &entry->range, entry->frame);
+
+                entry->resident = false;
+        }
+
+        entry->picture = picture;
+        entry->frame = cache->frame;
+
+        if (!entry->resident) {
+                const uint16_t size =
+                    (picture->data_size + (1 << UNIT_SHIFT) - 1) >> UNIT_SHIFT;
+
+                while (!(_range_alloc(cache, size, &entry->range))) {
+                        if (!(_lru_evict(cache))) {
+                                return false;
+                        }
+                }
+
+                entry->resident = true;
+
+                const vdp1_vram_t vram =
+                    cache->base + (entry->range.offset << UNIT_SHIFT);
+
+                texture_t * const texture = &cache->textures[slot];
+
+                texture->size       = TEXTURE_SIZE(picture->width, picture->height);
+                texture->vram_index = TEXTURE_VRAM_INDEX(vram);
+
+                vdp_dma_enqueue((void *)vram, picture->data, picture->data_size);
+        }
+
+        entry->ref_count++;
+
+        return true;
+}
+
+void
+texture_cache_release(texture_cache_t *cache, uint32_t slot)
+{
+        assert(slot < cache->textures_count);
+
+        texture_cache_entry_t * const entry = &cache->entries[slot];
+
+        assert(entry->ref_count > 0);
+
+        entry->ref_count--;
+}
+
+void
+texture_cache_touch(texture_cache_t *cache, uint32_t slot)
+{
+        assert(slot < cache->textures_count);
+
+        cache->entries[slot].frame = cache->frame;
+}
+
+void
+texture_cache_frame_end(texture_cache_t *cache)
+{
+        cache->frame++;
+
+        _retired_reclaim(cache);
+}
+
+static bool
+_range_alloc(texture_cache_t *cache, uint16_t size, texture_cache_range_t *range)
+{
+        /* First fit */
+        for (uint32_t i = 0; i < cache->free_count; i++) {
+                texture_cache_range_t * const free_range = &cache->free_ranges[i];
+
+                if (free_range->size < size) {
+                        continue;
+                }
+
+                range->offset = free_range->offset;
+                range->size = size;
+
+                free_range->offset += size;
+                free_range->size -= size;
+
+                if (free_range->size == 0) {
+                        cache->free_count--;
+
+                        memmove(&cache->free_ranges[i], &cache->free_ranges[i + 1],
+                            (cache->free_count - i) * sizeof(texture_cache_range_t));
+                }
+
+                return true;
+        }
+
+        return false;
+}
+
+static void
+_range_free(texture_cache_t *cache, const texture_cache_range_t *range)
+{
+        texture_cache_range_t * const free_ranges = cache->free_ranges;
+
+        uint32_t i;
+
+        for (i = 0; i < cache->free_count; i++) {
+                if (free_ranges[i].offset > range->offset) {
+                        break;
+                }
+        }
+
+        const bool merge_prev = (i > 0) &&
+            ((free_ranges[i - 1].offset + free_ranges[i - 1].size) == range->offset);
+        const bool merge_next = (i < cache->free_count) &&
+            ((range->offset + range->size) == free_ranges[i].offset);
+
+        if (merge_prev && merge_next) {
+                free_ranges[i - 1].size += range->size + free_ranges[i].size;
+
+                cache->free_count--;
+
+                memmove(&free_ranges[i], &free_ranges[i + 1],
+                    (cache->free_count - i) * sizeof(texture_cache_range_t));
+        } else if (merge_prev) {
+                free_ranges[i - 1].size += range->size;
+        } else if (merge_next) {
+                free_ranges[i].offset = range->offset;
+                free_ranges[i].size += range->size;
+        } else {
+                assert(cache->free_count < TEXTURE_CACHE_RANGE_COUNT_MAX);
+
+                memmove(&free_ranges[i + 1], &free_ranges[i],
+                    (cache->free_count - i) * sizeof(texture_cache_range_t));
+
+                free_ranges[i] = *range;
+
+                cache->free_count++;
+        }
+}
+
+static bool
+_lru_evict(texture_cache_t *cache)
+{
+        texture_cache_entry_t *lru_entry;
+        lru_entry = NULL;
+
+        for (uint32_t i = 0; i < cache->textures_count; i++) {
+                texture_cache_entry_t * const entry = &cache->entries[i];
+
+                if (!entry->resident || (entry->ref_count > 0)) {
+                        continue;
+                }
+
+                if ((cache->frame - entry->frame) < EVICT_AGE_MIN) {
+                        continue;
+                }
+
+                if ((lru_entry == NULL) || (entry->frame < lru_entry->frame)) {
+                        lru_entry = entry;
+                }
+        }
+
+        if (lru_entry == NULL) {
+                return false;
+        }
+
+        _range_free(cache, &lru_entry->range);
+
+        lru_entry->resident = false;
+
+        return true;
+}
+
+static void
+_range_retire(texture_cache_t *cache, const texture_cache_range_t *range,
+    uint32_t frame)
+{
+        /* Same as eviction. Old enough ranges are freed right away */
+        if ((cache->frame - frame) >= EVICT_AGE_MIN) {
+                _range_free(cache, range);
+
+                return;
+        }
+
+        assert(cache->retired_count < TEXTURE_CACHE_RANGE_COUNT_MAX);
+
+        texture_cache_retired_t * const retired = &cache->retired[cache->retired_count];
+
+        retired->range = *range;
+        retired->frame = frame;
+
+        cache->retired_count++;
+}
+
+static void
+_retired_reclaim(texture_cache_t *cache)
+{
+        uint32_t i;
+        i = 0;
+
+        while (i < cache->retired_count) {
+                texture_cache_retired_t * const retired = &cache->retired[i];
+
+                if ((cache->frame - retired->frame) < EVICT_AGE_MIN) {
+                        i++;
+
+                        continue;
+                }
+
+                _range_free(cache, &retired->range);
+
+                /* Order doesn't matter, so fill the hole with the last one */
+                cache->retired_count--;
+                cache->retired[i] = cache->retired[cache->retired_count];
+        }
+}
@@ -0,0 +1,74 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <mic3d.h>
+
+#define TEXTURE_CACHE_ENTRY_COUNT_MAX (32)
+#define TEXTURE_CACHE_RANGE_COUNT_MAX (TEXTURE_CACHE_ENTRY_COUNT_MAX + 1)
+
+typedef struct texture_cache_range {
+        /* In units of 8 bytes, relative to the start of the cache */
+        uint16_t offset;
+        uint16_t size;
+} texture_cache_range_t;
+
+/* A range that's no longer used, but that the VDP1 may still be drawing from */
+typedef struct texture_cache_retired {
+        texture_cache_range_t range;
+        /* Frame the range was last used in */
+        uint32_t frame;
+} texture_cache_retired_t;
+
+typedef struct texture_cache_entry {
+        const picture_t *picture;
+        texture_cache_range_t range;
+        uint16_t ref_count;
+        bool resident;
+        /* Frame the texture was last used in */
+        uint32_t frame;
+} texture_cache_entry_t;
+
+/* Manages a region of the VDP1 texture partition. Each entry maps to a slot in
+ * the mic3d texture list */
+typedef struct texture_cache {
+        texture_t *textures;
+        uint32_t textures_count;
+        vdp1_vram_t base;
+
+        texture_cache_entry_t entries[TEXTURE_CACHE_ENTRY_COUNT_MAX];
+
+        /* Free ranges, sorted by offset */
+        texture_cache_range_t free_ranges[TEXTURE_CACHE_RANGE_COUNT_MAX];
+        uint32_t free_count;
+
+        /* Freed once they're as old as an evicted texture would be */
+        texture_cache_retired_t retired[TEXTURE_CACHE_RANGE_COUNT_MAX];
+        uint32_t retired_count;
+
+        uint32_t frame;
+} texture_cache_t;
+
+void texture_cache_init(texture_cache_t *cache, texture_t *textures,
+    uint32_t textures_count, vdp1_vram_t base, uint32_t size);
+
+/* Takes a reference to the picture in slot. If it isn't resident, VRAM is
+ * allocated, evicting the least recently used unreferenced textures if needed,
+ * and the upload is queued. The VRAM of a different picture that was in slot
+ * is only reused once it's too old to still be drawn from. The slot's
+ * texture_t is updated to point to its new address.
+ *
+ * Queued uploads are transferred by SCU DMA during the next VBLANK, when
+ * vdp2_sync() is called. Returns false if there's no room, even after
+ * evicting */
+bool texture_cache_acquire(texture_cache_t *cache, uint32_t slot, const picture_t *picture);
+
+/* Drops a reference. The texture stays resident until it's evicted */
+void texture_cache_release(texture_cache_t *cache, uint32_t slot);
+
+/* Marks the texture in slot as used this frame */
+void texture_cache_touch(texture_cache_t *cache, uint32_t slot);
+
+/* Call once per frame. Frees the retired ranges that are old enough */
+void texture_cache_frame_end(texture_cache_t *cache);
+
+#endif /* TEXTURE_CACHE_H */
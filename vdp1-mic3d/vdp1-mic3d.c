@@ -9,18 +9,79 @@
 
 #include <yaul.h>
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <mic3d.h>
 
-extern const mesh_t mesh_m;
-extern const mesh_t mesh_i;
-extern const mesh_t mesh_c;
+#include "benchmark.h"
+#include "clip.h"
+#include "cull.h"
+#include "draw_list.h"
+#include "mesh_pack.h"
+#include "s3d.h"
+#include "scene.h"
+#include "texture_cache.h"
+#include "vdp1_cost.h"
+#include "xform.h"
+
+#define FILELIST_ENTRY_COUNT (16)
+
+#define SCREEN_WIDTH  (352)
+#define SCREEN_HEIGHT (224)
+
+/* Inserted polygons are trimmed to the screen once at least this many of their
+ * pixels are off screen. Polygons mic3d builds from meshes aren't clipped */
+#define CLIP_AREA_MIN (2048)
+
+/* A 60 Hz frame is about 59700 ticks. What's left over is for the polygons
+ * inserted directly, and for the estimate being off */
+#define VDP1_BUDGET_TICKS (50000)
+
+/* Number of frames between each line of stats */
+#define STATS_FRAME_COUNT (300)
+
+/* Shading slots 0 to 511 hold the grey ramp, followed by the tables mic3d
+ * fills in when lighting, then the tables of the polygons lit by xform */
+#define SHADING_RAMP_COUNT (512)
+#define SHADING_XFORM_SLOT (SHADING_RAMP_COUNT + CONFIG_MIC3D_CMDT_COUNT)
+
+/* Slots 0 to 2 in the texture list are managed by the texture cache. The rest
+ * belong to the rooms */
+#define CACHE_TEXTURE_COUNT (3)
+/* The rooms get the start of the texture partition, and the texture cache
+ * gets the rest */
+#define ROOM_TEXTURE_VRAM_SIZE (0x8000)
+
+#define ROOM_MESH_COUNT_MAX (8)
+/* Number of sectors to read each frame while the rooms stream in */
+#define ROOM_STREAM_SECTOR_COUNT (4)
+/* The rooms are streamed into LWRAM, all 1 MiB of it */
+#define ROOM_BUFFER_SIZE (0x00100000)
+
+/* Half the view plane width and height at a depth of 1.0. These need to match
+ * the projection mic3d uses */
+#define FRUSTUM_X_SLOPE (FIX16(1.0))
+#define FRUSTUM_Y_SLOPE (FIX16(0.7))
+#define FRUSTUM_NEAR    (FIX16(1.0))
+#define FRUSTUM_FAR     (FIX16(1024.0))
+
+/* Attributes expanded from the packed meshes */
+#define PACKED_ATTRIBUTE_COUNT (64)
+
+extern uint8_t asset_mesh_m[];
+extern uint8_t asset_mesh_i[];
+extern uint8_t asset_mesh_c[];
+extern uint8_t asset_gouraud_ramp[];
+
 extern const mesh_t mesh_cube;
 extern const mesh_t mesh_torus;
-extern const mesh_t mesh_torus2;
-extern const mesh_t mesh_torus3;
+extern mesh_t mesh_torus_lod1;
+extern mesh_t mesh_torus_lod2;
+
+extern void mesh_torus_lod_init(void);
 
 extern const picture_t picture_mika;
 extern const picture_t picture_tails;
@@ -30,11 +91,58 @@ extern const palette_t palette_baku;
 
 static texture_t _textures[8];
 
-static size_t _texture_load(texture_t *textures, uint32_t slot, const picture_t *picture, vdp1_vram_t texture_base);
+static mesh_t _mesh_m;
+static mesh_t _mesh_i;
+static mesh_t _mesh_c;
+static attribute_t _packed_attributes[PACKED_ATTRIBUTE_COUNT];
+static uint32_t _packed_attributes_count;
+
+static texture_cache_t _texture_cache;
+
+static mesh_t _room_meshes[ROOM_MESH_COUNT_MAX];
+static cull_sphere_t _room_spheres[ROOM_MESH_COUNT_MAX];
+static uint32_t _room_spheres_count;
+static s3d_context_t _room_context;
+static s3d_stream_t _room_stream;
+
+static cdfs_filelist_t _filelist;
+
+static cull_frustum_t _frustum;
+
+static clip_t _clip;
+
+static vdp1_cost_model_t _cost_model;
+
+static scene_config_t _scene_config;
+
+/* The slave's scratch pools. The master transforms with mic3d's */
+static xform_pools_t _xform_pools;
+/* Owned by the slave once it starts. The master only reads where the gouraud
+ * tables go */
+static xform_t _xform;
+
+/* Owned by the slave once it starts, except for room_mesh_count, which the
+ * master sets before each notify */
+static scene_t _scene;
+
+/* While the master renders one list, the slave builds the other. The slave
+ * also transforms the entries of each list from its split on into the
+ * matching xform list, which the master inserts before render_end() */
+static draw_list_t _draw_lists[2] __uncached;
+static xform_list_t _xform_lists[2] __uncached;
+static uint32_t _splits[2] __uncached;
+static volatile uint32_t _build_index __uncached;
+static volatile bool _build_done __uncached;
+
+static void _slave_entry(void);
+static void _frame_build(uint32_t index);
+
+static void _packed_mesh_load(void *ptr, mesh_t *mesh);
 static void _palette_load(uint16_t bank_256, uint16_t bank_16, const palette_t *palette);
+static const cdfs_filelist_entry_t *_file_find(const char *filename);
+static void _cmdt_polygon_insert(const vdp1_cmdt_t *cmdt, fix16_t depth);
 
 static vdp1_gouraud_table_t _pool_shading_tables[CONFIG_MIC3D_CMDT_COUNT] __aligned(16);
-static vdp1_gouraud_table_t _pool_shading_tables2[512] __aligned(16);
 
 static workarea_mic3d_depth_values_t _pool_depth_values;
 static workarea_mic3d_z_values_t _pool_z_values;
@@ -64,6 +172,13 @@ main(void)
 
         vdp1_vram_partitions_get(&vdp1_vram_partitions);
 
+        vdp1_cost_calibrate(&_cost_model, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+#ifdef BENCHMARK
+        benchmark_zsort_run();
+        benchmark_clip_run();
+#endif /* BENCHMARK */
+
         mic3d_init(&_workarea);
         render_sort_depth_set(_sort_list, 512);
 
@@ -71,20 +186,57 @@ main(void)
 
         light_gst_set(_pool_shading_tables,
             CONFIG_MIC3D_CMDT_COUNT,
-            (vdp1_vram_t)(vdp1_vram_partitions.gouraud_base + 512));
+            (vdp1_vram_t)(vdp1_vram_partitions.gouraud_base + SHADING_RAMP_COUNT));
 
-        vdp1_vram_t texture_base;
-        texture_base = (vdp1_vram_t)vdp1_vram_partitions.texture_base;
+        const vdp1_vram_t texture_base = (vdp1_vram_t)vdp1_vram_partitions.texture_base;
 
-        texture_base += _texture_load(_textures, 0, &picture_mika, texture_base);
-        texture_base += _texture_load(_textures, 1, &picture_tails, texture_base);
-        texture_base += _texture_load(_textures, 2, &picture_baku, texture_base);
+        texture_cache_init(&_texture_cache, _textures, CACHE_TEXTURE_COUNT,
+            texture_base + ROOM_TEXTURE_VRAM_SIZE,
+            vdp1_vram_partitions.texture_size - ROOM_TEXTURE_VRAM_SIZE);
+
+        texture_cache_acquire(&_texture_cache, 0, &picture_mika);
+        texture_cache_acquire(&_texture_cache, 1, &picture_tails);
+        texture_cache_acquire(&_texture_cache, 2, &picture_baku);
+
+        /* Transfer the queued uploads before the first frame */
+        vdp2_sync();
+        vdp2_sync_wait();
 
         /* This only works because by default, the CMD_COLR value is 0x0000,
          * which means it selects the first 256-color palette bank in VDP2
          * CRAM */
         _palette_load(0, 0, &palette_baku);
 
+        cdfs_config_default_set();
+
+        cdfs_filelist_entry_t * const filelist_entries =
+            cdfs_entries_alloc(FILELIST_ENTRY_COUNT);
+        assert(filelist_entries != NULL);
+
+        cdfs_filelist_init(&_filelist, filelist_entries, FILELIST_ENTRY_COUNT);
+        cdfs_filelist_root_read(&_filelist);
+
+        const cdfs_filelist_entry_t * const room_file = _file_find("ROOMS.S3D");
+        assert(room_file != NULL);
+
+        /* The rooms are loaded after the textures, palettes, and shading
+         * tables above */
+        _room_context.textures        = _textures;
+        _room_context.textures_count  = 8;
+        _room_context.texture_slot    = CACHE_TEXTURE_COUNT;
+        _room_context.texture_base    = texture_base;
+        _room_context.texture_end     = texture_base + ROOM_TEXTURE_VRAM_SIZE;
+        _room_context.textures_loaded = 0;
+        _room_context.palette_bank    = 1;
+        _room_context.gouraud_tables  = vdp1_vram_partitions.gouraud_base;
+        _room_context.shading_slot    = SHADING_XFORM_SLOT + XFORM_POLYGON_COUNT_MAX;
+
+        /* Stream the rooms in while rendering. Nothing is allocated, the
+         * meshes point into the buffer */
+        s3d_stream_init(&_room_stream, (void *)LWRAM(0), ROOM_BUFFER_SIZE,
+            room_file->starting_fad, room_file->size, &_room_context,
+            _room_meshes, ROOM_MESH_COUNT_MAX);
+
         camera_t camera;
 
         camera.position.x = FIX16( 0.0);
@@ -101,145 +253,134 @@ main(void)
 
         camera_lookat(&camera);
 
-        angle_t theta;
-        theta = DEG2ANGLE(0.0);
+        cull_frustum_set(&_frustum, &camera, FRUSTUM_X_SLOPE, FRUSTUM_Y_SLOPE,
+            FRUSTUM_NEAR, FRUSTUM_FAR);
+
+        xform_init(&_xform, &_xform_pools, &_frustum, _textures,
+            (vdp1_vram_t)vdp1_vram_partitions.gouraud_base, SHADING_XFORM_SLOT,
+            SCREEN_WIDTH, SCREEN_HEIGHT);
+
+        /* The origin is in the center of the screen */
+        clip_init(&_clip, -SCREEN_WIDTH / 2, -SCREEN_HEIGHT / 2,
+            (SCREEN_WIDTH / 2) - 1, (SCREEN_HEIGHT / 2) - 1, CLIP_AREA_MIN);
+
+        _packed_mesh_load(asset_mesh_m, &_mesh_m);
+        _packed_mesh_load(asset_mesh_i, &_mesh_i);
+        _packed_mesh_load(asset_mesh_c, &_mesh_c);
+
+        mesh_torus_lod_init();
+
+        _scene_config.torus_meshes[0] = &mesh_torus;
+        _scene_config.torus_meshes[1] = &mesh_torus_lod1;
+        _scene_config.torus_meshes[2] = &mesh_torus_lod2;
+        _scene_config.cube_mesh = &mesh_cube;
+        _scene_config.letter_meshes[0] = &_mesh_m;
+        _scene_config.letter_meshes[1] = &_mesh_i;
+        _scene_config.letter_meshes[2] = &_mesh_c;
+        _scene_config.room_meshes = _room_meshes;
+        _scene_config.room_spheres = _room_spheres;
+        _scene_config.frustum = &_frustum;
+        _scene_config.cost_model = &_cost_model;
+        _scene_config.width = SCREEN_WIDTH;
+        _scene_config.height = SCREEN_HEIGHT;
+        _scene_config.budget = VDP1_BUDGET_TICKS;
+
+        scene_init(&_scene, &_scene_config);
+
+        /* The grey ramp is built ahead of time by work/gouraud_tables.py, so
+         * it only needs to be uploaded */
+        gst_set((vdp1_vram_t)vdp1_vram_partitions.gouraud_base);
+        gst_put((const vdp1_gouraud_table_t *)asset_gouraud_ramp, SHADING_RAMP_COUNT);
+        gst_unset();
 
-        for (uint32_t i = 0; i < 512; i++) {
-                const rgb1555_t color = RGB1555(1,
-                                                fix16_int32_to(fix16_int32_from(i * 31) / 512U),
-                                                fix16_int32_to(fix16_int32_from(i * 31) / 512U),
-                                                fix16_int32_to(fix16_int32_from(i * 31) / 512U));
+        cpu_dual_comm_mode_set(CPU_DUAL_ENTRY_ICI);
+        cpu_dual_slave_set(_slave_entry);
 
-                _pool_shading_tables2[i].colors[0] = color;
-                _pool_shading_tables2[i].colors[1] = color;
-                _pool_shading_tables2[i].colors[2] = color;
-                _pool_shading_tables2[i].colors[3] = color;
-        }
+        /* Build the first list on the master, so that there's always one
+         * list ready to render */
+        _frame_build(0);
 
-        gst_set((vdp1_vram_t)vdp1_vram_partitions.gouraud_base);
-        gst_put(_pool_shading_tables2, 512);
-        gst_unset();
+        uint32_t render_index;
+        render_index = 0;
 
-        static fix16_mat43_t world[5];
+        uint32_t frame_count;
+        frame_count = 0;
 
-        fix16_mat33_identity(&world[0].rotation);
-        fix16_mat33_identity(&world[1].rotation);
-        fix16_mat33_identity(&world[2].rotation);
-        fix16_mat33_identity(&world[3].rotation);
-        fix16_mat33_identity(&world[4].rotation);
+        /* Frames where the draw list was over budget, and meshes were
+         * dropped */
+        uint32_t over_budget_count;
+        over_budget_count = 0;
 
-        world[0].translation.x = FIX16(   0.0);
-        world[0].translation.y = FIX16(   0.0);
-        world[0].translation.z = FIX16(-100.0);
+        while (true) {
+                const uint32_t room_mesh_count =
+                    s3d_stream_update(&_room_stream, ROOM_STREAM_SECTOR_COUNT);
 
-        world[1].translation.x = FIX16(  50.0);
-        world[1].translation.y = FIX16(   0.0);
-        world[1].translation.z = FIX16(-100.0);
+                for (; _room_spheres_count < room_mesh_count; _room_spheres_count++) {
+                        cull_sphere_calculate(&_room_meshes[_room_spheres_count],
+                            &_room_spheres[_room_spheres_count]);
+                }
 
-        world[2].translation.x = FIX16(  10.0);
-        world[2].translation.y = FIX16(  10.0);
-        world[2].translation.z = FIX16( -40.0);
+                /* Have the slave build and transform its half of the next
+                 * frame's list while the master transforms, lights, and
+                 * sorts its half of this frame's list */
+                _scene.room_mesh_count = room_mesh_count;
+                _build_index = render_index ^ 1;
+                _build_done = false;
 
-        world[3].translation.x = FIX16(   0.0);
-        world[3].translation.y = FIX16(  10.0);
-        world[3].translation.z = FIX16( -40.0);
+                cpu_dual_slave_notify();
 
-        world[4].translation.x = FIX16( -10.0);
-        world[4].translation.y = FIX16(  10.0);
-        world[4].translation.z = FIX16( -40.0);
+                const draw_list_t * const draw_list = &_draw_lists[render_index];
 
-        /* Set up a command table for insertion */
-        vdp1_cmdt_t cmdt_polygon;
-        vdp1_cmdt_polygon_set(&cmdt_polygon);
-        vdp1_cmdt_draw_mode_t polygon_draw_mode;
-        polygon_draw_mode.raw = 0x0000;
-        vdp1_cmdt_draw_mode_set(&cmdt_polygon, polygon_draw_mode);
+                if (draw_list->dropped_count != 0) {
+                        over_budget_count++;
+                }
 
-        while (true) {
                 /* Call this before rendering */
                 render_start();
 
-                fix16_mat43_t result;
-                /* Must reset to identity matrix out since each XYZ rotation
-                 * functions do not write to all the elements in the 3x3
-                 * matrix */
-                fix16_mat33_identity(&result.rotation);
-
-                render_enable(RENDER_FLAGS_LIGHTING);
-                /* Rotate around the origin first by Z, then Y, then X, ignoring translation */
-                fix16_mat33_z_rotate(&world[0].rotation, theta, &result.rotation);
-                fix16_mat33_y_rotate(&result.rotation, theta, &result.rotation);
-                fix16_mat33_x_rotate(&result.rotation, theta, &result.rotation);
-                /* Translate */
-                fix16_vec3_dup(&world[0].translation, &result.translation);
-                render_mesh_xform(&mesh_torus, &result);
-
-                render_disable(RENDER_FLAGS_LIGHTING);
-
-                /* Take the previous matrix and just modify the translation */
-                fix16_vec3_dup(&world[1].translation, &result.translation);
-                render_mesh_xform(&mesh_cube, &result);
-
-                /* Take the previous matrix and just modify the translation */
-                fix16_vec3_dup(&world[2].translation, &result.translation);
-                render_mesh_xform(&mesh_m, &result);
-                /* Take the previous matrix and just modify the translation */
-                fix16_vec3_dup(&world[3].translation, &result.translation);
-                render_mesh_xform(&mesh_i, &result);
-                /* Take the previous matrix and just modify the translation */
-                fix16_vec3_dup(&world[4].translation, &result.translation);
-                render_mesh_xform(&mesh_c, &result);
-
-                /* Rotate a 2D quad */
-                const fix16_vec3_t points[] = {
-                        FIX16_VEC3_INITIALIZER(-10.0, -10.0, 0),
-                        FIX16_VEC3_INITIALIZER( 10.0, -10.0, 0),
-                        FIX16_VEC3_INITIALIZER( 10.0,  10.0, 0),
-                        FIX16_VEC3_INITIALIZER(-10.0,  10.0, 0)
-                };
-
-                /* Multiplying or dividing an angle requires a conditional sign
-                 * extend, hence the need for angle_int32_to() */
-
-                /* Rotate the other way, and multiply the angle by 4 (shift by 2) */
-                const angle_t theta_mul_2 = angle_int32_to(-theta) << 2;
-
-                fix16_mat33_t rot_2d;
-                fix16_mat33_z_rotation_create(theta_mul_2, &rot_2d);
-
-                for (uint32_t i = 0; i < 4; i++) {
-                        fix16_vec3_t rot_p;
-                        fix16_mat33_vec3_mul(&rot_2d, &points[i], &rot_p);
-
-                        cmdt_polygon.cmd_vertices[i].x = fix16_int32_to(rot_p.x);
-                        cmdt_polygon.cmd_vertices[i].y = fix16_int32_to(rot_p.y) + 20;
+                draw_list_range_render(draw_list, 0, _splits[render_index]);
+
+                /* Merge in what the slave transformed */
+                xform_list_insert(&_xform, &_xform_lists[render_index]);
+
+                scene_polygon_t polygons[SCENE_POLYGON_COUNT];
+
+                scene_polygons_build(draw_list, polygons);
+
+                for (uint32_t i = 0; i < SCENE_POLYGON_COUNT; i++) {
+                        /* Call this before render_end() */
+                        _cmdt_polygon_insert(&polygons[i].cmdt, polygons[i].depth);
                 }
-                cmdt_polygon.cmd_colr = 0x8010;
-                /* Call this before render_end() */
-                render_cmdt_insert(&cmdt_polygon, FIX16(-20.0));
-
-                cmdt_polygon.cmd_vertices[0].x = -50;
-                cmdt_polygon.cmd_vertices[0].y = -50;
-                cmdt_polygon.cmd_vertices[1].x =  50;
-                cmdt_polygon.cmd_vertices[1].y = -50;
-                cmdt_polygon.cmd_vertices[2].x =  50;
-                cmdt_polygon.cmd_vertices[2].y =  50;
-                cmdt_polygon.cmd_vertices[3].x = -50;
-                cmdt_polygon.cmd_vertices[3].y =  50;
-                cmdt_polygon.cmd_colr          = 0xBDEF;
-                /* Call this before render_end() */
-                render_cmdt_insert(&cmdt_polygon, FIX16(-150.0));
-
-                theta += DEG2ANGLE(2.5);
 
                 /* End of rendering */
                 render_end();
 
+                /* The cube uses every cached texture */
+                for (uint32_t i = 0; i < CACHE_TEXTURE_COUNT; i++) {
+                        texture_cache_touch(&_texture_cache, i);
+                }
+
+                texture_cache_frame_end(&_texture_cache);
+
                 vdp1_sync_render();
                 vdp1_sync();
+                /* Transfers the queued texture uploads during VBLANK */
+                vdp2_sync();
                 vdp1_sync_wait();
 
+                frame_count++;
+
+                if ((frame_count % STATS_FRAME_COUNT) == 0) {
+                        dbgio_printf("frames: %lu, over vdp1 budget: %lu, last list: %lu ticks\n",
+                            frame_count, over_budget_count, draw_list->cost);
+                }
+
                 dbgio_flush();
+
+                while (!_build_done) {
+                }
+
+                render_index ^= 1;
         }
 }
 
@@ -254,6 +395,8 @@ user_init(void)
 
         vdp1_sync_interval_set(-1);
 
+        cd_block_init();
+
         vdp1_env_default_set();
 
         vdp2_sprite_priority_set(0, 6);
@@ -264,18 +407,46 @@ user_init(void)
         vdp2_sync_wait();
 }
 
-static size_t
-_texture_load(texture_t *textures, uint32_t slot, const picture_t *picture, vdp1_vram_t texture_base)
+static void
+_slave_entry(void)
+{
+        _frame_build(_build_index);
+
+        _build_done = true;
+}
+
+static void
+_frame_build(uint32_t index)
 {
-        texture_t * const texture = &textures[slot];
+        /* Drop any stale lines of the room meshes, their spheres, and the
+         * room count the master wrote while streaming */
+        cpu_cache_purge();
 
-        texture->size       = TEXTURE_SIZE(picture->width, picture->height);
-        texture->vram_index = TEXTURE_VRAM_INDEX(texture_base);
+        draw_list_t * const list = &_draw_lists[index];
+        xform_list_t * const xform_list = &_xform_lists[index];
 
-        scu_dma_transfer(0, (void *)texture_base, picture->data, picture->data_size);
-        scu_dma_transfer_wait(0);
+        scene_build(&_scene, list);
+
+        /* The entries before the split are left for mic3d on the master */
+        const uint32_t split = draw_list_split(list, XFORM_POINT_COUNT_MAX,
+            XFORM_POLYGON_COUNT_MAX);
+
+        xform_list_clear(xform_list);
+        xform_draw_list(&_xform, xform_list, list, split, list->count - split);
+
+        _splits[index] = split;
+}
+
+static void
+_packed_mesh_load(void *ptr, mesh_t *mesh)
+{
+        const uint32_t polygons_count = mesh_pack_polygons_count_get(ptr);
+
+        assert((_packed_attributes_count + polygons_count) <= PACKED_ATTRIBUTE_COUNT);
 
-        return picture->data_size;
+        mesh_pack_load(ptr, mesh, &_packed_attributes[_packed_attributes_count]);
+
+        _packed_attributes_count += polygons_count;
 }
 
 static void
@@ -284,3 +455,33 @@ _palette_load(uint16_t bank_256, uint16_t bank_16, const palette_t *palette)
         scu_dma_transfer(0, (void *)VDP2_CRAM_MODE_0_OFFSET(bank_256, bank_16, 0), palette->data, palette->data_size);
         scu_dma_transfer_wait(0);
 }
+
+static const cdfs_filelist_entry_t *
+_file_find(const char *filename)
+{
+        for (uint32_t i = 0; i < _filelist.entries_count; i++) {
+                const cdfs_filelist_entry_t * const file_entry = &_filelist.entries[i];
+
+                if (*file_entry->name == '\0') {
+                        continue;
+                }
+
+                if ((strcmp(file_entry->name, filename)) == 0) {
+                        return file_entry;
+                }
+        }
+
+        return NULL;
+}
+
+static void
+_cmdt_polygon_insert(const vdp1_cmdt_t *cmdt, fix16_t depth)
+{
+        vdp1_cmdt_t clipped_cmdts[CLIP_CMDT_COUNT_MAX];
+
+        const uint32_t count = clip_polygon(&_clip, cmdt, clipped_cmdts);
+
+        for (uint32_t i = 0; i < count; i++) {
+                render_cmdt_insert(&clipped_cmdts[i], depth);
+        }
+}
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+#
+# Generates a ramp of VDP1 gouraud shading tables, ready to be passed as is to
+# gst_put()
+#
+# Table i of count has all four corners set to (tint * i) / count, per
+# channel.
+#
+# Each table is four big endian RGB1555 colors (8 bytes).
+
+import os
+import struct
+import sys
+
+
+def ramp(count, tint):
+    tables = b""
+    for i in range(count):
+        r, g, b = [(i * channel) // count for channel in tint]
+        color = 0x8000 | (b << 10) | (g << 5) | r
+        tables += struct.pack(">4H", color, color, color, color)
+    return tables
+
+
+def main():
+    if len(sys.argv) != 6:
+        print("%s [count] [r] [g] [b] [output.gst]" % (os.path.basename(sys.argv[0])))
+        print("  r, g, and b are the color of the brightest table (0..31)")
+        sys.exit(2)
+
+    count = int(sys.argv[1], 0)
+    tint = [int(value, 0) for value in sys.argv[2:5]]
+
+    if count <= 0 or any(channel < 0 or channel > 31 for channel in tint):
+        print("%s: invalid count or tint" % (os.path.basename(sys.argv[0])))
+        sys.exit(2)
+
+    with open(sys.argv[5], "wb") as fp:
+        fp.write(ramp(count, tint))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,360 @@
+#!/usr/bin/env python3
+#
+# Packs a mesh into the compact binary format read by mesh_pack.c
+#
+# Input is either one of the C mesh sources (meshes/mesh_*.c) or an object in
+# an S3D file. Vertices (point and normal) and attributes are deduplicated,
+# polygons are reordered by the Morton code of their centers, and vertices are
+# renumbered in the order they're first used, so that neighbouring polygons
+# index neighbouring vertices.
+#
+# Format (big endian, every table 4-byte aligned):
+#
+#   Header (32 bytes)
+#     char     sig[4]            "MSH\0"
+#     uint16_t version           1
+#     uint16_t flags             bit 0: has normals, bit 1: has shading slots
+#     uint16_t points_count
+#     uint16_t polygons_count
+#     uint16_t attributes_count  unique attributes
+#     uint16_t (reserved)
+#     uint32_t points_offset     fix16_vec3_t[points_count]
+#     uint32_t normals_offset    fix16_vec3_t[points_count], or 0
+#     uint32_t polygons_offset   polygon records[polygons_count]
+#     uint32_t attributes_offset attribute records[attributes_count]
+#
+#   Polygon record (12 bytes)
+#     uint16_t flags             sort type (bits 0-1), plane type (bit 2),
+#                                use texture (bit 3)
+#     uint16_t attribute_index
+#     uint16_t indices[4]
+#
+#   Attribute record (8 bytes)
+#     uint16_t draw_mode
+#     uint8_t  command
+#     uint8_t  link_type
+#     uint16_t base_color
+#     uint16_t texture_slot
+#
+#   Shading slots (only if flag bit 1 is set), right after the polygons
+#     uint16_t shading_slots[polygons_count]
+
+import os
+import re
+import struct
+import sys
+
+SIG = b"MSH\0"
+VERSION = 1
+
+FLAG_NORMALS = 1 << 0
+FLAG_SHADING_SLOTS = 1 << 1
+
+# Same values as SGL, which the S3D loader relies on too
+SORT_TYPES = {
+    "SORT_TYPE_BFR": 0,
+    "SORT_TYPE_MIN": 1,
+    "SORT_TYPE_MAX": 2,
+    "SORT_TYPE_CENTER": 3,
+}
+
+PLANE_TYPES = {
+    "PLANE_TYPE_SINGLE": 0,
+    "PLANE_TYPE_DOUBLE": 1,
+}
+
+# VDP1 command codes
+COMMAND_TYPES = {
+    "COMMAND_TYPE_SPRITE": 0,
+    "COMMAND_TYPE_SCALED_SPRITE": 1,
+    "COMMAND_TYPE_DISTORTED_SPRITE": 2,
+    "COMMAND_TYPE_POLYGON": 4,
+    "COMMAND_TYPE_POLYLINE": 5,
+    "COMMAND_TYPE_LINE": 6,
+}
+
+# VDP1 jump modes
+LINK_TYPES = {
+    "LINK_TYPE_JUMP_NEXT": 0,
+    "LINK_TYPE_JUMP_ASSIGN": 1,
+    "LINK_TYPE_JUMP_CALL": 2,
+    "LINK_TYPE_JUMP_RETURN": 3,
+}
+
+
+class Mesh:
+    def __init__(self):
+        self.points = []      # (x, y, z) in Q16.16
+        self.normals = None   # Same length as points, or None
+        self.polygons = []    # (sort_type, plane_type, use_texture, (p0, p1, p2, p3))
+        self.attributes = []  # (draw_mode, command, link_type, base_color, texture_slot, shading_slot)
+
+
+def fix16(value):
+    return int(round(float(value) * 65536.0)) & 0xFFFFFFFF
+
+
+def strip_comments(source):
+    source = re.sub(r"/\*.*?\*/", "", source, flags=re.DOTALL)
+    source = re.sub(r"//[^\n]*", "", source)
+    return source
+
+
+def parse_c(filename, mesh_name):
+    with open(filename, "r") as fp:
+        source = strip_comments(fp.read())
+
+    colors = {}
+    for name, a, r, g, b in re.findall(
+            r"#define\s+(\w+)\s+RGB1555\(\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)\s*\)", source):
+        colors[name] = (int(a) << 15) | (int(b) << 10) | (int(g) << 5) | int(r)
+
+    # Some meshes redefine INDICES(a, b, c, d) to reorder the indices
+    index_order = (0, 1, 2, 3)
+    redefined = re.search(r"#define\s+INDICES\(a,\s*b,\s*c,\s*d\)(.*?)(?:\n\s*\n|\n(?=[^\s\\]))", source, flags=re.DOTALL)
+    if redefined:
+        order = re.findall(r"\.indices\.p\d\s*=\s*([abcd])", redefined.group(1))
+        index_order = tuple("abcd".index(letter) for letter in order)
+
+    arrays = {}
+    for array_type, name, body in re.findall(
+            r"static\s+const\s+(\w+)\s+(\w+)\s*\[\s*\d*\s*\]\s*=\s*\{(.*?)\n\};", source, flags=re.DOTALL):
+        arrays[name] = (array_type, body)
+
+    meshes = {}
+    for name, body in re.findall(r"const\s+mesh_t\s+(\w+)\s*=\s*\{(.*?)\};", source, flags=re.DOTALL):
+        meshes[name] = dict(re.findall(r"\.(\w+)\s*=\s*([^,\n]+)", body))
+
+    if mesh_name not in meshes:
+        raise SystemExit("%s: no mesh named %s (found: %s)" % (filename, mesh_name, ", ".join(sorted(meshes))))
+
+    fields = meshes[mesh_name]
+
+    def vec3s(array_name):
+        return [tuple(fix16(v) for v in triple) for triple in re.findall(
+            r"FIX16_VEC3_INITIALIZER\(\s*([-\d.]+)\s*,\s*([-\d.]+)\s*,\s*([-\d.]+)\s*\)",
+            arrays[array_name][1])]
+
+    mesh = Mesh()
+    mesh.points = vec3s(fields["points"].strip())
+
+    if "normals" in fields:
+        mesh.normals = vec3s(fields["normals"].strip())
+
+    for sort_type, plane_type, use_texture, indices in re.findall(
+            r"FLAGS\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\)\s*,\s*INDICES\(([^)]*)\)",
+            arrays[fields["polygons"].strip()][1]):
+        abcd = [int(index) for index in indices.split(",")]
+        mesh.polygons.append((SORT_TYPES[sort_type], PLANE_TYPES[plane_type],
+                              1 if use_texture == "true" else 0,
+                              tuple(abcd[i] for i in index_order)))
+
+    for body in re.findall(r"\{([^{}]*)\}", arrays[fields["attributes"].strip()][1]):
+        attribute = dict((key, value.strip()) for key, value in re.findall(r"\.([\w.]+)\s*=\s*([^,]+)", body))
+
+        for key in attribute:
+            if key not in ("draw_mode.raw", "control.command", "control.link_type",
+                           "palette_data.base_color", "texture_slot", "shading_slot"):
+                raise SystemExit("%s: unsupported attribute field .%s" % (filename, key))
+
+        base_color = attribute.get("palette_data.base_color", "0")
+        base_color = colors[base_color] if base_color in colors else int(base_color, 0)
+
+        mesh.attributes.append((
+            int(attribute.get("draw_mode.raw", "0"), 0),
+            COMMAND_TYPES[attribute.get("control.command", "COMMAND_TYPE_POLYGON")],
+            LINK_TYPES[attribute.get("control.link_type", "LINK_TYPE_JUMP_ASSIGN")],
+            base_color,
+            int(attribute.get("texture_slot", "0"), 0),
+            int(attribute.get("shading_slot", "0"), 0)))
+
+    return mesh
+
+
+def parse_s3d(filename, object_index):
+    with open(filename, "rb") as fp:
+        data = fp.read()
+
+    if data[0:3] != b"S3D":
+        raise SystemExit("%s: not an S3D file" % (filename))
+
+    object_count, = struct.unpack_from(">I", data, 12)
+
+    if object_index >= object_count:
+        raise SystemExit("%s: only %i objects" % (filename, object_count))
+
+    # Header is 44 bytes, each object 40 bytes
+    pntbl, nb_point, pltbl, nb_polygon, attbl, vntbl = struct.unpack_from(
+        ">6I", data, 44 + (object_index * 40))
+
+    mesh = Mesh()
+    mesh.points = [struct.unpack_from(">3I", data, pntbl + (i * 12)) for i in range(nb_point)]
+
+    # Only use the normals if there's one per vertex
+    if (vntbl + (nb_point * 12)) <= len(data) and vntbl != 0:
+        mesh.normals = [struct.unpack_from(">3I", data, vntbl + (i * 12)) for i in range(nb_point)]
+
+    for i in range(nb_polygon):
+        indices = struct.unpack_from(">4H", data, pltbl + (i * 20) + 12)
+
+        flag, sort, texno, atrb, colno, gstb, direction = struct.unpack_from(
+            ">BBHHHHH", data, attbl + (i * 12))
+
+        mesh.polygons.append((sort & 3, flag, (sort >> 2) & 1, indices))
+        mesh.attributes.append((atrb, direction & 0xF, LINK_TYPES["LINK_TYPE_JUMP_ASSIGN"],
+                                colno, texno, gstb))
+
+    return mesh
+
+
+def morton3(x, y, z):
+    def spread(v):
+        v &= 0x3FF
+        v = (v | (v << 16)) & 0x030000FF
+        v = (v | (v << 8)) & 0x0300F00F
+        v = (v | (v << 4)) & 0x030C30C3
+        v = (v | (v << 2)) & 0x09249249
+        return v
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2)
+
+
+def signed32(value):
+    return value - 0x100000000 if value & 0x80000000 else value
+
+
+def optimize(mesh):
+    # Deduplicate vertices, keyed by point and normal
+    vertex_map = {}
+    vertex_remap = []
+    vertices = []
+    for i, point in enumerate(mesh.points):
+        key = (point, mesh.normals[i] if mesh.normals else None)
+        if key not in vertex_map:
+            vertex_map[key] = len(vertices)
+            vertices.append(key)
+        vertex_remap.append(vertex_map[key])
+
+    polygons = [(sort_type, plane_type, use_texture, tuple(vertex_remap[index] for index in indices))
+                for sort_type, plane_type, use_texture, indices in mesh.polygons]
+
+    # Reorder polygons by the Morton code of their centers
+    points = [tuple(signed32(v) for v in vertex[0]) for vertex in vertices]
+    lows = [min(point[axis] for point in points) for axis in range(3)]
+    highs = [max(point[axis] for point in points) for axis in range(3)]
+
+    def key(polygon_index):
+        indices = polygons[polygon_index][3]
+        center = [sum(points[index][axis] for index in indices) / 4.0 for axis in range(3)]
+        grid = [int(1023 * (center[axis] - lows[axis]) / max(1, highs[axis] - lows[axis])) for axis in range(3)]
+        return morton3(*grid)
+
+    order = sorted(range(len(polygons)), key=key)
+
+    # Renumber vertices in the order they're first used. Unused vertices are
+    # dropped
+    renumber = {}
+    for polygon_index in order:
+        for index in polygons[polygon_index][3]:
+            if index not in renumber:
+                renumber[index] = len(renumber)
+
+    packed = Mesh()
+    packed_vertices = [None] * len(renumber)
+    for old_index, new_index in renumber.items():
+        packed_vertices[new_index] = vertices[old_index]
+
+    packed.points = [vertex[0] for vertex in packed_vertices]
+    if mesh.normals:
+        packed.normals = [vertex[1] for vertex in packed_vertices]
+
+    for polygon_index in order:
+        sort_type, plane_type, use_texture, indices = polygons[polygon_index]
+        packed.polygons.append((sort_type, plane_type, use_texture, tuple(renumber[index] for index in indices)))
+        packed.attributes.append(mesh.attributes[polygon_index])
+
+    return packed
+
+
+def align4(data):
+    return data + (b"\0" * (-len(data) % 4))
+
+
+def write(mesh, filename):
+    # Split the shading slot out of the attributes, since it's usually unique
+    # per polygon, and deduplicate the rest
+    attribute_map = {}
+    attributes = []
+    attribute_indices = []
+    shading_slots = []
+    for attribute in mesh.attributes:
+        key = attribute[0:5]
+        if key not in attribute_map:
+            attribute_map[key] = len(attributes)
+            attributes.append(key)
+        attribute_indices.append(attribute_map[key])
+        shading_slots.append(attribute[5])
+
+    flags = 0
+    if mesh.normals:
+        flags |= FLAG_NORMALS
+    if any(shading_slots):
+        flags |= FLAG_SHADING_SLOTS
+
+    header_size = 32
+    points = b"".join(struct.pack(">3I", *point) for point in mesh.points)
+    normals = b"".join(struct.pack(">3I", *normal) for normal in mesh.normals) if mesh.normals else b""
+
+    polygons = b""
+    for i, (sort_type, plane_type, use_texture, indices) in enumerate(mesh.polygons):
+        polygon_flags = sort_type | (plane_type << 2) | (use_texture << 3)
+        polygons += struct.pack(">HH4H", polygon_flags, attribute_indices[i], *indices)
+    if flags & FLAG_SHADING_SLOTS:
+        polygons += b"".join(struct.pack(">H", slot) for slot in shading_slots)
+    polygons = align4(polygons)
+
+    attribute_data = align4(b"".join(struct.pack(">HBBHH", *attribute) for attribute in attributes))
+
+    points_offset = header_size
+    normals_offset = (points_offset + len(points)) if normals else 0
+    polygons_offset = points_offset + len(points) + len(normals)
+    attributes_offset = polygons_offset + len(polygons)
+
+    header = struct.pack(">4sHHHHHHIIII", SIG, VERSION, flags,
+                         len(mesh.points), len(mesh.polygons), len(attributes), 0,
+                         points_offset, normals_offset, polygons_offset, attributes_offset)
+
+    assert len(header) == header_size
+
+    with open(filename, "wb") as fp:
+        fp.write(header + points + normals + polygons + attribute_data)
+
+    return header_size + len(points) + len(normals) + len(polygons) + len(attribute_data), len(attributes)
+
+
+def main():
+    if len(sys.argv) != 4:
+        print("%s [input.c] [mesh_name] [output.msh]" % (os.path.basename(sys.argv[0])))
+        print("%s [input.s3d] [object_index] [output.msh]" % (os.path.basename(sys.argv[0])))
+        sys.exit(2)
+
+    input_filename = sys.argv[1]
+    output_filename = sys.argv[3]
+
+    if input_filename.lower().endswith(".s3d"):
+        mesh = parse_s3d(input_filename, int(sys.argv[2]))
+    else:
+        mesh = parse_c(input_filename, sys.argv[2])
+
+    if len(mesh.polygons) != len(mesh.attributes):
+        raise SystemExit("%s: %i polygons, but %i attributes" % (input_filename, len(mesh.polygons), len(mesh.attributes)))
+
+    packed = optimize(mesh)
+    size, attributes_count = write(packed, output_filename)
+
+    print("%s: %i -> %i points, %i polygons, %i -> %i attributes, %i bytes" % (
+        output_filename, len(mesh.points), len(packed.points), len(packed.polygons),
+        len(mesh.attributes), attributes_count, size))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,423 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+#include "xform.h"
+
+/* Polygons with a vertex past this many pixels from the center are dropped,
+ * so that the coordinates always fit in VDP1's 13-bit range */
+#define GUARD_BAND (2048)
+
+/* Same light as the host reference renderer. Roughly unit length */
+#define LIGHT_X (FIX16(-0.4))
+#define LIGHT_Y (FIX16( 0.6))
+#define LIGHT_Z (FIX16( 0.7))
+
+static void _mesh_begin(xform_t *xform, const mesh_t *mesh);
+static uint32_t _instance_add(xform_t *xform, xform_list_t *list,
+    const fix16_mat43_t *world);
+static void _points_transform(xform_t *xform, const fix16_mat43_t *world);
+static uint32_t _polygons_emit(xform_t *xform, xform_list_t *list);
+static fix16_t _polygon_depth_calculate(const polygon_t *polygon,
+    const fix16_t *depths, fix16_t previous_depth);
+static fix16_t _dot(const fix16_vec3_t *a, const fix16_vec3_t *b);
+
+void
+xform_init(xform_t *xform, xform_pools_t *pools, const cull_frustum_t *frustum,
+    const texture_t *textures, vdp1_vram_t gouraud_base, uint16_t gouraud_slot,
+    uint16_t width, uint16_t height)
+{
+        xform->pools = pools;
+        xform->frustum = frustum;
+        xform->textures = textures;
+        xform->gouraud_base = gouraud_base;
+        xform->gouraud_slot = gouraud_slot;
+
+        /* A slope of x_slope spans half the screen width */
+        cpu_divu_fix16_set(fix16_int32_from(width / 2), frustum->x_slope);
+        xform->focal = cpu_divu_quotient_get();
+
+        xform->hwidth = width / 2;
+        xform->hheight = height / 2;
+
+        xform->light.x = LIGHT_X;
+        xform->light.y = LIGHT_Y;
+        xform->light.z = LIGHT_Z;
+
+        xform->mesh = NULL;
+        xform->flags = DRAW_FLAGS_NONE;
+}
+
+void
+xform_list_clear(xform_list_t *list)
+{
+        list->count = 0;
+        list->gouraud_count = 0;
+}
+
+uint32_t
+xform_instances(xform_t *xform, xform_list_t *list, const mesh_t *mesh,
+    const fix16_mat43_t *xforms, uint32_t count, uint32_t flags)
+{
+        _mesh_begin(xform, mesh);
+
+        xform->flags = flags;
+
+        uint32_t added_count;
+        added_count = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                added_count += _instance_add(xform, list, &xforms[i]);
+        }
+
+        return added_count;
+}
+
+uint32_t
+xform_draw_list(xform_t *xform, xform_list_t *list, const draw_list_t *draw_list,
+    uint32_t first, uint32_t count)
+{
+        assert((first + count) <= draw_list->count);
+
+        /* The texture list may have changed since the last call */
+        xform->mesh = NULL;
+
+        uint32_t added_count;
+        added_count = 0;
+
+        for (uint32_t i = first; i < (first + count); i++) {
+                const draw_entry_t * const entry = &draw_list->entries[i];
+
+                if (entry->mesh != xform->mesh) {
+                        _mesh_begin(xform, entry->mesh);
+                }
+
+                xform->flags = entry->flags;
+
+                added_count += _instance_add(xform, list, &entry->xform);
+        }
+
+        return added_count;
+}
+
+void
+xform_list_insert(const xform_t *xform, const xform_list_t *list)
+{
+        if (list->gouraud_count > 0) {
+                gst_set(xform->gouraud_base +
+                    (xform->gouraud_slot * sizeof(vdp1_gouraud_table_t)));
+                gst_put(list->gouraud_tables, list->gouraud_count);
+                gst_unset();
+        }
+
+        for (uint32_t i = 0; i < list->count; i++) {
+                render_cmdt_insert(&list->cmdts[i], list->depths[i]);
+        }
+}
+
+/* Everything about a polygon that doesn't change from instance to instance is
+ * worked out here */
+static void
+_mesh_begin(xform_t *xform, const mesh_t *mesh)
+{
+        assert(mesh->points_count <= XFORM_POINT_COUNT_MAX);
+        assert(mesh->polygons_count <= XFORM_POLYGON_COUNT_MAX);
+
+        xform->mesh = mesh;
+
+        /* CMDGRDA is in units of 8 bytes. The upper bits of the address
+         * don't fit, and drop out */
+        const uint16_t grda_base = xform->gouraud_base >> 3;
+
+        for (uint32_t i = 0; i < mesh->polygons_count; i++) {
+                const attribute_t * const attribute = &mesh->attributes[i];
+                xform_template_t * const template = &xform->pools->templates[i];
+
+                /* Inserted command tables are linked by mic3d, like the
+                 * polygons built in scene.c, so the link type is left out */
+                template->cmd_ctrl = attribute->control.command;
+                template->cmd_pmod = attribute->draw_mode.raw;
+                template->cmd_colr = attribute->palette_data.base_color.raw;
+                template->cmd_srca = 0x0000;
+                template->cmd_size = 0x0000;
+                template->cmd_grda = grda_base + attribute->shading_slot;
+
+                if (attribute->control.command != COMMAND_TYPE_POLYGON) {
+                        const texture_t * const texture =
+                            &xform->textures[attribute->texture_slot];
+
+                        template->cmd_srca = texture->vram_index;
+                        template->cmd_size = texture->size;
+                }
+        }
+}
+
+static uint32_t
+_instance_add(xform_t *xform, xform_list_t *list, const fix16_mat43_t *world)
+{
+        _points_transform(xform, world);
+
+        return _polygons_emit(xform, list);
+}
+
+/* Projects each point. Lit meshes also get a shade per point from their
+ * normals */
+static void
+_points_transform(xform_t *xform, const fix16_mat43_t *world)
+{
+        const cull_frustum_t * const frustum = xform->frustum;
+        const mesh_t * const mesh = xform->mesh;
+        xform_pools_t * const pools = xform->pools;
+
+        /* Same basis as the host reference renderer. X is mirrored, as screen
+         * Y points down */
+        const fix16_vec3_t axes[3] = {
+                { -frustum->right.x, -frustum->right.y, -frustum->right.z },
+                frustum->up,
+                frustum->forward
+        };
+
+        fix16_vec3_t translation;
+        translation.x = world->translation.x - frustum->position.x;
+        translation.y = world->translation.y - frustum->position.y;
+        translation.z = world->translation.z - frustum->position.z;
+
+        /* Fold the view into the world matrix, so that each point takes a
+         * single matrix multiply */
+        fix16_vec3_t rows[3];
+        fix16_t offsets[3];
+
+        for (uint32_t k = 0; k < 3; k++) {
+                rows[k].x = fix16_mul(axes[k].x, world->rotation.frow[0][0]) +
+                            fix16_mul(axes[k].y, world->rotation.frow[1][0]) +
+                            fix16_mul(axes[k].z, world->rotation.frow[2][0]);
+                rows[k].y = fix16_mul(axes[k].x, world->rotation.frow[0][1]) +
+                            fix16_mul(axes[k].y, world->rotation.frow[1][1]) +
+                            fix16_mul(axes[k].z, world->rotation.frow[2][1]);
+                rows[k].z = fix16_mul(axes[k].x, world->rotation.frow[0][2]) +
+                            fix16_mul(axes[k].y, world->rotation.frow[1][2]) +
+                            fix16_mul(axes[k].z, world->rotation.frow[2][2]);
+
+                offsets[k] = _dot(&axes[k], &translation);
+        }
+
+        const bool lighting =
+            ((xform->flags & DRAW_FLAGS_LIGHTING) != 0) && (mesh->normals != NULL);
+
+        /* The light in model space, so that the normals don't need to be
+         * rotated */
+        fix16_vec3_t light;
+
+        if (lighting) {
+                light.x = fix16_mul(world->rotation.frow[0][0], xform->light.x) +
+                          fix16_mul(world->rotation.frow[1][0], xform->light.y) +
+                          fix16_mul(world->rotation.frow[2][0], xform->light.z);
+                light.y = fix16_mul(world->rotation.frow[0][1], xform->light.x) +
+                          fix16_mul(world->rotation.frow[1][1], xform->light.y) +
+                          fix16_mul(world->rotation.frow[2][1], xform->light.z);
+                light.z = fix16_mul(world->rotation.frow[0][2], xform->light.x) +
+                          fix16_mul(world->rotation.frow[1][2], xform->light.y) +
+                          fix16_mul(world->rotation.frow[2][2], xform->light.z);
+        }
+
+        for (uint32_t i = 0; i < mesh->points_count; i++) {
+                const fix16_vec3_t * const point = &mesh->points[i];
+
+                const fix16_t x = _dot(&rows[0], point) + offsets[0];
+                const fix16_t y = _dot(&rows[1], point) + offsets[1];
+                const fix16_t depth = _dot(&rows[2], point) + offsets[2];
+
+                pools->depths[i] = depth;
+
+                int16_vec2_t * const screen_point = &pools->screen_points[i];
+
+                if (depth < frustum->near) {
+                        screen_point->x = 0;
+                        screen_point->y = 0;
+
+                        continue;
+                }
+
+                /* The divider runs while the point is lit */
+                cpu_divu_fix16_set(xform->focal, depth);
+
+                if (lighting) {
+                        const fix16_t intensity =
+                            min(max(_dot(&mesh->normals[i], &light), 0), FIX16(1.0));
+
+                        pools->shades[i] = 4 + ((intensity * 27) >> 16);
+                }
+
+                const fix16_t scale = cpu_divu_quotient_get();
+
+                const int32_t screen_x = ((int64_t)x * scale) >> 32;
+                const int32_t screen_y = ((int64_t)y * scale) >> 32;
+
+                screen_point->x = min(max(screen_x, -GUARD_BAND), GUARD_BAND);
+                screen_point->y = min(max(screen_y, -GUARD_BAND), GUARD_BAND);
+        }
+}
+
+/* Drops polygons that cross the near plane, fall outside the guard band or
+ * the screen, or face away. The rest are added to the list */
+static uint32_t
+_polygons_emit(xform_t *xform, xform_list_t *list)
+{
+        const cull_frustum_t * const frustum = xform->frustum;
+        const mesh_t * const mesh = xform->mesh;
+        const xform_pools_t * const pools = xform->pools;
+
+        const bool lighting =
+            ((xform->flags & DRAW_FLAGS_LIGHTING) != 0) && (mesh->normals != NULL);
+
+        const uint16_t grda_base =
+            (xform->gouraud_base >> 3) + xform->gouraud_slot;
+
+        uint32_t added_count;
+        added_count = 0;
+
+        fix16_t previous_depth;
+        previous_depth = 0;
+
+        for (uint32_t i = 0; i < mesh->polygons_count; i++) {
+                const polygon_t * const polygon = &mesh->polygons[i];
+
+                const uint16_t indices[4] = {
+                        polygon->indices.p0,
+                        polygon->indices.p1,
+                        polygon->indices.p2,
+                        polygon->indices.p3
+                };
+
+                const int16_vec2_t * const p[4] = {
+                        &pools->screen_points[indices[0]],
+                        &pools->screen_points[indices[1]],
+                        &pools->screen_points[indices[2]],
+                        &pools->screen_points[indices[3]]
+                };
+
+                uint32_t outcode_and;
+                outcode_and = 0x0F;
+
+                bool rejected;
+                rejected = false;
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        if ((pools->depths[indices[j]] < frustum->near) ||
+                            (abs(p[j]->x) >= GUARD_BAND) ||
+                            (abs(p[j]->y) >= GUARD_BAND)) {
+                                rejected = true;
+                                break;
+                        }
+
+                        uint32_t outcode;
+                        outcode = 0;
+
+                        outcode |= (p[j]->x < -xform->hwidth) ? 0x01 : 0;
+                        outcode |= (p[j]->x >= xform->hwidth) ? 0x02 : 0;
+                        outcode |= (p[j]->y < -xform->hheight) ? 0x04 : 0;
+                        outcode |= (p[j]->y >= xform->hheight) ? 0x08 : 0;
+
+                        outcode_and &= outcode;
+                }
+
+                if (rejected || (outcode_and != 0)) {
+                        continue;
+                }
+
+                if (polygon->flags.plane_type == PLANE_TYPE_SINGLE) {
+                        const int32_t cross =
+                            ((p[1]->x - p[0]->x) * (p[2]->y - p[0]->y)) -
+                            ((p[1]->y - p[0]->y) * (p[2]->x - p[0]->x));
+
+                        if (cross >= 0) {
+                                continue;
+                        }
+                }
+
+                const fix16_t depth =
+                    _polygon_depth_calculate(polygon, pools->depths, previous_depth);
+
+                previous_depth = depth;
+
+                assert(list->count < XFORM_POLYGON_COUNT_MAX);
+
+                const xform_template_t * const template = &pools->templates[i];
+                vdp1_cmdt_t * const cmdt = &list->cmdts[list->count];
+
+                cmdt->cmd_ctrl = template->cmd_ctrl;
+                cmdt->cmd_link = 0x0000;
+                cmdt->cmd_pmod = template->cmd_pmod;
+                cmdt->cmd_colr = template->cmd_colr;
+                cmdt->cmd_srca = template->cmd_srca;
+                cmdt->cmd_size = template->cmd_size;
+                cmdt->cmd_grda = template->cmd_grda;
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        cmdt->cmd_vertices[j] = *p[j];
+                }
+
+                if (lighting) {
+                        assert(list->gouraud_count < XFORM_POLYGON_COUNT_MAX);
+
+                        vdp1_gouraud_table_t * const table =
+                            &list->gouraud_tables[list->gouraud_count];
+
+                        for (uint32_t j = 0; j < 4; j++) {
+                                const uint8_t shade = pools->shades[indices[j]];
+
+                                table->colors[j] = RGB1555(1, shade, shade, shade);
+                        }
+
+                        cmdt->cmd_grda = grda_base + list->gouraud_count;
+
+                        list->gouraud_count++;
+                }
+
+                /* Negative in front of the camera */
+                list->depths[list->count] = -depth;
+                list->count++;
+
+                added_count++;
+        }
+
+        return added_count;
+}
+
+static fix16_t
+_polygon_depth_calculate(const polygon_t *polygon, const fix16_t *depths,
+    fix16_t previous_depth)
+{
+        const fix16_t d0 = depths[polygon->indices.p0];
+        const fix16_t d1 = depths[polygon->indices.p1];
+        const fix16_t d2 = depths[polygon->indices.p2];
+        const fix16_t d3 = depths[polygon->indices.p3];
+
+        switch (polygon->flags.sort_type) {
+        case SORT_TYPE_MIN:
+                return min(min(d0, d1), min(d2, d3));
+        case SORT_TYPE_MAX:
+                return max(max(d0, d1), max(d2, d3));
+        case SORT_TYPE_BFR:
+                /* Drawn right before the previous polygon */
+                return previous_depth + 1;
+        case SORT_TYPE_CENTER:
+        default:
+                return (d0 + d1 + d2 + d3) >> 2;
+        }
+}
+
+static fix16_t
+_dot(const fix16_vec3_t *a, const fix16_vec3_t *b)
+{
+        const int64_t dot = ((int64_t)a->x * b->x) +
+                            ((int64_t)a->y * b->y) +
+                            ((int64_t)a->z * b->z);
+
+        return (fix16_t)(dot >> 16);
+}
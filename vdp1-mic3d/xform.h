@@ -0,0 +1,93 @@
+#ifndef XFORM_H
+#define XFORM_H
+
+#include <mic3d.h>
+
+#include "cull.h"
+#include "draw_list.h"
+
+/* Largest mesh a pool can transform */
+#define XFORM_POINT_COUNT_MAX   (1024)
+#define XFORM_POLYGON_COUNT_MAX (1024)
+
+/* What's left of an attribute once it's decoded. Copied into each command
+ * table the polygon is drawn with */
+typedef struct xform_template {
+        uint16_t cmd_ctrl;
+        uint16_t cmd_pmod;
+        uint16_t cmd_colr;
+        uint16_t cmd_srca;
+        uint16_t cmd_size;
+        uint16_t cmd_grda;
+} xform_template_t;
+
+/* Scratch space. Each CPU that transforms needs its own */
+typedef struct xform_pools {
+        int16_vec2_t screen_points[XFORM_POINT_COUNT_MAX];
+        /* View space depth, positive in front of the camera */
+        fix16_t depths[XFORM_POINT_COUNT_MAX];
+        /* Gouraud value (0..31) from lighting */
+        uint8_t shades[XFORM_POINT_COUNT_MAX];
+        xform_template_t templates[XFORM_POLYGON_COUNT_MAX];
+} xform_pools_t;
+
+/* Projected polygons, handed to render_cmdt_insert() by xform_list_insert().
+ * Lit polygons each get a gouraud table */
+typedef struct xform_list {
+        vdp1_cmdt_t cmdts[XFORM_POLYGON_COUNT_MAX];
+        /* View space Z, like render_cmdt_insert() takes */
+        fix16_t depths[XFORM_POLYGON_COUNT_MAX];
+        uint32_t count;
+
+        vdp1_gouraud_table_t gouraud_tables[XFORM_POLYGON_COUNT_MAX];
+        uint32_t gouraud_count;
+} xform_list_t;
+
+typedef struct xform {
+        xform_pools_t *pools;
+        const cull_frustum_t *frustum;
+        const texture_t *textures;
+        /* Start of the gouraud table partition. Shading slots count from
+         * here */
+        vdp1_vram_t gouraud_base;
+        /* Where xform_list_insert() puts the gouraud tables of lit
+         * polygons */
+        uint16_t gouraud_slot;
+        /* Pixels per unit of the view plane at a depth of 1.0 */
+        fix16_t focal;
+        int16_t hwidth;
+        int16_t hheight;
+        /* In world space, towards the light */
+        fix16_vec3_t light;
+
+        /* The mesh the templates were decoded from */
+        const mesh_t *mesh;
+        uint32_t flags;
+} xform_t;
+
+/* The projection follows from the frustum's x_slope and the screen width, and
+ * so matches mic3d's */
+void xform_init(xform_t *xform, xform_pools_t *pools,
+    const cull_frustum_t *frustum, const texture_t *textures,
+    vdp1_vram_t gouraud_base, uint16_t gouraud_slot, uint16_t width,
+    uint16_t height);
+
+void xform_list_clear(xform_list_t *list);
+
+/* Decodes the attributes of mesh and binds its textures once, then streams
+ * the points of each instance through the transform. Polygons that face away,
+ * cross the near plane, or are off screen are dropped. Returns the number of
+ * polygons added to list */
+uint32_t xform_instances(xform_t *xform, xform_list_t *list, const mesh_t *mesh,
+    const fix16_mat43_t *xforms, uint32_t count, uint32_t flags);
+
+/* Same as above, for count entries of a draw list, starting from first. Runs
+ * of entries that share a mesh are decoded once */
+uint32_t xform_draw_list(xform_t *xform, xform_list_t *list,
+    const draw_list_t *draw_list, uint32_t first, uint32_t count);
+
+/* Uploads the gouraud tables and inserts each polygon. Call between
+ * render_start() and render_end(), on the CPU that owns mic3d */
+void xform_list_insert(const xform_t *xform, const xform_list_t *list);
+
+#endif /* XFORM_H */
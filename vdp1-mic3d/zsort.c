@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <yaul.h>
+
+#include "zsort.h"
+
+static void _pass(const uint32_t *src, uint32_t *dst, uint32_t count, uint32_t shift);
+
+void
+zsort_init(zsort_t *zsort, uint32_t capacity)
+{
+        /* Indices are 16-bit */
+        assert(capacity <= 65536);
+
+        zsort->entries = malloc(sizeof(uint32_t) * capacity);
+        assert(zsort->entries != NULL);
+
+        zsort->scratch = malloc(sizeof(uint32_t) * capacity);
+        assert(zsort->scratch != NULL);
+
+        zsort->capacity = capacity;
+        zsort->count = 0;
+}
+
+void
+zsort_deinit(zsort_t *zsort)
+{
+        free(zsort->entries);
+        free(zsort->scratch);
+
+        zsort->entries = NULL;
+        zsort->scratch = NULL;
+        zsort->capacity = 0;
+        zsort->count = 0;
+}
+
+const uint32_t *
+zsort_sort(zsort_t *zsort)
+{
+        /* Least significant byte of the depth first, then the most. The
+         * second pass is stable, so the result is ordered by the full 16-bit
+         * depth, and ends back in entries */
+        _pass(zsort->entries, zsort->scratch, zsort->count, 16);
+        _pass(zsort->scratch, zsort->entries, zsort->count, 24);
+
+        return zsort->entries;
+}
+
+static void
+_pass(const uint32_t *src, uint32_t *dst, uint32_t count, uint32_t shift)
+{
+        uint32_t offsets[256];
+
+        for (uint32_t i = 0; i < 256; i++) {
+                offsets[i] = 0;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                offsets[(src[i] >> shift) & 0xFF]++;
+        }
+
+        /* Farthest first. Prefix sum from the largest depth down */
+        uint32_t offset = 0;
+
+        for (int32_t i = 255; i >= 0; i--) {
+                const uint32_t bucket_count = offsets[i];
+
+                offsets[i] = offset;
+                offset += bucket_count;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                const uint32_t entry = src[i];
+
+                dst[offsets[(entry >> shift) & 0xFF]++] = entry;
+        }
+}
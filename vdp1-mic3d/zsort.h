@@ -0,0 +1,47 @@
+#ifndef ZSORT_H
+#define ZSORT_H
+
+#include <assert.h>
+
+#include <yaul.h>
+
+/* Not used by the renderer. mic3d keeps its own sort list, which can only be
+ * sized with render_sort_depth_set(), not swapped out from here. Only built
+ * with BENCHMARK=1, to compare against */
+
+/* Each entry packs the quantized depth in the upper 16 bits, and the index of
+ * the primitive in the lower 16 bits */
+#define ZSORT_ENTRY_DEPTH(entry) ((uint16_t)((entry) >> 16))
+#define ZSORT_ENTRY_INDEX(entry) ((uint16_t)((entry) & 0xFFFF))
+
+typedef struct zsort {
+        uint32_t *entries;
+        uint32_t *scratch;
+        uint32_t capacity;
+        uint32_t count;
+} zsort_t;
+
+/* Allocates room for capacity primitives */
+void zsort_init(zsort_t *zsort, uint32_t capacity);
+void zsort_deinit(zsort_t *zsort);
+
+static inline void __always_inline
+zsort_clear(zsort_t *zsort)
+{
+        zsort->count = 0;
+}
+
+static inline void __always_inline
+zsort_add(zsort_t *zsort, uint16_t depth, uint16_t index)
+{
+        assert(zsort->count < zsort->capacity);
+
+        zsort->entries[zsort->count] = ((uint32_t)depth << 16) | index;
+        zsort->count++;
+}
+
+/* Sorts from back to front in two 8-bit radix passes, and returns the sorted
+ * entries. The work is proportional to the number of entries */
+const uint32_t *zsort_sort(zsort_t *zsort);
+
+#endif /* ZSORT_H */
@@ -0,0 +1,220 @@
+#include <yaul.h>
+
+#include <gamemath/defs.h>
+
+#include "benchmark.h"
+#include "blend.h"
+#include "fb_transfer.h"
+#include "perf.h"
+
+/* FRT ticks in one 59.94 Hz frame, with the CPU at 26.8741 MHz (320 wide
+ * NTSC) and the FRT divided by 8 */
+#define FRAME_TICKS (56044)
+
+#define ITERATION_COUNT (8)
+
+#define TRANSFER_SIZE_MAX (128)
+
+/* Blends row y of the flare into fb */
+typedef void (*blend_row_t)(volatile uint16_t *fb, int32_t y);
+
+extern const int16_vec2_t flare_texture_dim;
+extern const uint16_t flare_texture[];
+extern const uint16_t flare_span_rows[];
+extern const blend_span_t flare_spans[];
+
+static void _row_scalar_blend(volatile uint16_t *fb, int32_t y);
+static void _row_swar_blend(volatile uint16_t *fb, int32_t y);
+static void _row_spans_blend(volatile uint16_t *fb, int32_t y);
+
+static uint32_t _blend_ticks(blend_row_t blend_row, int16_t flare_x);
+
+static uint32_t _halfword_transfer_ticks(uint16_t *buffer, uint32_t size);
+static uint32_t _word_transfer_ticks(uint16_t *buffer, uint32_t size);
+static uint32_t _dmac_transfer_ticks(uint16_t *buffer, uint32_t size);
+
+static uint16_t _transfer_buffer[TRANSFER_SIZE_MAX * TRANSFER_SIZE_MAX] __aligned(4);
+
+void
+benchmark_blend_run(void)
+{
+        static const struct {
+                const char *name;
+                blend_row_t blend_row;
+        } kernels[] = {
+                { "scalar", _row_scalar_blend },
+                { "swar",   _row_swar_blend   },
+                { "spans",  _row_spans_blend  }
+        };
+
+        const uint32_t pixel_count =
+            flare_texture_dim.x * flare_texture_dim.y * ITERATION_COUNT;
+
+        perf_init();
+
+        dbgio_printf("blend benchmark (pixels per frame)\n");
+
+        for (uint32_t i = 0; i < (sizeof(kernels) / sizeof(*kernels)); i++) {
+                for (int16_t flare_x = 0; flare_x < 2; flare_x++) {
+                        const uint32_t ticks =
+                            _blend_ticks(kernels[i].blend_row, flare_x);
+
+                        dbgio_printf("%6s, x=%i: %7lu ticks, %6lu pixels\n",
+                            kernels[i].name, flare_x, ticks,
+                            (pixel_count * FRAME_TICKS) / max(ticks, 1UL));
+                }
+        }
+}
+
+void
+benchmark_fb_transfer_run(void)
+{
+        static const uint32_t sizes[] = {
+                16, 32, 64, TRANSFER_SIZE_MAX
+        };
+
+        perf_init();
+
+        dbgio_printf("framebuffer read and write back (ticks)\n");
+
+        for (uint32_t i = 0; i < (sizeof(sizes) / sizeof(*sizes)); i++) {
+                const uint32_t size = sizes[i];
+
+                const uint32_t halfword_ticks =
+                    _halfword_transfer_ticks(_transfer_buffer, size);
+                const uint32_t word_ticks =
+                    _word_transfer_ticks(_transfer_buffer, size);
+                const uint32_t dmac_ticks =
+                    _dmac_transfer_ticks(_transfer_buffer, size);
+
+                dbgio_printf("%3lux%-3lu: 16-bit %6lu, 32-bit %6lu, dmac %6lu\n",
+                    size, size, halfword_ticks, word_ticks, dmac_ticks);
+        }
+}
+
+static void
+_row_scalar_blend(volatile uint16_t *fb, int32_t y)
+{
+        blend_add_row_scalar(fb, &flare_texture[y * flare_texture_dim.x],
+            flare_texture_dim.x);
+}
+
+static void
+_row_swar_blend(volatile uint16_t *fb, int32_t y)
+{
+        blend_add_row(fb, &flare_texture[y * flare_texture_dim.x],
+            flare_texture_dim.x);
+}
+
+static void
+_row_spans_blend(volatile uint16_t *fb, int32_t y)
+{
+        const uint32_t span_index = flare_span_rows[y];
+
+        blend_add_spans(fb, &flare_texture[y * flare_texture_dim.x],
+            &flare_spans[span_index], flare_span_rows[y + 1] - span_index);
+}
+
+static uint32_t
+_blend_ticks(blend_row_t blend_row, int16_t flare_x)
+{
+        /* Start each run from the same grey */
+        for (int32_t y = 0; y < flare_texture_dim.y; y++) {
+                volatile uint16_t *fb = (volatile uint16_t *)VDP1_FB(y * 512 * sizeof(uint16_t));
+
+                for (int32_t x = 0; x < (flare_texture_dim.x + 1); x++) {
+                        fb[x] = 0xBDEF;
+                }
+        }
+
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                for (uint32_t i = 0; i < ITERATION_COUNT; i++) {
+                        for (int32_t y = 0; y < flare_texture_dim.y; y++) {
+                                volatile uint16_t * const fb = (volatile uint16_t *)
+                                    VDP1_FB(((y * 512) + flare_x) * sizeof(uint16_t));
+
+                                blend_row(fb, y);
+                        }
+                }
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
+
+static uint32_t
+_halfword_transfer_ticks(uint16_t *buffer, uint32_t size)
+{
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                for (uint32_t y = 0; y < size; y++) {
+                        volatile uint16_t * const fb = (volatile uint16_t *)
+                            VDP1_FB(y * FB_TRANSFER_FB_WIDTH * sizeof(uint16_t));
+
+                        for (uint32_t x = 0; x < size; x++) {
+                                buffer[(y * size) + x] = fb[x];
+                        }
+                }
+
+                for (uint32_t y = 0; y < size; y++) {
+                        volatile uint16_t * const fb = (volatile uint16_t *)
+                            VDP1_FB(y * FB_TRANSFER_FB_WIDTH * sizeof(uint16_t));
+
+                        for (uint32_t x = 0; x < size; x++) {
+                                fb[x] = buffer[(y * size) + x];
+                        }
+                }
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
+
+static uint32_t
+_word_transfer_ticks(uint16_t *buffer, uint32_t size)
+{
+        uint32_t * const buffer_pair = (uint32_t *)buffer;
+        const uint32_t pair_count = size / 2;
+
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                for (uint32_t y = 0; y < size; y++) {
+                        volatile uint32_t * const fb = (volatile uint32_t *)
+                            VDP1_FB(y * FB_TRANSFER_FB_WIDTH * sizeof(uint16_t));
+
+                        for (uint32_t x = 0; x < pair_count; x++) {
+                                buffer_pair[(y * pair_count) + x] = fb[x];
+                        }
+                }
+
+                for (uint32_t y = 0; y < size; y++) {
+                        volatile uint32_t * const fb = (volatile uint32_t *)
+                            VDP1_FB(y * FB_TRANSFER_FB_WIDTH * sizeof(uint16_t));
+
+                        for (uint32_t x = 0; x < pair_count; x++) {
+                                fb[x] = buffer_pair[(y * pair_count) + x];
+                        }
+                }
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
+
+static uint32_t
+_dmac_transfer_ticks(uint16_t *buffer, uint32_t size)
+{
+        perf_counter_t perf;
+        perf_counter_init(&perf);
+
+        perf_counter_start(&perf); {
+                fb_transfer_read(buffer, size, 0, 0, size, size);
+                fb_transfer_write(buffer, size, 0, 0, size, size);
+        } perf_counter_end(&perf);
+
+        return perf.ticks;
+}
@@ -0,0 +1,18 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* Blends the flare texture into the VDP1 back framebuffer with the scalar, the
+ * SWAR, and the span kernels, at an even and an odd X, and prints how many
+ * texture pixels each can blend per frame with dbgio.
+ *
+ * Must be called while the VDP1 is idle */
+void benchmark_blend_run(void);
+
+/* Reads a framebuffer rectangle into work RAM and writes it back, with 16-bit
+ * and 32-bit volatile accesses and with the CPU-DMAC, at several sizes. Ticks
+ * are printed with dbgio.
+ *
+ * Must be called while the VDP1 is idle */
+void benchmark_fb_transfer_run(void);
+
+#endif /* BENCHMARK_H */
@@ -0,0 +1,273 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include "blend.h"
+
+/* Low 4 bits of each 5-bit channel, for both pixels */
+#define LOW_MASK (0x3DEF3DEF)
+/* Top bit of each 5-bit channel */
+#define TOP_MASK (0x42104210)
+#define MSB_MASK (0x80008000)
+/* Every bit but the lowest of each channel */
+#define HALF_MASK (0x7BDE7BDE)
+/* Red and blue, with a guard bit above each to absorb borrows */
+#define RB_MASK   (0x7C1F7C1F)
+#define RB_GUARD  (0x80208020)
+/* Green, with its guard bit */
+#define G_MASK    (0x03E003E0)
+#define G_GUARD   (0x04000400)
+
+typedef uint32_t (*blend_pair_t)(uint32_t dst, uint32_t src);
+
+static inline uint32_t _add2(uint32_t fb, uint32_t src) __always_inline;
+static inline uint32_t _lane_mask(uint32_t pair) __always_inline;
+static inline uint32_t _select2(uint32_t dst, uint32_t src, uint32_t blended) __always_inline;
+
+static uint32_t _add_pair(uint32_t dst, uint32_t src);
+static uint32_t _average_pair(uint32_t dst, uint32_t src);
+static uint32_t _subtract_pair(uint32_t dst, uint32_t src);
+static uint32_t _multiply_pair(uint32_t dst, uint32_t src);
+
+static inline void _row_blend(blend_pair_t blend_pair, uint16_t *dst,
+    const uint16_t *src, uint32_t count) __always_inline;
+
+void
+blend_add_row_scalar(volatile uint16_t *fb, const uint16_t *src, uint32_t count)
+{
+        for (uint32_t x = 0; x < count; x++, fb++, src++) {
+                const uint16_t src_raw = *src;
+
+                if (src_raw == 0x0000) {
+                        continue;
+                }
+
+                const uint16_t fb_raw = *fb;
+
+                if ((fb_raw & 0x8000) == 0) {
+                        *fb = src_raw;
+                } else {
+                        const uint16_t fb_r = fb_raw & 31;
+                        const uint16_t fb_g = fb_raw & (31 << 5);
+                        const uint16_t fb_b = fb_raw & (31 << 10);
+
+                        const uint16_t src_r = src_raw & 31;
+                        const uint16_t src_g = src_raw & (31 << 5);
+                        const uint16_t src_b = src_raw & (31 << 10);
+
+                        const uint16_t r = min(src_r + fb_r, 31);
+                        const uint16_t g = min(src_g + fb_g, 31 << 5);
+                        const uint16_t b = min(src_b + fb_b, 31 << 10);
+
+                        *fb = (0x8000 | b | g | r);
+                }
+        }
+}
+
+void
+blend_add_row(volatile uint16_t *fb, const uint16_t *src, uint32_t count)
+{
+        if ((count > 0) && (((uintptr_t)fb & 2) != 0)) {
+                if (*src != 0x0000) {
+                        *fb = _add2(*fb, *src);
+                }
+
+                fb++;
+                src++;
+                count--;
+        }
+
+        volatile uint32_t *fb_pair = (volatile uint32_t *)fb;
+
+        for (; count >= 2; count -= 2, fb_pair++, src += 2) {
+                /* The framebuffer is big endian, so the left pixel is in the
+                 * upper half */
+                const uint32_t src_pair = ((uint32_t)src[0] << 16) | src[1];
+
+                /* Avoid the framebuffer read entirely when both pixels are
+                 * transparent */
+                if (src_pair == 0x00000000) {
+                        continue;
+                }
+
+                *fb_pair = _add2(*fb_pair, src_pair);
+        }
+
+        if ((count > 0) && (*src != 0x0000)) {
+                fb = (volatile uint16_t *)fb_pair;
+
+                *fb = _add2(*fb, *src);
+        }
+}
+
+void
+blend_add_spans(volatile uint16_t *fb, const uint16_t *src,
+    const blend_span_t *spans, uint32_t span_count)
+{
+        for (uint32_t i = 0; i < span_count; i++) {
+                const blend_span_t * const span = &spans[i];
+
+                blend_add_row(&fb[span->offset], &src[span->offset], span->length);
+        }
+}
+
+void
+blend_row(blend_mode_t mode, uint16_t *dst, const uint16_t *src, uint32_t count)
+{
+        switch (mode) {
+        case BLEND_MODE_ADD:
+                _row_blend(_add_pair, dst, src, count);
+                break;
+        case BLEND_MODE_AVERAGE:
+                _row_blend(_average_pair, dst, src, count);
+                break;
+        case BLEND_MODE_SUBTRACT:
+                _row_blend(_subtract_pair, dst, src, count);
+                break;
+        case BLEND_MODE_MULTIPLY:
+                _row_blend(_multiply_pair, dst, src, count);
+                break;
+        default:
+                assert(false);
+        }
+}
+
+static inline void __always_inline
+_row_blend(blend_pair_t blend_pair, uint16_t *dst, const uint16_t *src, uint32_t count)
+{
+        if ((count > 0) && (((uintptr_t)dst & 2) != 0)) {
+                *dst = blend_pair(*dst, *src);
+
+                dst++;
+                src++;
+                count--;
+        }
+
+        uint32_t *dst_pair = (uint32_t *)dst;
+
+        for (; count >= 2; count -= 2, dst_pair++, src += 2) {
+                const uint32_t src_pair = ((uint32_t)src[0] << 16) | src[1];
+
+                if (src_pair == 0x00000000) {
+                        continue;
+                }
+
+                *dst_pair = blend_pair(*dst_pair, src_pair);
+        }
+
+        if (count > 0) {
+                dst = (uint16_t *)dst_pair;
+
+                *dst = blend_pair(*dst, *src);
+        }
+}
+
+/* Expands the MSB of each pixel into a 16-bit lane mask */
+static inline uint32_t __always_inline
+_lane_mask(uint32_t pair)
+{
+        const uint32_t msb = (pair & MSB_MASK) >> 15;
+
+        return (msb << 16) - msb;
+}
+
+/* Keeps dst where the source is transparent */
+static inline uint32_t __always_inline
+_select2(uint32_t dst, uint32_t src, uint32_t blended)
+{
+        const uint32_t src_mask = _lane_mask(src);
+
+        return (dst & ~src_mask) | (blended & src_mask);
+}
+
+static uint32_t
+_add_pair(uint32_t dst, uint32_t src)
+{
+        return _add2(dst, src);
+}
+
+static uint32_t
+_average_pair(uint32_t dst, uint32_t src)
+{
+        const uint32_t black_dst = dst & _lane_mask(dst);
+
+        /* Halve each channel before adding so nothing carries across
+         * channels. The carry lost from the two low bits is recovered from
+         * (a & b) */
+        const uint32_t average =
+            (black_dst & src) + (((black_dst ^ src) & HALF_MASK) >> 1);
+
+        return _select2(dst, src, MSB_MASK | average);
+}
+
+static uint32_t
+_subtract_pair(uint32_t dst, uint32_t src)
+{
+        const uint32_t black_dst = dst & _lane_mask(dst);
+
+        /* Red and blue are subtracted together, then green, each channel
+         * borrowing from its own guard bit. A guard bit that survives marks a
+         * channel that didn't underflow */
+        const uint32_t rb = ((black_dst & RB_MASK) | RB_GUARD) - (src & RB_MASK);
+        const uint32_t g = ((black_dst & G_MASK) | G_GUARD) - (src & G_MASK);
+
+        const uint32_t rb_keep = rb & RB_GUARD;
+        const uint32_t g_keep = g & G_GUARD;
+
+        const uint32_t rb_mask = rb_keep - (rb_keep >> 5);
+        const uint32_t g_mask = g_keep - (g_keep >> 5);
+
+        return _select2(dst, src, MSB_MASK | (rb & rb_mask) | (g & g_mask));
+}
+
+static uint32_t
+_multiply_pair(uint32_t dst, uint32_t src)
+{
+        const uint32_t black_dst = dst & _lane_mask(dst);
+
+        uint32_t product;
+        product = MSB_MASK;
+
+        for (uint32_t lane = 0; lane < 32; lane += 16) {
+                for (uint32_t shift = lane; shift < (lane + 15); shift += 5) {
+                        const uint32_t a = (black_dst >> shift) & 31;
+                        const uint32_t b = (src >> shift) & 31;
+                        const uint32_t x = a * b;
+
+                        /* (a * b) / 31, without a division. Within one of the
+                         * rounded result, and exact when b is 0 or 31 */
+                        product |= ((x + (x >> 5) + 16) >> 5) << shift;
+                }
+        }
+
+        return _select2(dst, src, product);
+}
+
+/* Blends two pixels at once. A single pixel can be blended by passing it in the
+ * lower half of both fb and src */
+static inline uint32_t __always_inline
+_add2(uint32_t fb, uint32_t src)
+{
+        /* Expand each pixel's MSB into a 16-bit lane mask */
+        const uint32_t src_msb = (src & MSB_MASK) >> 15;
+        const uint32_t fb_msb = (fb & MSB_MASK) >> 15;
+        const uint32_t src_mask = (src_msb << 16) - src_msb;
+        const uint32_t fb_mask = (fb_msb << 16) - fb_msb;
+
+        /* Adding the low 4 bits of every channel can't carry into the next
+         * channel. The top bit of each channel is then the XOR of both top
+         * bits and the carry into it */
+        const uint32_t sum = (fb & LOW_MASK) + (src & LOW_MASK);
+        const uint32_t top = (fb ^ src) & TOP_MASK;
+
+        /* Carry out of each channel */
+        const uint32_t carry = ((fb & src) | ((fb | src) & sum)) & TOP_MASK;
+
+        /* Turn each carry into a 5-bit mask that saturates its channel to 31 */
+        const uint32_t saturate = (carry << 1) - (carry >> 4);
+
+        const uint32_t blended = MSB_MASK | (sum ^ top) | saturate;
+
+        return (fb & ~src_mask) |
+               (src_mask & ((blended & fb_mask) | (src & ~fb_mask)));
+}
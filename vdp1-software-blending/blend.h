@@ -0,0 +1,49 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+
+typedef enum blend_mode {
+        /* Saturating add */
+        BLEND_MODE_ADD,
+        /* Half of each */
+        BLEND_MODE_AVERAGE,
+        /* Saturating subtract of the source from the destination */
+        BLEND_MODE_SUBTRACT,
+        /* Destination scaled by the source, per channel */
+        BLEND_MODE_MULTIPLY,
+        BLEND_MODE_COUNT
+} blend_mode_t;
+
+/* A run of opaque pixels in a texture row, generated by work/span_encode.py */
+typedef struct blend_span {
+        uint16_t offset;
+        uint16_t length;
+} blend_span_t;
+
+/* Additively blends count RGB1555 pixels from src into fb, one pixel at a time.
+ * Transparent (0x0000) source pixels are skipped. Framebuffer pixels without
+ * the MSB set are replaced by the source pixel */
+void blend_add_row_scalar(volatile uint16_t *fb, const uint16_t *src, uint32_t count);
+
+/* Same as blend_add_row_scalar(), but two pixels are blended per 32-bit
+ * framebuffer access. If fb isn't 32-bit aligned (odd X), the first pixel is
+ * blended on its own, as is the last pixel of an odd count.
+ *
+ * Source pixels with the MSB clear are treated as transparent */
+void blend_add_row(volatile uint16_t *fb, const uint16_t *src, uint32_t count);
+
+/* Blends only the pixels covered by spans, with blend_add_row(). Span offsets
+ * are relative to both fb and src */
+void blend_add_spans(volatile uint16_t *fb, const uint16_t *src,
+    const blend_span_t *spans, uint32_t span_count);
+
+/* Blends count RGB1555 pixels from src into dst with mode, two pixels per
+ * 32-bit access. Meant for buffers in ordinary memory, like a framebuffer tile
+ * copied into work RAM.
+ *
+ * Source pixels with the MSB clear are transparent. Destination pixels with the
+ * MSB clear (nothing drawn by VDP1) blend as black */
+void blend_row(blend_mode_t mode, uint16_t *dst, const uint16_t *src, uint32_t count);
+
+#endif /* BLEND_H */
@@ -0,0 +1,291 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include "compositor.h"
+#include "fb_transfer.h"
+
+static void _sprites_sort(compositor_t *compositor);
+static void _tiles_bin(compositor_t *compositor);
+static void _split_row_calculate(compositor_t *compositor);
+static void _band_blend(compositor_t *compositor, uint32_t row_start,
+    uint32_t row_end, uint16_t *tile_buffer);
+static void _tile_blend(compositor_t *compositor, uint32_t tile_index,
+    uint16_t *tile_buffer);
+static void _sprite_blend(const compositor_sprite_t *sprite, int16_t tile_x,
+    int16_t tile_y, const compositor_tile_t *tile, uint16_t *tile_buffer);
+
+void
+compositor_init(compositor_t *compositor)
+{
+        compositor_clear(compositor);
+
+        compositor->split_row = COMPOSITOR_TILE_ROWS;
+}
+
+void
+compositor_clear(compositor_t *compositor)
+{
+        compositor->sprite_count = 0;
+}
+
+void
+compositor_sprite_add(compositor_t *compositor, const compositor_sprite_t *sprite)
+{
+        assert(compositor->sprite_count < COMPOSITOR_SPRITE_COUNT_MAX);
+        assert(sprite->texture != NULL);
+        assert(sprite->mode < BLEND_MODE_COUNT);
+
+        compositor->sprites[compositor->sprite_count] = *sprite;
+        compositor->sprite_count++;
+}
+
+void
+compositor_blend(compositor_t *compositor)
+{
+        compositor_prepare(compositor);
+        compositor_upper_blend(compositor);
+        compositor_lower_blend(compositor);
+}
+
+void
+compositor_prepare(compositor_t *compositor)
+{
+        _sprites_sort(compositor);
+        _tiles_bin(compositor);
+        _split_row_calculate(compositor);
+}
+
+void
+compositor_upper_blend(compositor_t *compositor)
+{
+        _band_blend(compositor, 0, compositor->split_row,
+            compositor->tile_buffers[0]);
+}
+
+void
+compositor_lower_blend(compositor_t *compositor)
+{
+        _band_blend(compositor, compositor->split_row, COMPOSITOR_TILE_ROWS,
+            compositor->tile_buffers[1]);
+}
+
+void
+compositor_restore_regions_add(const compositor_t *compositor,
+    fb_restore_t *restore)
+{
+        for (uint32_t i = 0; i < COMPOSITOR_TILE_COUNT; i++) {
+                const compositor_tile_t * const tile = &compositor->tiles[i];
+
+                if (tile->sprite_count == 0) {
+                        continue;
+                }
+
+                const int16_t tile_x = (i % COMPOSITOR_TILE_COLUMNS) * COMPOSITOR_TILE_WIDTH;
+                const int16_t tile_y = (i / COMPOSITOR_TILE_COLUMNS) * COMPOSITOR_TILE_HEIGHT;
+
+                fb_restore_region_add(restore, tile_x + tile->x0, tile_y + tile->y0,
+                    tile->x1 - tile->x0, tile->y1 - tile->y0);
+        }
+}
+
+static void
+_sprites_sort(compositor_t *compositor)
+{
+        const compositor_sprite_t * const sprites = compositor->sprites;
+        uint8_t * const order = compositor->order;
+
+        /* The list is short and mostly sorted already, and insertion sort is
+         * stable */
+        for (uint32_t i = 0; i < compositor->sprite_count; i++) {
+                uint32_t j;
+
+                for (j = i; (j > 0) && (sprites[order[j - 1]].priority > sprites[i].priority); j--) {
+                        order[j] = order[j - 1];
+                }
+
+                order[j] = i;
+        }
+}
+
+static void
+_tiles_bin(compositor_t *compositor)
+{
+        for (uint32_t i = 0; i < COMPOSITOR_TILE_COUNT; i++) {
+                compositor->tiles[i].sprite_count = 0;
+        }
+
+        for (uint32_t i = 0; i < compositor->sprite_count; i++) {
+                const compositor_sprite_t * const sprite =
+                    &compositor->sprites[compositor->order[i]];
+
+                const int16_t x0 = max(sprite->x, 0);
+                const int16_t y0 = max(sprite->y, 0);
+                const int16_t x1 = min(sprite->x + sprite->texture->width, COMPOSITOR_WIDTH);
+                const int16_t y1 = min(sprite->y + sprite->texture->height, COMPOSITOR_HEIGHT);
+
+                if ((x0 >= x1) || (y0 >= y1)) {
+                        continue;
+                }
+
+                for (int16_t ty = y0 / COMPOSITOR_TILE_HEIGHT; ty <= ((y1 - 1) / COMPOSITOR_TILE_HEIGHT); ty++) {
+                        const int16_t tile_y = ty * COMPOSITOR_TILE_HEIGHT;
+
+                        for (int16_t tx = x0 / COMPOSITOR_TILE_WIDTH; tx <= ((x1 - 1) / COMPOSITOR_TILE_WIDTH); tx++) {
+                                const int16_t tile_x = tx * COMPOSITOR_TILE_WIDTH;
+
+                                compositor_tile_t * const tile =
+                                    &compositor->tiles[(ty * COMPOSITOR_TILE_COLUMNS) + tx];
+
+                                const uint8_t rx0 = max(x0 - tile_x, 0);
+                                const uint8_t ry0 = max(y0 - tile_y, 0);
+                                const uint8_t rx1 = min(x1 - tile_x, COMPOSITOR_TILE_WIDTH);
+                                const uint8_t ry1 = min(y1 - tile_y, COMPOSITOR_TILE_HEIGHT);
+
+                                if (tile->sprite_count == 0) {
+                                        tile->x0 = rx0;
+                                        tile->y0 = ry0;
+                                        tile->x1 = rx1;
+                                        tile->y1 = ry1;
+                                } else {
+                                        tile->x0 = min(tile->x0, rx0);
+                                        tile->y0 = min(tile->y0, ry0);
+                                        tile->x1 = max(tile->x1, rx1);
+                                        tile->y1 = max(tile->y1, ry1);
+                                }
+
+                                tile->sprites[tile->sprite_count] = i;
+                                tile->sprite_count++;
+                        }
+                }
+        }
+}
+
+static void
+_split_row_calculate(compositor_t *compositor)
+{
+        /* Estimate the work in each tile row by the area blended in it */
+        uint32_t row_areas[COMPOSITOR_TILE_ROWS];
+        uint32_t total_area;
+        total_area = 0;
+
+        for (uint32_t row = 0; row < COMPOSITOR_TILE_ROWS; row++) {
+                const compositor_tile_t * const tiles =
+                    &compositor->tiles[row * COMPOSITOR_TILE_COLUMNS];
+
+                row_areas[row] = 0;
+
+                for (uint32_t column = 0; column < COMPOSITOR_TILE_COLUMNS; column++) {
+                        const compositor_tile_t * const tile = &tiles[column];
+
+                        row_areas[row] += tile->sprite_count *
+                            (tile->x1 - tile->x0) * (tile->y1 - tile->y0);
+                }
+
+                total_area += row_areas[row];
+        }
+
+        /* Stop at the first row that brings the upper band to half */
+        uint32_t upper_area;
+        upper_area = 0;
+
+        uint32_t split_row;
+
+        for (split_row = 0; split_row < COMPOSITOR_TILE_ROWS; split_row++) {
+                if (((upper_area + row_areas[split_row]) * 2) > total_area) {
+                        /* Give the row to whichever band ends up closer to
+                         * half */
+                        if (((upper_area + row_areas[split_row]) * 2 - total_area) <
+                            (total_area - (upper_area * 2))) {
+                                split_row++;
+                        }
+
+                        break;
+                }
+
+                upper_area += row_areas[split_row];
+        }
+
+        compositor->split_row = split_row;
+}
+
+static void
+_band_blend(compositor_t *compositor, uint32_t row_start, uint32_t row_end,
+    uint16_t *tile_buffer)
+{
+        for (uint32_t i = row_start * COMPOSITOR_TILE_COLUMNS; i < (row_end * COMPOSITOR_TILE_COLUMNS); i++) {
+                if (compositor->tiles[i].sprite_count == 0) {
+                        continue;
+                }
+
+                _tile_blend(compositor, i, tile_buffer);
+        }
+}
+
+static void
+_tile_blend(compositor_t *compositor, uint32_t tile_index, uint16_t *tile_buffer)
+{
+        const compositor_tile_t * const tile = &compositor->tiles[tile_index];
+
+        const int16_t tile_x = (tile_index % COMPOSITOR_TILE_COLUMNS) * COMPOSITOR_TILE_WIDTH;
+        const int16_t tile_y = (tile_index / COMPOSITOR_TILE_COLUMNS) * COMPOSITOR_TILE_HEIGHT;
+
+        /* Transfer whole pixel pairs. Tiles start on an even X, so the buffer
+         * and the framebuffer have the same alignment */
+        const uint32_t x0 = tile->x0 & ~1;
+        const uint32_t x1 = (tile->x1 + 1) & ~1;
+
+        uint16_t * const rect = &tile_buffer[(tile->y0 * COMPOSITOR_TILE_WIDTH) + x0];
+
+        fb_transfer_read(rect, COMPOSITOR_TILE_WIDTH, tile_x + x0,
+            tile_y + tile->y0, x1 - x0, tile->y1 - tile->y0);
+
+        for (uint32_t i = 0; i < tile->sprite_count; i++) {
+                const compositor_sprite_t * const sprite =
+                    &compositor->sprites[compositor->order[tile->sprites[i]]];
+
+                _sprite_blend(sprite, tile_x, tile_y, tile, tile_buffer);
+        }
+
+        fb_transfer_write(rect, COMPOSITOR_TILE_WIDTH, tile_x + x0,
+            tile_y + tile->y0, x1 - x0, tile->y1 - tile->y0);
+}
+
+static void
+_sprite_blend(const compositor_sprite_t *sprite, int16_t tile_x, int16_t tile_y,
+    const compositor_tile_t *tile, uint16_t *tile_buffer)
+{
+        const compositor_texture_t * const texture = sprite->texture;
+
+        /* Part of the tile covered by the sprite, in texture coordinates */
+        const int16_t u0 = max(tile_x + tile->x0 - sprite->x, 0);
+        const int16_t v0 = max(tile_y + tile->y0 - sprite->y, 0);
+        const int16_t u1 = min(tile_x + tile->x1 - sprite->x, (int16_t)texture->width);
+        const int16_t v1 = min(tile_y + tile->y1 - sprite->y, (int16_t)texture->height);
+
+        for (int16_t v = v0; v < v1; v++) {
+                const uint16_t * const src = &texture->texels[v * texture->width];
+
+                /* Buffer row, offset so that it's indexed by U */
+                uint16_t * const dst = &tile_buffer[
+                    ((sprite->y + v - tile_y) * COMPOSITOR_TILE_WIDTH) + (sprite->x + u0 - tile_x)] - u0;
+
+                if (texture->spans == NULL) {
+                        blend_row(sprite->mode, &dst[u0], &src[u0], u1 - u0);
+
+                        continue;
+                }
+
+                for (uint32_t i = texture->span_rows[v]; i < texture->span_rows[v + 1]; i++) {
+                        const blend_span_t * const span = &texture->spans[i];
+
+                        const int16_t span_u0 = max((int16_t)span->offset, u0);
+                        const int16_t span_u1 = min((int16_t)(span->offset + span->length), u1);
+
+                        if (span_u0 < span_u1) {
+                                blend_row(sprite->mode, &dst[span_u0], &src[span_u0],
+                                    span_u1 - span_u0);
+                        }
+                }
+        }
+}
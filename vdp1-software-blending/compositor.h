@@ -0,0 +1,104 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <stdint.h>
+
+#include "blend.h"
+#include "fb_restore.h"
+
+#define COMPOSITOR_SPRITE_COUNT_MAX (64)
+
+/* The VDP1 framebuffer, at 16 bits per pixel */
+#define COMPOSITOR_WIDTH  (512)
+#define COMPOSITOR_HEIGHT (256)
+
+#define COMPOSITOR_TILE_WIDTH  (64)
+#define COMPOSITOR_TILE_HEIGHT (32)
+
+#define COMPOSITOR_TILE_COLUMNS (COMPOSITOR_WIDTH / COMPOSITOR_TILE_WIDTH)
+#define COMPOSITOR_TILE_ROWS    (COMPOSITOR_HEIGHT / COMPOSITOR_TILE_HEIGHT)
+#define COMPOSITOR_TILE_COUNT   (COMPOSITOR_TILE_COLUMNS * COMPOSITOR_TILE_ROWS)
+
+typedef struct compositor_texture {
+        /* RGB1555, width * height. Pixels with the MSB clear are transparent */
+        const uint16_t *texels;
+        /* Opaque spans from work/span_encode.py. If NULL, whole rows are
+         * blended */
+        const uint16_t *span_rows;
+        const blend_span_t *spans;
+        uint16_t width;
+        uint16_t height;
+} compositor_texture_t;
+
+typedef struct compositor_sprite {
+        const compositor_texture_t *texture;
+        /* Top left corner, in framebuffer pixels */
+        int16_t x;
+        int16_t y;
+        blend_mode_t mode;
+        /* Sprites blend in ascending priority. Sprites of equal priority blend
+         * in the order they were added */
+        uint8_t priority;
+} compositor_sprite_t;
+
+typedef struct compositor_tile {
+        /* Indices into the sorted sprite order */
+        uint8_t sprites[COMPOSITOR_SPRITE_COUNT_MAX];
+        uint8_t sprite_count;
+
+        /* Area covered by the sprites, relative to the tile, exclusive of x1
+         * and y1 */
+        uint8_t x0;
+        uint8_t y0;
+        uint8_t x1;
+        uint8_t y1;
+} compositor_tile_t;
+
+/* Blends a list of sprites into the VDP1 framebuffer, one tile at a time. Each
+ * tile touched by a sprite is read from the framebuffer once by DMA, every
+ * sprite covering it is blended into the copy in work RAM, then it's written
+ * back once.
+ * Overlapping sprites cost no extra framebuffer accesses */
+typedef struct compositor {
+        compositor_sprite_t sprites[COMPOSITOR_SPRITE_COUNT_MAX];
+        uint8_t order[COMPOSITOR_SPRITE_COUNT_MAX];
+        uint32_t sprite_count;
+
+        compositor_tile_t tiles[COMPOSITOR_TILE_COUNT];
+
+        /* Tile rows above split_row form the upper band, the rest the lower
+         * band */
+        uint32_t split_row;
+
+        /* One per band, so that both can be blended at the same time */
+        uint16_t tile_buffers[2][COMPOSITOR_TILE_WIDTH * COMPOSITOR_TILE_HEIGHT] __aligned(4);
+} compositor_t;
+
+void compositor_init(compositor_t *compositor);
+
+/* Empties the sprite list. Call at the start of every frame */
+void compositor_clear(compositor_t *compositor);
+
+void compositor_sprite_add(compositor_t *compositor, const compositor_sprite_t *sprite);
+
+/* Blends every sprite in the list. Call once VDP1 has finished drawing, from the
+ * handler set with vdp1_sync_render_set() */
+void compositor_blend(compositor_t *compositor);
+
+/* Splitting compositor_blend() across both CPUs: compositor_prepare() sorts and
+ * bins the sprites, and splits the tile rows into two bands with about the same
+ * amount of blending in each. Then the two bands can be blended at the same
+ * time, one per CPU.
+ *
+ * Neither band function writes to the compositor outside its own tile buffer.
+ * The CPU that didn't call compositor_prepare() must purge its cache first */
+void compositor_prepare(compositor_t *compositor);
+void compositor_upper_blend(compositor_t *compositor);
+void compositor_lower_blend(compositor_t *compositor);
+
+/* Records the area of every tile that's about to be blended. Call after
+ * compositor_prepare() */
+void compositor_restore_regions_add(const compositor_t *compositor,
+    fb_restore_t *restore);
+
+#endif /* COMPOSITOR_H */
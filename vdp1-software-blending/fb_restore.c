@@ -0,0 +1,98 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include "fb_restore.h"
+#include "fb_transfer.h"
+
+static void _region_restore(const fb_restore_t *restore,
+    const fb_restore_region_t *region);
+
+void
+fb_restore_init(fb_restore_t *restore, const uint16_t *background,
+    uint16_t width, uint16_t height)
+{
+        restore->background = background;
+        restore->index = 0;
+
+        /* Nothing is known about what's in either framebuffer yet */
+        for (uint32_t i = 0; i < 2; i++) {
+                fb_restore_list_t * const list = &restore->lists[i];
+
+                list->regions[0].x = 0;
+                list->regions[0].y = 0;
+                list->regions[0].width = width;
+                list->regions[0].height = height;
+
+                list->count = 1;
+        }
+}
+
+void
+fb_restore_region_add(fb_restore_t *restore, int16_t x, int16_t y,
+    uint16_t width, uint16_t height)
+{
+        fb_restore_list_t * const list = &restore->lists[restore->index];
+
+        const int16_t x0 = x & ~1;
+        const int16_t x1 = (x + width + 1) & ~1;
+
+        if (list->count == FB_RESTORE_REGION_COUNT_MAX) {
+                /* Out of regions, so grow the last one to cover both */
+                fb_restore_region_t * const last = &list->regions[list->count - 1];
+
+                const int16_t last_x1 = last->x + last->width;
+                const int16_t last_y1 = last->y + last->height;
+
+                last->x = min(last->x, x0);
+                last->y = min(last->y, y);
+                last->width = max(last_x1, x1) - last->x;
+                last->height = max(last_y1, (int16_t)(y + height)) - last->y;
+
+                return;
+        }
+
+        fb_restore_region_t * const region = &list->regions[list->count];
+
+        region->x = x0;
+        region->y = y;
+        region->width = x1 - x0;
+        region->height = height;
+
+        list->count++;
+}
+
+void
+fb_restore_apply(fb_restore_t *restore)
+{
+        fb_restore_list_t * const list = &restore->lists[restore->index];
+
+        for (uint32_t i = 0; i < list->count; i++) {
+                _region_restore(restore, &list->regions[i]);
+        }
+
+        list->count = 0;
+}
+
+void
+fb_restore_swap(fb_restore_t *restore)
+{
+        restore->index ^= 1;
+}
+
+static void
+_region_restore(const fb_restore_t *restore, const fb_restore_region_t *region)
+{
+        if (restore->background == NULL) {
+                fb_transfer_fill(0x0000, region->x, region->y, region->width,
+                    region->height);
+
+                return;
+        }
+
+        const uint16_t * const background =
+            &restore->background[(region->y * FB_TRANSFER_FB_WIDTH) + region->x];
+
+        fb_transfer_write(background, FB_TRANSFER_FB_WIDTH, region->x, region->y,
+            region->width, region->height);
+}
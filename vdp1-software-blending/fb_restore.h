@@ -0,0 +1,54 @@
+#ifndef FB_RESTORE_H
+#define FB_RESTORE_H
+
+#include <stdint.h>
+
+#define FB_RESTORE_REGION_COUNT_MAX (64)
+
+typedef struct fb_restore_region {
+        int16_t x;
+        int16_t y;
+        uint16_t width;
+        uint16_t height;
+} fb_restore_region_t;
+
+typedef struct fb_restore_list {
+        fb_restore_region_t regions[FB_RESTORE_REGION_COUNT_MAX];
+        uint32_t count;
+} fb_restore_list_t;
+
+/* Puts back the framebuffer regions changed by the CPU, instead of clearing the
+ * whole framebuffer every frame.
+ *
+ * VDP1 draws into the two framebuffers in turn, so the regions changed while
+ * one is drawn are kept until that framebuffer comes back, then restored before
+ * VDP1 draws into it again. Whatever VDP1 draws each frame goes over the
+ * restored background as usual */
+typedef struct fb_restore {
+        /* 32-bit aligned, with rows FB_TRANSFER_FB_WIDTH pixels apart. If
+         * NULL, regions are cleared to transparent (0x0000) */
+        const uint16_t *background;
+
+        /* One per framebuffer */
+        fb_restore_list_t lists[2];
+        uint32_t index;
+} fb_restore_t;
+
+/* The first time each framebuffer is drawn, the width x height area at the top
+ * left is restored in full */
+void fb_restore_init(fb_restore_t *restore, const uint16_t *background,
+    uint16_t width, uint16_t height);
+
+/* Records a region changed in the framebuffer being drawn. x and width are
+ * widened to even values */
+void fb_restore_region_add(fb_restore_t *restore, int16_t x, int16_t y,
+    uint16_t width, uint16_t height);
+
+/* Restores the regions recorded the last time the framebuffer about to be drawn
+ * was drawn. Call while VDP1 is idle, before vdp1_sync_render() */
+void fb_restore_apply(fb_restore_t *restore);
+
+/* Call once per frame, once the framebuffers have changed */
+void fb_restore_swap(fb_restore_t *restore);
+
+#endif /* FB_RESTORE_H */
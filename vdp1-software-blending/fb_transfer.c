@@ -0,0 +1,117 @@
+#include <assert.h>
+
+#include <yaul.h>
+
+#include "fb_transfer.h"
+
+static void _rows_transfer(uintptr_t src, uint32_t src_stride, uintptr_t dst,
+    uint32_t dst_stride, uint32_t row_size, uint32_t row_count);
+
+/* Source of fills. One per CPU, as both may fill at the same time */
+static uint32_t _fill_pairs[2];
+
+static inline void _rect_assert(const uint16_t *buffer, uint32_t buffer_stride,
+    int16_t x, uint16_t width) __always_inline;
+
+void
+fb_transfer_read(uint16_t *buffer, uint32_t buffer_stride, int16_t x,
+    int16_t y, uint16_t width, uint16_t height)
+{
+        _rect_assert(buffer, buffer_stride, x, width);
+
+        if ((width == 0) || (height == 0)) {
+                return;
+        }
+
+        _rows_transfer(VDP1_FB(((y * FB_TRANSFER_FB_WIDTH) + x) * sizeof(uint16_t)),
+            FB_TRANSFER_FB_WIDTH * sizeof(uint16_t),
+            (uintptr_t)buffer, buffer_stride * sizeof(uint16_t),
+            width * sizeof(uint16_t), height);
+
+        /* The DMAC went around the cache */
+        cpu_cache_area_purge(buffer,
+            (((height - 1) * buffer_stride) + width) * sizeof(uint16_t));
+}
+
+void
+fb_transfer_write(const uint16_t *buffer, uint32_t buffer_stride, int16_t x,
+    int16_t y, uint16_t width, uint16_t height)
+{
+        _rect_assert(buffer, buffer_stride, x, width);
+
+        if ((width == 0) || (height == 0)) {
+                return;
+        }
+
+        _rows_transfer((uintptr_t)buffer, buffer_stride * sizeof(uint16_t),
+            VDP1_FB(((y * FB_TRANSFER_FB_WIDTH) + x) * sizeof(uint16_t)),
+            FB_TRANSFER_FB_WIDTH * sizeof(uint16_t),
+            width * sizeof(uint16_t), height);
+}
+
+void
+fb_transfer_fill(uint16_t color, int16_t x, int16_t y, uint16_t width,
+    uint16_t height)
+{
+        _rect_assert(NULL, 0, x, width);
+
+        if ((width == 0) || (height == 0)) {
+                return;
+        }
+
+        uint32_t * const fill_pair = &_fill_pairs[cpu_dual_executor_get()];
+
+        /* The DMAC reads the pair from memory, not from this CPU's cache */
+        *fill_pair = ((uint32_t)color << 16) | color;
+
+        /* A source stride of 0 keeps reading the same pair */
+        _rows_transfer((uintptr_t)fill_pair, 0,
+            VDP1_FB(((y * FB_TRANSFER_FB_WIDTH) + x) * sizeof(uint16_t)),
+            FB_TRANSFER_FB_WIDTH * sizeof(uint16_t),
+            width * sizeof(uint16_t), height);
+}
+
+static void
+_rows_transfer(uintptr_t src, uint32_t src_stride, uintptr_t dst,
+    uint32_t dst_stride, uint32_t row_size, uint32_t row_count)
+{
+        cpu_dmac_cfg_t cfg = {
+                .channel  = FB_TRANSFER_DMAC_CHANNEL,
+                .src_mode = (src_stride == 0) ? CPU_DMAC_SOURCE_FIXED : CPU_DMAC_SOURCE_INCREMENT,
+                .dst_mode = CPU_DMAC_DESTINATION_INCREMENT,
+                .stride   = CPU_DMAC_STRIDE_4_BYTES,
+                .bus_mode = CPU_DMAC_BUS_MODE_BURST,
+                .ihr      = NULL,
+                .ihr_work = NULL
+        };
+
+        /* Whole framebuffer rows are contiguous on both sides, so a single
+         * transfer will do */
+        if ((src_stride == row_size) && (dst_stride == row_size)) {
+                row_size *= row_count;
+                row_count = 1;
+        }
+
+        for (uint32_t i = 0; i < row_count; i++) {
+                cfg.src = src;
+                cfg.dst = dst;
+                cfg.len = row_size;
+
+                cpu_dmac_channel_config_set(&cfg);
+                cpu_dmac_channel_start(FB_TRANSFER_DMAC_CHANNEL);
+                cpu_dmac_channel_wait(FB_TRANSFER_DMAC_CHANNEL);
+
+                src += src_stride;
+                dst += dst_stride;
+        }
+}
+
+static inline void __always_inline
+_rect_assert(const uint16_t *buffer __unused, uint32_t buffer_stride __unused,
+    int16_t x __unused, uint16_t width __unused)
+{
+        assert(((uintptr_t)buffer & 3) == 0);
+        assert((buffer_stride & 1) == 0);
+        assert((x & 1) == 0);
+        assert((width & 1) == 0);
+}
@@ -0,0 +1,34 @@
+#ifndef FB_TRANSFER_H
+#define FB_TRANSFER_H
+
+#include <stdint.h>
+
+/* Each CPU has its own DMAC, so the master and the slave can transfer at the
+ * same time on the same channel */
+#define FB_TRANSFER_DMAC_CHANNEL (0)
+
+/* Width of the VDP1 framebuffer, at 16 bits per pixel */
+#define FB_TRANSFER_FB_WIDTH (512)
+
+/* Copies the width x height rectangle of the VDP1 framebuffer at (x, y) into
+ * buffer with the CPU-DMAC, one row per transfer. Rows in buffer are
+ * buffer_stride pixels apart. x, width, and buffer_stride must be even, and
+ * buffer must be 32-bit aligned.
+ *
+ * Waits for the transfer to end, then purges buffer from the calling CPU's
+ * cache */
+void fb_transfer_read(uint16_t *buffer, uint32_t buffer_stride, int16_t x,
+    int16_t y, uint16_t width, uint16_t height);
+
+/* Copies buffer back into the framebuffer, with the same constraints as
+ * fb_transfer_read(). The DMAC reads buffer from memory, which the CPU's
+ * writes have already reached, so there's nothing to flush */
+void fb_transfer_write(const uint16_t *buffer, uint32_t buffer_stride,
+    int16_t x, int16_t y, uint16_t width, uint16_t height);
+
+/* Fills a framebuffer rectangle with color, with the same constraints on x and
+ * width as fb_transfer_read() */
+void fb_transfer_fill(uint16_t color, int16_t x, int16_t y, uint16_t width,
+    uint16_t height);
+
+#endif /* FB_TRANSFER_H */
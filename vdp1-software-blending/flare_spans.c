@@ -0,0 +1,76 @@
+/* Generated by span_encode.py from flare_texture.c: 2863 of 4096 pixels are opaque */
+
+#include <stdint.h>
+
+#include "blend.h"
+
+const uint16_t flare_span_rows[] = {
+        0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+        14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
+        30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45,
+        46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 60,
+        60,
+};
+
+const blend_span_t flare_spans[] = {
+        {  25,  14 },
+        {  22,  20 },
+        {  20,  24 },
+        {  17,  29 },
+        {  15,  33 },
+        {  14,  35 },
+        {  13,  38 },
+        {  12,  40 },
+        {  11,  42 },
+        {   9,  45 },
+        {   9,  46 },
+        {   8,  48 },
+        {   7,  49 },
+        {   7,  50 },
+        {   6,  52 },
+        {   5,  53 },
+        {   5,  54 },
+        {   4,  55 },
+        {   4,  56 },
+        {   3,  57 },
+        {   3,  57 },
+        {   3,  58 },
+        {   3,  58 },
+        {   2,  59 },
+        {   2,  59 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  60 },
+        {   1,  61 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  60 },
+        {   2,  59 },
+        {   2,  59 },
+        {   2,  59 },
+        {   3,  58 },
+        {   3,  57 },
+        {   4,  56 },
+        {   4,  56 },
+        {   4,  55 },
+        {   5,  54 },
+        {   5,  53 },
+        {   6,  52 },
+        {   6,  51 },
+        {   7,  49 },
+        {   8,  47 },
+        {   9,  46 },
+        {   9,  45 },
+        {  10,  43 },
+        {  12,  40 },
+        {  13,  38 },
+        {  14,  35 },
+        {  16,  32 },
+        {  17,  29 },
+        {  19,  25 },
+        {  22,  20 },
+        {  25,  13 },
+};
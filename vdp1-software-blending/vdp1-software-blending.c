@@ -12,13 +12,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "benchmark.h"
+#include "blend.h"
+#include "compositor.h"
+
 #define SCREEN_WIDTH  320
 #define SCREEN_HEIGHT 240
 
 #define VDP1_CMDT_ORDER_SYSTEM_CLIP_COORDS_INDEX (0)
 #define VDP1_CMDT_ORDER_USER_CLIP_INDEX          (1)
 #define VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX       (2)
-#define VDP1_CMDT_ORDER_CLEAR_POLYGON_INDEX      (3)
+#define VDP1_CMDT_ORDER_GREY_BOX_INDEX           (3)
 #define VDP1_CMDT_ORDER_SPRITE_INDEX             (4)
 #define VDP1_CMDT_ORDER_DRAW_END_INDEX           (5)
 #define VDP1_CMDT_ORDER_COUNT                    (VDP1_CMDT_ORDER_DRAW_END_INDEX + 1)
@@ -26,11 +30,19 @@
 extern const int16_vec2_t flare_texture_dim;
 extern const uint16_t flare_texture[];
 extern const uint32_t flare_texture_size;
+extern const uint16_t flare_span_rows[];
+extern const blend_span_t flare_spans[];
 
 typedef struct {
         int16_vec2_t coords;
 } render_state_t;
 
+static compositor_t _compositor;
+static fb_restore_t _fb_restore;
+
+/* Set by the slave once it has blended the lower band */
+static volatile bool _lower_band_done __uncached;
+
 static vdp1_cmdt_list_t *_cmdt_list = NULL;
 static vdp1_vram_partitions_t _vdp1_vram_partitions;
 
@@ -38,13 +50,12 @@ static smpc_peripheral_digital_t _digital;
 
 static void _vblank_out_handler(void *work);
 static void _sync_render_handler(void *work);
+static void _slave_entry(void);
 
 static void _cmdt_list_init(void);
 static void _cmdt_list_populate(void);
 
-static inline uint16_t *_fb_offset_calc(uint32_t x, uint32_t y) __always_inline;
-
-static void _flare_blend(int16_t flare_x, int16_t flare_y);
+static void _sprites_add(const compositor_texture_t *flare, int16_vec2_t coords);
 
 int
 main(void)
@@ -54,13 +65,32 @@ main(void)
         render_state.coords.x = 0;
         render_state.coords.y = 0;
 
+        const compositor_texture_t flare = {
+                .texels    = flare_texture,
+                .span_rows = flare_span_rows,
+                .spans     = flare_spans,
+                .width     = flare_texture_dim.x,
+                .height    = flare_texture_dim.y
+        };
+
+        compositor_init(&_compositor);
+        fb_restore_init(&_fb_restore, NULL, COMPOSITOR_WIDTH, COMPOSITOR_HEIGHT);
+
         _cmdt_list_init();
 
+#ifdef BENCHMARK
+        benchmark_blend_run();
+        benchmark_fb_transfer_run();
+#endif /* BENCHMARK */
+
         /* Copy flare texture to VDP1 */
         scu_dma_transfer(0, _vdp1_vram_partitions.texture_base, flare_texture, flare_texture_size);
         scu_dma_transfer_wait(0);
 
-        vdp1_sync_render_set(_sync_render_handler, &render_state);
+        cpu_dual_comm_mode_set(CPU_DUAL_ENTRY_ICI);
+        cpu_dual_slave_set(_slave_entry);
+
+        vdp1_sync_render_set(_sync_render_handler, &_compositor);
 
         uint32_t frame_count;
         frame_count = 0;
@@ -81,8 +111,14 @@ main(void)
                         render_state.coords.y += 5;
                 }
 
-                render_state.coords.x = clamp(render_state.coords.x, 0, 512 - flare_texture_dim.x);
-                render_state.coords.y = clamp(render_state.coords.y, 0, 512 - flare_texture_dim.y);
+                render_state.coords.x = clamp(render_state.coords.x, 0, COMPOSITOR_WIDTH - flare_texture_dim.x);
+                render_state.coords.y = clamp(render_state.coords.y, 0, COMPOSITOR_HEIGHT - flare_texture_dim.y);
+
+                _sprites_add(&flare, render_state.coords);
+
+                /* Put back what was blended the last time this framebuffer
+                 * was drawn */
+                fb_restore_apply(&_fb_restore);
 
                 vdp1_sync_cmdt_list_put(_cmdt_list, 0);
                 vdp1_sync_render();
@@ -93,6 +129,9 @@ main(void)
 
                 vdp1_sync();
                 vdp1_sync_wait();
+
+                fb_restore_swap(&_fb_restore);
+
                 frame_count++;
         }
 
@@ -156,23 +195,25 @@ _cmdt_list_sprite_init(void)
 }
 
 static void
-_cmdt_list_clear_init(void)
+_cmdt_list_grey_box_init(void)
 {
         static const vdp1_cmdt_draw_mode_t draw_mode = {
                 .pre_clipping_disable = true
         };
 
+        /* 64x64 at the top left of the framebuffer, for the flares to blend
+         * over */
         static const int16_vec2_t points[] = {
-                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2),     -(SCREEN_HEIGHT / 2)),
-                INT16_VEC2_INITIALIZER( (SCREEN_WIDTH / 2) - 1, -(SCREEN_HEIGHT / 2)),
-                INT16_VEC2_INITIALIZER( (SCREEN_WIDTH / 2) - 1,  (SCREEN_HEIGHT / 2) - 1),
-                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2),      (SCREEN_HEIGHT / 2) - 1),
+                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2),      -(SCREEN_HEIGHT / 2)),
+                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2) + 63, -(SCREEN_HEIGHT / 2)),
+                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2) + 63, -(SCREEN_HEIGHT / 2) + 63),
+                INT16_VEC2_INITIALIZER(-(SCREEN_WIDTH / 2),      -(SCREEN_HEIGHT / 2) + 63),
         };
 
-        static const rgb1555_t color = RGB1555(0, 0, 0, 0);
+        static const rgb1555_t color = RGB1555(1, 15, 15, 15);
 
         vdp1_cmdt_t * const cmdt =
-            &_cmdt_list->cmdts[VDP1_CMDT_ORDER_CLEAR_POLYGON_INDEX];
+            &_cmdt_list->cmdts[VDP1_CMDT_ORDER_GREY_BOX_INDEX];
 
         vdp1_cmdt_polygon_set(cmdt);
         vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
@@ -185,7 +226,7 @@ _cmdt_list_populate(void)
 {
         vdp1_env_preamble_populate(_cmdt_list->cmdts, NULL);
 
-        _cmdt_list_clear_init();
+        _cmdt_list_grey_box_init();
         _cmdt_list_sprite_init();
 
         vdp1_cmdt_end_set(&_cmdt_list->cmdts[VDP1_CMDT_ORDER_DRAW_END_INDEX]);
@@ -193,70 +234,76 @@ _cmdt_list_populate(void)
         _cmdt_list->count = VDP1_CMDT_ORDER_COUNT;
 }
 
-static inline uint16_t * __always_inline
-_fb_offset_calc(uint32_t x, uint32_t y)
-{
-        return (uint16_t *)VDP1_FB(((y * 512) + x) * sizeof(rgb1555_t));
-}
-
 static void
-_flare_blend(int16_t flare_x, int16_t flare_y)
+_sprites_add(const compositor_texture_t *flare, int16_vec2_t coords)
 {
-        /* Draw grey box */
-        for (int32_t y = 0; y < flare_texture_dim.y; y++) {
-                volatile rgb1555_t *fb = (volatile rgb1555_t *)_fb_offset_calc(0, y);
+        /* One flare per blend mode, overlapping the grey box and each other */
+        static const struct {
+                int16_vec2_t position;
+                blend_mode_t mode;
+        } mode_sprites[] = {
+                { INT16_VEC2_INITIALIZER(32,  0), BLEND_MODE_AVERAGE  },
+                { INT16_VEC2_INITIALIZER( 0, 32), BLEND_MODE_SUBTRACT },
+                { INT16_VEC2_INITIALIZER(32, 32), BLEND_MODE_MULTIPLY }
+        };
 
-                for (int32_t x = 0; x < flare_texture_dim.x; x++, fb++) {
-                        fb->raw = 0xBDEF;
-                }
-        }
+        compositor_clear(&_compositor);
 
-        for (int32_t y = 0; y < flare_texture_dim.y; y++) {
-                volatile rgb1555_t *fb =
-                    (volatile rgb1555_t *)_fb_offset_calc(flare_x, flare_y + y);
+        for (uint32_t i = 0; i < (sizeof(mode_sprites) / sizeof(*mode_sprites)); i++) {
+                const compositor_sprite_t sprite = {
+                        .texture  = flare,
+                        .x        = mode_sprites[i].position.x,
+                        .y        = mode_sprites[i].position.y,
+                        .mode     = mode_sprites[i].mode,
+                        .priority = 0
+                };
 
-                const rgb1555_t *flare_texture_offset =
-                    (const rgb1555_t *)&flare_texture[y * flare_texture_dim.x];
+                compositor_sprite_add(&_compositor, &sprite);
+        }
 
-                for (int32_t x = 0; x < flare_texture_dim.x; x++, fb++, flare_texture_offset++) {
-                        const rgb1555_t src_pixel = (rgb1555_t)*flare_texture_offset;
+        /* The flare moved with the pad goes on top */
+        const compositor_sprite_t sprite = {
+                .texture  = flare,
+                .x        = coords.x,
+                .y        = coords.y,
+                .mode     = BLEND_MODE_ADD,
+                .priority = 1
+        };
 
-                        if (src_pixel.raw == 0x0000) {
-                                continue;
-                        }
+        compositor_sprite_add(&_compositor, &sprite);
+}
 
-                        const rgb1555_t fb_pixel = *fb;
+static void
+_sync_render_handler(void *work)
+{
+        compositor_t * const compositor = work;
 
-                        if (!fb_pixel.msb) {
-                                *fb = src_pixel;
-                        } else {
-                                const uint16_t fb_raw = fb_pixel.raw;
-                                const uint16_t src_raw = src_pixel.raw;
+        compositor_prepare(compositor);
+        compositor_restore_regions_add(compositor, &_fb_restore);
 
-                                const uint16_t fb_r = fb_raw & 31;
-                                const uint16_t fb_g = fb_raw & (31 << 5);
-                                const uint16_t fb_b = fb_raw & (31 << 10);
+        /* The slave blends the lower band while the master blends the upper
+         * band */
+        _lower_band_done = false;
 
-                                const uint16_t src_r = src_raw & 31;
-                                const uint16_t src_g = src_raw & (31 << 5);
-                                const uint16_t src_b = src_raw & (31 << 10);
+        cpu_dual_slave_notify();
 
-                                const uint16_t r = min(src_r + fb_r, 31);
-                                const uint16_t g = min(src_g + fb_g, 31 << 5);
-                                const uint16_t b = min(src_b + fb_b, 31 << 10);
+        compositor_upper_blend(compositor);
 
-                                fb->raw = (0x8000 | b | g | r);
-                        }
-                }
+        /* Join before returning, so both bands are done before the
+         * framebuffers are changed */
+        while (!_lower_band_done) {
         }
 }
 
 static void
-_sync_render_handler(void *work)
+_slave_entry(void)
 {
-        render_state_t * const render_state = work;
+        /* Drop any stale lines of the sprite bins the master just filled */
+        cpu_cache_purge();
+
+        compositor_lower_blend(&_compositor);
 
-        _flare_blend(render_state->coords.x, render_state->coords.y);
+        _lower_band_done = true;
 }
 
 static void
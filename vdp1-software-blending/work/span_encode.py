@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# Encodes each row of an RGB1555 texture as a list of opaque spans, so the
+# blend only visits pixels that aren't transparent (0x0000)
+#
+# The input is either a C source file holding a uint16_t array, like
+# flare_texture.c, or a raw big endian RGB1555 file. The output is a C source
+# file with two arrays:
+#
+#   const uint16_t <symbol>_span_rows[height + 1];
+#   const blend_span_t <symbol>_spans[];
+#
+# The spans of row y are <symbol>_spans[rows[y]] up to, but not including,
+# <symbol>_spans[rows[y + 1]]. Each span is an (offset, length) pair in pixels
+# from the start of the row.
+
+import os
+import re
+import struct
+import sys
+
+
+def texels_read(path):
+    if path.endswith(".c"):
+        with open(path, "r") as fp:
+            source = fp.read()
+        match = re.search(r"uint16_t\s+\w+\s*\[\s*\]\s*=\s*\{([^}]*)\}", source)
+        if match is None:
+            return None
+        return [int(value, 0) for value in match.group(1).replace(",", " ").split()]
+
+    with open(path, "rb") as fp:
+        data = fp.read()
+    return list(struct.unpack(">%iH" % (len(data) // 2), data[:len(data) & ~1]))
+
+
+def row_spans(row):
+    spans = []
+    x = 0
+    while x < len(row):
+        if row[x] == 0x0000:
+            x += 1
+            continue
+        start = x
+        while x < len(row) and row[x] != 0x0000:
+            x += 1
+        spans.append((start, x - start))
+    return spans
+
+
+def main():
+    if len(sys.argv) != 5:
+        print("%s [input.c|input.bin] [width] [symbol] [output.c]" % (os.path.basename(sys.argv[0])))
+        sys.exit(2)
+
+    input_path = sys.argv[1]
+    width = int(sys.argv[2], 0)
+    symbol = sys.argv[3]
+
+    texels = texels_read(input_path)
+
+    if texels is None or width <= 0 or (len(texels) % width) != 0:
+        print("%s: %s isn't a texture %i pixels wide" % (os.path.basename(sys.argv[0]), input_path, width))
+        sys.exit(2)
+
+    height = len(texels) // width
+
+    rows = [0]
+    spans = []
+    for y in range(height):
+        spans += row_spans(texels[y * width:(y + 1) * width])
+        rows.append(len(spans))
+
+    opaque_count = sum(length for _, length in spans)
+
+    with open(sys.argv[4], "w") as fp:
+        fp.write("/* Generated by span_encode.py from %s: %i of %i pixels are opaque */\n\n" %
+                 (os.path.basename(input_path), opaque_count, len(texels)))
+        fp.write("#include <stdint.h>\n\n")
+        fp.write("#include \"blend.h\"\n\n")
+
+        fp.write("const uint16_t %s_span_rows[] = {\n" % (symbol))
+        for i in range(0, len(rows), 16):
+            fp.write("        %s,\n" % (", ".join("%i" % (row) for row in rows[i:i + 16])))
+        fp.write("};\n\n")
+
+        fp.write("const blend_span_t %s_spans[] = {\n" % (symbol))
+        for offset, length in spans:
+            fp.write("        { %3i, %3i },\n" % (offset, length))
+        fp.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
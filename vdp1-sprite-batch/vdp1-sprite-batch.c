@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2012-2022 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <yaul.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "perf.h"
+#include "sprite_batch.h"
+
+#define SCREEN_WIDTH  320
+#define SCREEN_HEIGHT 240
+
+#define SPRITE_COUNT_MAX  (2048)
+#define SPRITE_COUNT_STEP (256)
+
+#define SPRITE_WIDTH  (8)
+#define SPRITE_HEIGHT (8)
+
+#define ANIMATION_FRAME_COUNT    (4)
+#define ANIMATION_FRAME_DURATION (5)
+
+/* RGB, so 2 bytes per texel */
+#define FRAME_SIZE (SPRITE_WIDTH * SPRITE_HEIGHT * 2)
+
+#define VDP1_CMDT_ORDER_SYSTEM_CLIP_COORDS_INDEX (0)
+#define VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX       (1)
+#define VDP1_CMDT_ORDER_SPRITE_START_INDEX       (2)
+#define VDP1_CMDT_ORDER_COUNT                    (VDP1_CMDT_ORDER_SPRITE_START_INDEX + SPRITE_COUNT_MAX + 1)
+
+/* The default partitions only have room for 2048 command tables. The texture
+ * partition gets what's left over */
+#define VDP1_VRAM_CMDT_COUNT    (VDP1_CMDT_ORDER_COUNT)
+#define VDP1_VRAM_TEXTURE_SIZE  (0x0006BF60)
+#define VDP1_VRAM_GOURAUD_COUNT (1024)
+#define VDP1_VRAM_CLUT_COUNT    (256)
+
+typedef struct {
+        sprite_t *sprite;
+        int16_vec2_t velocity;
+} mover_t;
+
+static sprite_batch_t _batch;
+static sprite_frame_t _frames[ANIMATION_FRAME_COUNT];
+static sprite_anim_t _anim;
+
+static mover_t _movers[SPRITE_COUNT_MAX];
+static uint32_t _mover_count = 0;
+
+static uint32_t _random_state = 0x2545F491;
+
+static vdp1_cmdt_list_t *_cmdt_list = NULL;
+static vdp1_vram_partitions_t _vdp1_vram_partitions;
+
+static smpc_peripheral_digital_t _digital;
+
+static void _vblank_out_handler(void *work);
+
+static void _cmdt_list_init(void);
+static void _texture_init(void);
+
+static void _movers_add(uint32_t count);
+static void _movers_remove(uint32_t count);
+static void _movers_move(void);
+
+static uint32_t _random(void);
+
+int
+main(void)
+{
+        perf_counter_t update_counter;
+        perf_counter_t build_counter;
+
+        perf_init();
+        perf_counter_init(&update_counter);
+        perf_counter_init(&build_counter);
+
+        _texture_init();
+        _cmdt_list_init();
+
+        sprite_batch_init(&_batch, SPRITE_COUNT_MAX);
+
+        _movers_add(SPRITE_COUNT_MAX / 2);
+
+        while (true) {
+                smpc_peripheral_process();
+                smpc_peripheral_digital_port(1, &_digital);
+
+                if ((_digital.held.button.a) != 0) {
+                        _movers_add(SPRITE_COUNT_STEP);
+                } else if ((_digital.held.button.b) != 0) {
+                        _movers_remove(SPRITE_COUNT_STEP);
+                }
+
+                perf_counter_start(&update_counter);
+
+                _movers_move();
+                sprite_batch_update(&_batch);
+
+                perf_counter_end(&update_counter);
+
+                perf_counter_start(&build_counter);
+
+                vdp1_cmdt_t * const cmdts =
+                    &_cmdt_list->cmdts[VDP1_CMDT_ORDER_SPRITE_START_INDEX];
+
+                const uint32_t count =
+                    sprite_batch_build(&_batch, cmdts, SPRITE_COUNT_MAX);
+
+                vdp1_cmdt_end_set(&cmdts[count]);
+
+                perf_counter_end(&build_counter);
+
+                _cmdt_list->count = VDP1_CMDT_ORDER_SPRITE_START_INDEX + count + 1;
+
+                vdp1_sync_cmdt_list_put(_cmdt_list, 0);
+                vdp1_sync_render();
+
+                vdp1_sync();
+                vdp1_sync_wait();
+
+                dbgio_printf("[H[2J"
+                             "%lu sprites (A/B to add/remove)\n"
+                             "update: %5lu ticks (max %5lu)\n"
+                             " build: %5lu ticks (max %5lu)\n",
+                    count,
+                    update_counter.ticks, update_counter.max_ticks,
+                    build_counter.ticks, build_counter.max_ticks);
+
+                dbgio_flush();
+        }
+
+        return 0;
+}
+
+void
+user_init(void)
+{
+        smpc_peripheral_init();
+
+        dbgio_init();
+        dbgio_dev_default_init(DBGIO_DEV_VDP2_ASYNC);
+        dbgio_dev_font_load();
+
+        vdp2_tvmd_display_res_set(VDP2_TVMD_INTERLACE_NONE, VDP2_TVMD_HORZ_NORMAL_A,
+            VDP2_TVMD_VERT_240);
+
+        vdp2_scrn_back_color_set(VDP2_VRAM_ADDR(3, 0x01FFFE),
+            RGB1555(1, 0, 3, 15));
+
+        vdp2_sprite_priority_set(0, 6);
+
+        vdp1_env_default_set();
+
+        vdp1_vram_partitions_set(VDP1_VRAM_CMDT_COUNT,
+            VDP1_VRAM_TEXTURE_SIZE,
+            VDP1_VRAM_GOURAUD_COUNT,
+            VDP1_VRAM_CLUT_COUNT);
+
+        vdp1_vram_partitions_get(&_vdp1_vram_partitions);
+
+        /* The VDP1 can't draw this many sprites in a frame, so don't cap the
+         * frame rate */
+        vdp1_sync_interval_set(-2);
+
+        vdp_sync_vblank_out_set(_vblank_out_handler, NULL);
+
+        vdp2_tvmd_display_set();
+
+        vdp2_sync();
+        vdp2_sync_wait();
+}
+
+static void
+_cmdt_list_init(void)
+{
+        static const int16_vec2_t system_clip_coord =
+            INT16_VEC2_INITIALIZER(SCREEN_WIDTH - 1,
+                                   SCREEN_HEIGHT - 1);
+
+        static const int16_vec2_t local_coord_ul =
+            INT16_VEC2_INITIALIZER(0, 0);
+
+        _cmdt_list = vdp1_cmdt_list_alloc(VDP1_CMDT_ORDER_COUNT);
+        assert(_cmdt_list != NULL);
+
+        vdp1_cmdt_t * const cmdts = &_cmdt_list->cmdts[0];
+
+        (void)memset(&cmdts[0], 0x00, sizeof(vdp1_cmdt_t) * VDP1_CMDT_ORDER_COUNT);
+
+        vdp1_cmdt_system_clip_coord_set(&cmdts[VDP1_CMDT_ORDER_SYSTEM_CLIP_COORDS_INDEX]);
+        vdp1_cmdt_vtx_system_clip_coord_set(&cmdts[VDP1_CMDT_ORDER_SYSTEM_CLIP_COORDS_INDEX],
+            system_clip_coord);
+
+        vdp1_cmdt_local_coord_set(&cmdts[VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX]);
+        vdp1_cmdt_vtx_local_coord_set(&cmdts[VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX],
+            local_coord_ul);
+
+        vdp1_cmdt_end_set(&cmdts[VDP1_CMDT_ORDER_SPRITE_START_INDEX]);
+
+        _cmdt_list->count = VDP1_CMDT_ORDER_SPRITE_START_INDEX + 1;
+}
+
+static void
+_texture_init(void)
+{
+        /* A square that shrinks one texel per frame, each frame in a
+         * different color */
+        static const rgb1555_t colors[] = {
+                RGB1555(1, 31,  0,  0),
+                RGB1555(1, 31, 31,  0),
+                RGB1555(1,  0, 31,  0),
+                RGB1555(1,  0, 31, 31)
+        };
+
+        const vdp1_vram_t texture_base =
+            (vdp1_vram_t)_vdp1_vram_partitions.texture_base;
+
+        for (uint32_t frame = 0; frame < ANIMATION_FRAME_COUNT; frame++) {
+                volatile rgb1555_t * const texels =
+                    (volatile rgb1555_t *)(texture_base + (frame * FRAME_SIZE));
+
+                for (uint32_t y = 0; y < SPRITE_HEIGHT; y++) {
+                        for (uint32_t x = 0; x < SPRITE_WIDTH; x++) {
+                                const bool inside =
+                                    (x >= frame) && (x < (SPRITE_WIDTH - frame)) &&
+                                    (y >= frame) && (y < (SPRITE_HEIGHT - frame));
+
+                                texels[x + (y * SPRITE_WIDTH)] =
+                                    inside ? colors[frame] : RGB1555(0, 0, 0, 0);
+                        }
+                }
+        }
+
+        sprite_frames_strip_init(_frames, ANIMATION_FRAME_COUNT, texture_base,
+            SPRITE_WIDTH, SPRITE_HEIGHT, FRAME_SIZE);
+
+        _anim.frames = _frames;
+        _anim.frame_count = ANIMATION_FRAME_COUNT;
+        _anim.frame_duration = ANIMATION_FRAME_DURATION;
+        _anim.loop = true;
+}
+
+static void
+_movers_add(uint32_t count)
+{
+        static const vdp1_cmdt_draw_mode_t draw_mode = {
+                .color_mode           = 5,
+                .pre_clipping_disable = true
+        };
+
+        for (; (count > 0) && (_mover_count < SPRITE_COUNT_MAX); count--) {
+                sprite_t * const sprite = sprite_batch_alloc(&_batch);
+                assert(sprite != NULL);
+
+                vdp1_cmdt_draw_mode_set(&sprite->cmdt, draw_mode);
+
+                sprite_anim_set(sprite, &_anim);
+
+                /* Spread the sprites out over the animation */
+                sprite->frame = _random() % ANIMATION_FRAME_COUNT;
+
+                sprite->position.x = _random() % (SCREEN_WIDTH - SPRITE_WIDTH);
+                sprite->position.y = _random() % (SCREEN_HEIGHT - SPRITE_HEIGHT);
+
+                mover_t * const mover = &_movers[_mover_count];
+
+                mover->sprite = sprite;
+                mover->velocity.x = (_random() % 5) - 2;
+                mover->velocity.y = (_random() % 5) - 2;
+
+                _mover_count++;
+        }
+}
+
+static void
+_movers_remove(uint32_t count)
+{
+        for (; (count > 0) && (_mover_count > 0); count--) {
+                _mover_count--;
+
+                sprite_batch_free(&_batch, _movers[_mover_count].sprite);
+        }
+}
+
+static void
+_movers_move(void)
+{
+        for (uint32_t i = 0; i < _mover_count; i++) {
+                mover_t * const mover = &_movers[i];
+                int16_vec2_t * const position = &mover->sprite->position;
+
+                position->x += mover->velocity.x;
+                position->y += mover->velocity.y;
+
+                if ((position->x < 0) || (position->x > (SCREEN_WIDTH - SPRITE_WIDTH))) {
+                        mover->velocity.x = -mover->velocity.x;
+                        position->x += mover->velocity.x;
+                }
+
+                if ((position->y < 0) || (position->y > (SCREEN_HEIGHT - SPRITE_HEIGHT))) {
+                        mover->velocity.y = -mover->velocity.y;
+                        position->y += mover->velocity.y;
+                }
+        }
+}
+
+static uint32_t
+_random(void)
+{
+        /* Xorshift */
+        _random_state ^= _random_state << 13;
+        _random_state ^= _random_state >> 17;
+        _random_state ^= _random_state << 5;
+
+        return _random_state;
+}
+
+static void
+_vblank_out_handler(void *work __unused)
+{
+        smpc_peripheral_intback_issue();
+}
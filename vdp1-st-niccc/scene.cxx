@@ -134,7 +134,11 @@ void scene::reset(void) {
     _state.frame_index = 0;
 }
 
-void scene::process_frame(void) {
+uint32_t scene::frame_index(void) {
+    return _state.frame_index;
+}
+
+void scene::process_frame(bool skip_draw) {
     _on_start(_state.frame_index, _state.frame_index == 0);
 
     auto frame_flags = _buffer_read<::frame_flags>();
@@ -180,6 +184,17 @@ void scene::process_frame(void) {
         const uint8_vec2_t* vertex_buffer;
         const uint8_t vertex_count = polygon_descriptor.encoded.vertex_count;
 
+        if (skip_draw) {
+            // Indexed polygons store one byte per vertex index
+            const uint32_t vertex_size = (frame_flags.index_mode
+                                          ? sizeof(uint8_t)
+                                          : sizeof(uint8_vec2_t));
+
+            _buffer_seek((uint32_t)vertex_count * vertex_size, SEEK_CURRENT);
+
+            continue;
+        }
+
         if (frame_flags.index_mode) {
             _vertex_buffer_indexed_get(indexed_vertex_buffer, vertex_count);
 
@@ -39,7 +39,11 @@ namespace scene {
     void init(const uint8_t*& buffer, const callbacks& callbacks);
     void reset(void);
 
-    void process_frame(void);
+    // When skip_draw is set, the frame is decoded without emitting any
+    // polygons. Palette and clear-screen state are still applied
+    void process_frame(bool skip_draw = false);
+
+    uint32_t frame_index(void);
 };
 
 #endif // SCENE_H_
@@ -17,7 +17,8 @@
 #define VDP1_CMDT_ORDER_SYSTEM_CLIP_COORDS_INDEX 0
 #define VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX 1
 #define VDP1_CMDT_ORDER_ERASE_INDEX 2
-#define VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX 3
+#define VDP1_CMDT_ORDER_ERASE_COUNT 4
+#define VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX (VDP1_CMDT_ORDER_ERASE_INDEX + VDP1_CMDT_ORDER_ERASE_COUNT)
 #define VDP1_CMDT_ORDER_BUFFER_END_INDEX (VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX + 512)
 #define VDP1_CMDT_ORDER_DRAW_END_INDEX (VDP1_CMDT_ORDER_BUFFER_END_INDEX + 1)
 #define VDP1_CMDT_ORDER_COUNT VDP1_CMDT_ORDER_DRAW_END_INDEX
@@ -28,6 +29,13 @@
 
 #define BACK_SCREEN VDP2_VRAM_ADDR(1, 0x01FFFE)
 
+struct dirty_rect {
+  int16_t x_min;
+  int16_t y_min;
+  int16_t x_max;
+  int16_t y_max;
+};
+
 typedef uint32_t (*draw_handler)(vdp1_cmdt* cmdt, const uint8_vec2_t* vertex_buffer, vdp1_cmdt_color_bank_t color_bank);
 
 static constexpr uint32_t _screen_width  = 352;
@@ -36,6 +44,18 @@ static constexpr uint32_t _screen_height = 240;
 static constexpr uint32_t _render_width  = 256;
 static constexpr uint32_t _render_height = 200;
 
+// Playback is locked to VBLANK: one scene frame is due every
+// _frame_vblank_count VBLANKs
+static constexpr uint32_t _frame_vblank_count = 1;
+
+// Upper bound of late frames decoded without drawing before the next frame is
+// drawn, so that the display keeps updating on long stalls
+static constexpr uint32_t _frame_skip_max_count = 8;
+
+// The render area is split into horizontal bands. Each band is erased with its
+// own rectangle, covering only what was drawn into it
+static constexpr uint32_t _erase_band_height = _render_height / VDP1_CMDT_ORDER_ERASE_COUNT;
+
 static constexpr fix16_t _scale_width  = fix16_t::from_double(_render_width / static_cast<double>(_screen_width));
 static constexpr fix16_t _scale_height = fix16_t::from_double(_render_height / static_cast<double>(_screen_height));
 
@@ -50,17 +70,40 @@ static struct {
   vdp1_cmdt_list_t* cmdt_list;
 
   rgb1555_t palette[16];
+
+  // Screen-space bounds of what has been drawn into the framebuffer that each
+  // command table list renders to, since that framebuffer was last erased
+  dirty_rect dirty_rects[2][VDP1_CMDT_ORDER_ERASE_COUNT];
+
+  // Set while a late frame is being decoded without drawing
+  bool skipping;
+  // A skipped frame requested a clear, so the next drawn frame has to clear
+  bool clear_pending;
 } __aligned(16) _scene;
 
 static volatile struct {
   uint32_t frame_count;
   uint32_t vblank_count;
   uint32_t dropped_count;
+  uint32_t skipped_count;
   uint32_t ovi_count;
-} _stats = {.frame_count = 0, .vblank_count = 0, .dropped_count = 0, .ovi_count = 0};
+
+  // Playback clock in VBLANKs. Only advances while the scene is playing
+  uint32_t clock;
+  bool clock_enabled;
+} _stats = {.frame_count   = 0,
+            .vblank_count  = 0,
+            .dropped_count = 0,
+            .skipped_count = 0,
+            .ovi_count     = 0,
+            .clock         = 0,
+            .clock_enabled = false};
 
 static void _draw_init(void);
 
+static void _frames_skip(void);
+static void _frame_wait(void);
+
 static void _vblank_out_handler(void*);
 
 static void _frt_ovi_handler(void);
@@ -71,6 +114,10 @@ static void _on_clear_screen(bool);
 static void _on_update_palette(uint8_t, const scene::rgb444);
 static void _on_draw(const uint8_vec2_t*, uint32_t, uint32_t);
 
+static void _dirty_rects_reset(dirty_rect* dirty_rects);
+static void _dirty_rects_extend(dirty_rect* dirty_rects, const uint8_vec2_t* vertex_buffer, uint32_t count);
+static void _erase_cmdts_set(vdp1_cmdt* cmdts, const dirty_rect* dirty_rects);
+
 static uint32_t _on_draw_polygon3(vdp1_cmdt* cmdt, const uint8_vec2_t* vertex_buffer,
                                   vdp1_cmdt_color_bank_t color_bank);
 static uint32_t _on_draw_polygon4(vdp1_cmdt* cmdt, const uint8_vec2_t* vertex_buffer,
@@ -130,12 +177,16 @@ int main(void) {
       process_frame = true;
     }
 
+    // Stepping through frames by hand stops the playback clock
+    _stats.clock_enabled = start_state;
+
     if (process_frame) {
       if (_stats.vblank_count > 1) {
         _stats.dropped_count++;
       }
 
-      dbgio_printf("[H[2J\n_stats.dropped_count: %i\n", _stats.dropped_count);
+      dbgio_printf("[H[2J\n_stats.dropped_count: %i\n_stats.skipped_count: %i\n", _stats.dropped_count,
+                   _stats.skipped_count);
 
       _stats.vblank_count = 0;
       _stats.frame_count  = 0;
@@ -143,6 +194,11 @@ int main(void) {
       dbgio_flush();
       vdp2_sync();
 
+      if (start_state) {
+        _frames_skip();
+        _frame_wait();
+      }
+
       scene::process_frame();
     } else {
       vdp2_tvmd_vblank_in_wait();
@@ -160,6 +216,11 @@ static void _vdp1_init(void) {
 
   vdp1_sync_interval_set(0);
 
+  // The VDP1 doesn't have enough time to erase the whole framebuffer during
+  // VBLANK. Instead, only the dirty areas are erased with polygons at the start
+  // of each command table list
+  vdp1_sync_mode_set(VDP1_SYNC_MODE_CHANGE_ONLY);
+
   vdp1_env_t vdp1_env;
 
   vdp1_env.erase_color       = RGB1555(0, 0, 0, 0);
@@ -275,10 +336,6 @@ static void _draw_cmdt_list_init(vdp1_cmdt_list_t* cmdt_list) {
 
   constexpr int16_vec2_t local_coord_ul = INT16_VEC2_INITIALIZER(0, 0);
 
-  vdp1_vram_partitions_t vram_partitions;
-
-  vdp1_vram_partitions_get(&vram_partitions);
-
   vdp1_cmdt_draw_mode_t polygon_draw_mode;
   polygon_draw_mode.raw                  = 0x0000;
   polygon_draw_mode.hss_enable           = true;
@@ -289,14 +346,6 @@ static void _draw_cmdt_list_init(vdp1_cmdt_list_t* cmdt_list) {
   vdp1_cmdt_color_bank_t color_bank;
   color_bank.raw = 0x0000;
 
-  vdp1_cmdt_draw_mode_t clear_draw_mode;
-  clear_draw_mode.raw                  = 0x0000;
-  clear_draw_mode.hss_enable           = true;
-  clear_draw_mode.pre_clipping_disable = true;
-  clear_draw_mode.end_code_disable     = true;
-  clear_draw_mode.trans_pixel_disable  = true;
-  clear_draw_mode.color_mode           = VDP1_CMDT_CM_CLUT_16;
-
   vdp1_cmdt_t* const cmdts = cmdt_list->cmdts;
 
   (void)memset(&cmdts[0], 0x00, VDP1_CMDT_ORDER_COUNT * sizeof(vdp1_cmdt));
@@ -307,23 +356,13 @@ static void _draw_cmdt_list_init(vdp1_cmdt_list_t* cmdt_list) {
   vdp1_cmdt_local_coord_set(&cmdts[VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX]);
   vdp1_cmdt_vtx_local_coord_set(&cmdts[VDP1_CMDT_ORDER_LOCAL_COORDS_INDEX], local_coord_ul);
 
-  vdp1_cmdt_scaled_sprite_set(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX]);
-  vdp1_cmdt_jump_skip_assign(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX], VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX);
-  vdp1_cmdt_draw_mode_set(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX], clear_draw_mode);
-  vdp1_cmdt_char_size_set(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX], 8, 1);
-  vdp1_cmdt_char_base_set(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX], (vdp1_vram_t)vram_partitions.texture_base);
-  vdp1_cmdt_color_mode1_set(&cmdts[VDP1_CMDT_ORDER_ERASE_INDEX], (vdp1_vram_t)vram_partitions.clut_base);
-
-  // The clear polygon is cut in half due to the VDP1 not having enough time *
-  // to clear the bottom half of the framebuffer in time
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_xa = 0;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_ya = ((_render_height - 18) / 2) - 1;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_xb = 0;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_yb = 0;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_xc = _render_width - 1;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_yc = _render_height - 1;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_xd = 0;
-  cmdts[VDP1_CMDT_ORDER_ERASE_INDEX].cmd_yd = 0;
+  // Erase polygons draw with palette index 0, the erase color
+  for (uint32_t i = VDP1_CMDT_ORDER_ERASE_INDEX; i < VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX; i++) {
+    vdp1_cmdt_polygon_set(&cmdts[i]);
+    vdp1_cmdt_draw_mode_set(&cmdts[i], polygon_draw_mode);
+    vdp1_cmdt_color_bank_set(&cmdts[i], color_bank);
+    vdp1_cmdt_jump_skip_next(&cmdts[i]);
+  }
 
   for (uint32_t i = VDP1_CMDT_ORDER_BUFFER_STARTING_INDEX; i < VDP1_CMDT_ORDER_BUFFER_END_INDEX; i++) {
     vdp1_cmdt_polygon_set(&cmdts[i]);
@@ -358,17 +397,69 @@ static void _draw_init(void) {
 
   _scene.which_cmdt_list = 0;
   _scene.cmdt_list       = _scene.cmdt_lists[_scene.which_cmdt_list];
+
+  _scene.skipping      = false;
+  _scene.clear_pending = false;
+
+  // Nothing is known about the initial contents of either framebuffer
+  for (uint32_t i = 0; i < 2; i++) {
+    for (uint32_t band = 0; band < VDP1_CMDT_ORDER_ERASE_COUNT; band++) {
+      dirty_rect& dirty_rect = _scene.dirty_rects[i][band];
+
+      dirty_rect.x_min = 0;
+      dirty_rect.y_min = band * _erase_band_height;
+      dirty_rect.x_max = _render_width - 1;
+      dirty_rect.y_max = ((band + 1) * _erase_band_height) - 1;
+    }
+  }
+}
+
+static void _frames_skip(void) {
+  const uint32_t due_frame_index = _stats.clock / _frame_vblank_count;
+
+  _scene.skipping = true;
+
+  // Decode late frames without drawing them. The palette and clear-screen
+  // state still has to be applied, and the decoder keeps honoring the
+  // FRAME_END_STREAM_SKIP markers, so the stream stays in sync with the
+  // chunk boundaries
+  for (uint32_t i = 0; i < _frame_skip_max_count; i++) {
+    if ((scene::frame_index() + 1) >= due_frame_index) {
+      break;
+    }
+
+    scene::process_frame(true);
+
+    _stats.skipped_count++;
+  }
+
+  _scene.skipping = false;
+}
+
+static void _frame_wait(void) {
+  // Don't run ahead of the playback clock when decoding is fast
+  while ((scene::frame_index() * _frame_vblank_count) > _stats.clock) {
+    vdp2_tvmd_vblank_out_wait();
+  }
 }
 
 static void _vblank_out_handler(void*) {
   _stats.vblank_count++;
 
+  if (_stats.clock_enabled) {
+    _stats.clock++;
+  }
+
   smpc_peripheral_intback_issue();
 }
 
 static void _frt_ovi_handler(void) { _stats.ovi_count++; }
 
 static void _on_start(uint32_t, bool) {
+  if (_scene.skipping) {
+    return;
+  }
+
   // At the beginning of a processing frame, clear the previous Draw End
   // command
   vdp1_cmdt* const end_cmdt = &_scene.cmdt_list->cmdts[_scene.cmdt_list->count - 1];
@@ -380,6 +471,10 @@ static void _on_start(uint32_t, bool) {
 
 static void _on_end(uint32_t frame_index __unused, bool last_frame) {
   if (!last_frame) {
+    if (_scene.skipping) {
+      return;
+    }
+
     vdp1_cmdt* const end_cmdt = &_scene.cmdt_list->cmdts[_scene.cmdt_list->count];
 
     vdp1_cmdt_end_set(end_cmdt);
@@ -401,6 +496,8 @@ static void _on_end(uint32_t frame_index __unused, bool last_frame) {
     scene::reset();
 
     _stats.dropped_count = 0;
+    _stats.skipped_count = 0;
+    _stats.clock         = 0;
   }
 }
 
@@ -417,10 +514,100 @@ static void _on_update_palette(uint8_t palette_index, const scene::rgb444 color)
 }
 
 static void _on_clear_screen(bool clear_screen) {
+  if (_scene.skipping) {
+    _scene.clear_pending |= clear_screen;
+
+    return;
+  }
+
+  clear_screen |= _scene.clear_pending;
+  _scene.clear_pending = false;
+
+  // This assumes that each submitted command table list results in exactly
+  // one framebuffer change, so each list always renders to the same
+  // framebuffer
+  dirty_rect* const dirty_rects = _scene.dirty_rects[_scene.which_cmdt_list];
+  vdp1_cmdt* const erase_cmdts  = &_scene.cmdt_list->cmdts[VDP1_CMDT_ORDER_ERASE_INDEX];
+
   if (!clear_screen) {
-    vdp1_sync_mode_set(VDP1_SYNC_MODE_CHANGE_ONLY);
+    // Draw on top of the previous contents, which stay dirty
+    _erase_cmdts_set(erase_cmdts, nullptr);
   } else {
-    vdp1_sync_mode_set(VDP1_SYNC_MODE_ERASE_CHANGE);
+    _erase_cmdts_set(erase_cmdts, dirty_rects);
+    _dirty_rects_reset(dirty_rects);
+  }
+}
+
+static void _dirty_rects_reset(dirty_rect* dirty_rects) {
+  for (uint32_t band = 0; band < VDP1_CMDT_ORDER_ERASE_COUNT; band++) {
+    dirty_rects[band].x_min = _render_width;
+    dirty_rects[band].y_min = _render_height;
+    dirty_rects[band].x_max = -1;
+    dirty_rects[band].y_max = -1;
+  }
+}
+
+static void _dirty_rects_extend(dirty_rect* dirty_rects, const uint8_vec2_t* vertex_buffer, uint32_t count) {
+  int16_t x_min = vertex_buffer[0].x;
+  int16_t y_min = vertex_buffer[0].y;
+  int16_t x_max = x_min;
+  int16_t y_max = y_min;
+
+  for (uint32_t i = 1; i < count; i++) {
+    const int16_t x = vertex_buffer[i].x;
+    const int16_t y = vertex_buffer[i].y;
+
+    x_min = min(x_min, x);
+    y_min = min(y_min, y);
+    x_max = max(x_max, x);
+    y_max = max(y_max, y);
+  }
+
+  if (y_min >= static_cast<int16_t>(_render_height)) {
+    return;
+  }
+
+  y_max = min(y_max, static_cast<int16_t>(_render_height - 1));
+
+  const uint32_t first_band = y_min / _erase_band_height;
+  const uint32_t last_band  = min(static_cast<uint32_t>(y_max / _erase_band_height),
+                                  static_cast<uint32_t>(VDP1_CMDT_ORDER_ERASE_COUNT - 1));
+
+  for (uint32_t band = first_band; band <= last_band; band++) {
+    dirty_rect& dirty_rect = dirty_rects[band];
+
+    const int16_t band_y_min = band * _erase_band_height;
+    const int16_t band_y_max = ((band + 1) * _erase_band_height) - 1;
+
+    dirty_rect.x_min = min(dirty_rect.x_min, x_min);
+    dirty_rect.x_max = max(dirty_rect.x_max, x_max);
+    dirty_rect.y_min = min(dirty_rect.y_min, max(y_min, band_y_min));
+    dirty_rect.y_max = max(dirty_rect.y_max, min(y_max, band_y_max));
+  }
+}
+
+static void _erase_cmdts_set(vdp1_cmdt* cmdts, const dirty_rect* dirty_rects) {
+  for (uint32_t band = 0; band < VDP1_CMDT_ORDER_ERASE_COUNT; band++) {
+    vdp1_cmdt& cmdt = cmdts[band];
+
+    if ((dirty_rects == nullptr) || (dirty_rects[band].x_min > dirty_rects[band].x_max)) {
+      vdp1_cmdt_jump_skip_next(&cmdt);
+
+      continue;
+    }
+
+    const dirty_rect& dirty_rect = dirty_rects[band];
+
+    vdp1_cmdt_jump_next(&cmdt);
+
+    cmdt.cmd_xa = dirty_rect.x_min;
+    cmdt.cmd_ya = dirty_rect.y_min;
+    cmdt.cmd_xb = dirty_rect.x_max;
+    cmdt.cmd_yb = dirty_rect.y_min;
+    cmdt.cmd_xc = dirty_rect.x_max;
+    cmdt.cmd_yc = dirty_rect.y_max;
+    cmdt.cmd_xd = dirty_rect.x_min;
+    cmdt.cmd_yd = dirty_rect.y_max;
   }
 }
 
@@ -624,6 +811,8 @@ static void _on_draw(const uint8_vec2_t* vertex_buffer, uint32_t count, uint32_t
   color_bank.type_0.dc = palette_index + 16;
 
   _scene.cmdt_list->count += draw(cmdt, vertex_buffer, color_bank);
+
+  _dirty_rects_extend(_scene.dirty_rects[_scene.which_cmdt_list], vertex_buffer, count);
 }
 
 // #pragma GCC pop_options
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "cmdt_sync.h"
+
 #define SCREEN_WIDTH    320
 #define SCREEN_HEIGHT   224
 
@@ -60,6 +62,7 @@ static struct {
 } _sprite;
 
 static vdp1_cmdt_list_t *_cmdt_list = NULL;
+static cmdt_sync_t _cmdt_sync;
 static vdp1_vram_partitions_t _vdp1_vram_partitions;
 
 static inline bool __always_inline
@@ -113,7 +116,7 @@ main(void)
                 _sprite_config();
                 _polygon_pointer_config();
 
-                vdp1_sync_cmdt_list_put(_cmdt_list, 0);
+                cmdt_sync_put(&_cmdt_sync, _cmdt_list);
 
                 /* dbgio_printf("[H[2J"); */
 
@@ -176,6 +179,8 @@ _init(void)
 
         _cmdt_list_init();
 
+        cmdt_sync_init(&_cmdt_sync, VDP1_CMDT_ORDER_COUNT, 0);
+
         _uv_coords[0].x = 0;
         _uv_coords[0].y = 0;
 
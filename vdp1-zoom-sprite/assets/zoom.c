@@ -0,0 +1,20 @@
+#include "zoom.h"
+
+static const sprite_atlas_entry_t _entries[] = {
+        { /* zoom */
+                .offset      = 0x00000,
+                .frame_size  = 0x01980,
+                .width       = 64,
+                .height      = 102,
+                .frame_count = 14,
+                .color_mode  = 4,
+                .palette     = 0
+        }
+};
+
+const sprite_atlas_t atlas_zoom = {
+        .entries     = _entries,
+        .entry_count = 1,
+        .clut_offset = 0x16500,
+        .size        = 0x16500
+};
@@ -0,0 +1,10 @@
+#ifndef ATLAS_ZOOM_H
+#define ATLAS_ZOOM_H
+
+#include "sprite_batch.h"
+
+#define ATLAS_ZOOM_ZOOM (0)
+
+extern const sprite_atlas_t atlas_zoom;
+
+#endif /* ATLAS_ZOOM_H */
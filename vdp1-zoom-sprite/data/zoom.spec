@@ -0,0 +1,4 @@
+# Packed into assets/ by zoom_conv.sh, with ../shared/sprite_batch/work/atlas_pack.py
+#
+# The sprite is drawn with end codes disabled, so all 255 colors can be used
+zoom_appended.png name=zoom frames=14 endcode=off
@@ -7,9 +7,15 @@
 
 #include <yaul.h>
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "cmdt_sync.h"
+#include "sprite_batch.h"
+
+#include "zoom.h"
+
 #define SCREEN_WIDTH    320
 #define SCREEN_HEIGHT   240
 
@@ -55,8 +61,10 @@ static struct {
 } _polygon_pointer;
 
 static struct {
-        uint16_t anim_frame;
-        uint16_t anim_counter;
+        sprite_batch_t batch;
+        sprite_frame_t frames[ANIMATION_FRAME_COUNT];
+        sprite_anim_t anim;
+        sprite_t *sprite;
 
         uint16_t *tex_base;
         uint16_t *pal_base;
@@ -70,6 +78,7 @@ extern const uint8_t asset_zoom_pal[];
 extern const uint8_t asset_zoom_pal_end[];
 
 static vdp1_cmdt_list_t *_cmdt_list = NULL;
+static cmdt_sync_t _cmdt_sync;
 static vdp1_vram_partitions_t _vdp1_vram_partitions;
 
 static volatile uint32_t _frt_count = 0;
@@ -127,7 +136,9 @@ main(void)
                 _sprite_config();
                 _polygon_pointer_config();
 
-                vdp1_sync_cmdt_list_put(_cmdt_list, 0);
+                sprite_batch_update(&_sprite.batch);
+
+                cmdt_sync_put(&_cmdt_sync, _cmdt_list);
 
                 vdp1_sync_render();
 
@@ -185,6 +196,8 @@ _init(void)
         dbgio_dev_font_load();
 
         _cmdt_list_init();
+
+        cmdt_sync_init(&_cmdt_sync, VDP1_CMDT_ORDER_COUNT, 0);
 }
 
 static void
@@ -271,27 +284,41 @@ _frame_time_calculate(void)
 static void
 _sprite_init(void)
 {
-        _sprite.anim_frame = 0;
-        _sprite.anim_counter = 0;
-
         _sprite.tex_base = _vdp1_vram_partitions.texture_base;
         _sprite.pal_base = (void *)VDP2_CRAM_MODE_1_OFFSET(1, 0, 0x0000);
 
+        assert(atlas_zoom.entries[ATLAS_ZOOM_ZOOM].frame_count == ANIMATION_FRAME_COUNT);
+
+        sprite_atlas_frames_init(_sprite.frames, &atlas_zoom, ATLAS_ZOOM_ZOOM,
+            (vdp1_vram_t)_sprite.tex_base);
+
+        _sprite.anim.frames = _sprite.frames;
+        _sprite.anim.frame_count = ANIMATION_FRAME_COUNT;
+        _sprite.anim.frame_duration = ANIMATION_FRAME_DURATION;
+        _sprite.anim.loop = true;
+
+        sprite_batch_init(&_sprite.batch, 1);
+
+        _sprite.sprite = sprite_batch_alloc(&_sprite.batch);
+        assert(_sprite.sprite != NULL);
+
+        sprite_anim_set(_sprite.sprite, &_sprite.anim);
+
+        /* The atlas was packed with end codes off, so they must stay
+         * disabled */
         const vdp1_cmdt_draw_mode_t draw_mode = {
                 .trans_pixel_disable  = true,
                 .pre_clipping_disable = true,
                 .end_code_disable     = true
         };
 
-        const vdp1_cmdt_color_bank_t color_bank = {
-                .type_0.dc = 0x0100
-        };
-
-        vdp1_cmdt_scaled_sprite_set(_sprite.cmdt);
-        vdp1_cmdt_draw_mode_set(_sprite.cmdt, draw_mode);
-        vdp1_cmdt_color_mode4_set(_sprite.cmdt, color_bank);
+        vdp1_cmdt_t * const cmdt = &_sprite.sprite->cmdt;
 
-        vdp1_cmdt_char_size_set(_sprite.cmdt, ZOOM_POINT_WIDTH, ZOOM_POINT_HEIGHT);
+        vdp1_cmdt_scaled_sprite_set(cmdt);
+        vdp1_cmdt_draw_mode_set(cmdt, draw_mode);
+        /* The color bank was copied to bank 1 */
+        sprite_atlas_color_set(cmdt, &atlas_zoom, ATLAS_ZOOM_ZOOM,
+            (vdp1_vram_t)_sprite.tex_base, 1);
 
         scu_dma_transfer(0, _sprite.tex_base, asset_zoom_tex, asset_zoom_tex_end - asset_zoom_tex);
         scu_dma_transfer(0, _sprite.pal_base, asset_zoom_pal, asset_zoom_pal_end - asset_zoom_pal);
@@ -300,25 +327,17 @@ _sprite_init(void)
 static void
 _sprite_config(void)
 {
-        const uint32_t offset =
-            _sprite.anim_frame * (ZOOM_POINT_WIDTH * ZOOM_POINT_HEIGHT);
-
-        vdp1_cmdt_char_base_set(_sprite.cmdt, (uint32_t)_sprite.tex_base + offset);
+        sprite_t * const sprite = _sprite.sprite;
 
-        vdp1_cmdt_zoom_set(_sprite.cmdt, _zoom_point_value);
-        vdp1_cmdt_vtx_zoom_point_set(_sprite.cmdt, _zoom_point);
-        vdp1_cmdt_vtx_zoom_display_set(_sprite.cmdt, _display);
+        vdp1_cmdt_zoom_set(&sprite->cmdt, _zoom_point_value);
+        vdp1_cmdt_vtx_zoom_display_set(&sprite->cmdt, _display);
 
-        if (_sprite.anim_counter == 0) {
-                _sprite.anim_counter = ANIMATION_FRAME_DURATION;
+        /* The batch writes the position into the zoom point */
+        sprite->position = _zoom_point;
 
-                _sprite.anim_frame++;
-                if (_sprite.anim_frame >= ANIMATION_FRAME_COUNT) {
-                        _sprite.anim_frame = 0;
-                }
-        } else {
-                _sprite.anim_counter--;
-        }
+        const uint32_t count __unused =
+            sprite_batch_build(&_sprite.batch, _sprite.cmdt, 1);
+        assert(count == 1);
 }
 
 static void
@@ -17,9 +17,6 @@ done
 convert -append zoom_*.png ${PNG_OPTS} zoom_appended.png
 cd ..
 
-# Convert
-grit "data/zoom_appended.png" -g -gb -gB8 -m\! -p -pT1 -fh\! -ftb
-
-# Move to assets/
-mv "zoom_appended.pal.bin" "assets/ZOOM.PAL"
-mv "zoom_appended.img.bin" "assets/ZOOM.TEX"
+# Pack into assets/ZOOM.TEX and assets/ZOOM.PAL, with the manifest in
+# assets/zoom.c and assets/zoom.h
+python3 ../shared/sprite_batch/work/atlas_pack.py "data/zoom.spec" "assets/zoom" atlas_zoom
@@ -13,6 +13,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "cmdt_sync.h"
+
 #define SCREEN_WIDTH  320
 #define SCREEN_HEIGHT 240
 
@@ -54,7 +56,10 @@ main(void)
 
         _cmdt_list_init(cmdt_list);
 
-        vdp1_sync_cmdt_list_put(cmdt_list, 0);
+        cmdt_sync_t cmdt_sync;
+        cmdt_sync_init(&cmdt_sync, VDP1_CMDT_ORDER_COUNT, 0);
+
+        cmdt_sync_put(&cmdt_sync, cmdt_list);
         vdp1_sync_render();
         vdp1_sync();
         vdp1_sync_wait();
@@ -74,7 +79,8 @@ main(void)
                         vdp1_cmdt_jump_skip_next(cmdt_polygon);
                 }
 
-                vdp1_sync_cmdt_list_put(cmdt_list, 0);
+                /* Only the polygon's jump changes from frame to frame */
+                cmdt_sync_put(&cmdt_sync, cmdt_list);
 
                 vdp1_sync_render();
                 vdp1_sync();